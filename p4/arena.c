@@ -0,0 +1,194 @@
+/**
+    @file arena.c
+    @author Brian Morris (bcmorri3)
+
+    The arena.c program contains the memory arena defined in arena.h.
+ */
+
+#include <stdlib.h>
+#include "arena.h"
+
+/** Number of fine size classes, one per multiple of ARENA_ALIGN. */
+#define FINE_CLASSES ( ARENA_FINE_LIMIT / ARENA_ALIGN )
+
+/**
+    Bytes reserved in front of a large block to link it into the arena's list. It is a
+    multiple of ARENA_ALIGN so the block stays aligned.
+ */
+#define LARGE_HEADER ARENA_ALIGN
+
+/** The header in front of each large block. */
+typedef struct LargeTag {
+    /** The previous large block. */
+    struct LargeTag *prev;
+
+    /** The next large block. */
+    struct LargeTag *next;
+} Large;
+
+/**
+    The sizeClass function returns the size class for a block of the given size, and the
+    size blocks of that class really have.
+
+    @param size the number of bytes requested.
+    @param classSize set to the size of blocks in the class.
+
+    @return The index of the class.
+ */
+static int sizeClass( size_t size, size_t *classSize )
+{
+    // Fine classes: every multiple of ARENA_ALIGN.
+    if ( size <= ARENA_FINE_LIMIT ) {
+        int c = size <= ARENA_ALIGN ? 0 : (int)( ( size + ARENA_ALIGN - 1 ) / ARENA_ALIGN ) - 1;
+        *classSize = (size_t)( c + 1 ) * ARENA_ALIGN;
+        return c;
+    }
+
+    // Coarse classes: powers of two.
+    int c = FINE_CLASSES;
+    size_t cs = ARENA_FINE_LIMIT * 2;
+    while ( cs < size ) {
+        cs *= 2;
+        c++;
+    }
+    *classSize = cs;
+    return c;
+}
+
+Arena *makeArena()
+{
+    Arena *a = (Arena *)malloc( sizeof( Arena ) );
+    for ( int i = 0; i < ARENA_CLASSES; i++ ) {
+        a->freeList[ i ] = NULL;
+    }
+    a->slabs = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->large = NULL;
+    a->inUse = 0;
+    a->allocated = 0;
+    pthread_mutex_init( &a->lock, NULL );
+    return a;
+}
+
+void freeArena( Arena *a )
+{
+    // Release the slabs, each one holds the address of the one before it.
+    while ( a->slabs ) {
+        void *prev = *(void **)a->slabs;
+        free( a->slabs );
+        a->slabs = prev;
+    }
+
+    // Release the large blocks still in use.
+    Large *l = (Large *)a->large;
+    while ( l ) {
+        Large *next = l->next;
+        free( l );
+        l = next;
+    }
+
+    pthread_mutex_destroy( &a->lock );
+    free( a );
+}
+
+void *arenaAlloc( Arena *a, size_t size )
+{
+    // Large blocks get their own allocation, with a header linking them into a list.
+    if ( size > ARENA_LARGE_LIMIT ) {
+        void *block;
+        if ( posix_memalign( &block, ARENA_ALIGN, LARGE_HEADER + size ) != 0 ) {
+            return NULL;
+        }
+        Large *l = (Large *)block;
+        pthread_mutex_lock( &a->lock );
+        l->prev = NULL;
+        l->next = (Large *)a->large;
+        if ( l->next ) {
+            l->next->prev = l;
+        }
+        a->large = l;
+        a->inUse += size;
+        a->allocated += size;
+        pthread_mutex_unlock( &a->lock );
+        return (char *)block + LARGE_HEADER;
+    }
+
+    size_t classSize;
+    int c = sizeClass( size, &classSize );
+
+    pthread_mutex_lock( &a->lock );
+    a->inUse += classSize;
+    a->allocated += classSize;
+
+    // Reuse a freed block of the same class if there is one.
+    FreeBlock *f = a->freeList[ c ];
+    if ( f ) {
+        a->freeList[ c ] = f->next;
+        pthread_mutex_unlock( &a->lock );
+        return f;
+    }
+
+    // Otherwise carve it from the newest slab, starting a new slab if it doesn't fit.
+    if ( !a->next || (size_t)( a->end - a->next ) < classSize ) {
+        void *slab;
+        if ( posix_memalign( &slab, ARENA_ALIGN, ARENA_SLAB ) != 0 ) {
+            a->inUse -= classSize;
+            a->allocated -= classSize;
+            pthread_mutex_unlock( &a->lock );
+            return NULL;
+        }
+        // The first aligned unit of the slab holds the link to the previous slab.
+        *(void **)slab = a->slabs;
+        a->slabs = slab;
+        a->next = (char *)slab + ARENA_ALIGN;
+        a->end = (char *)slab + ARENA_SLAB;
+    }
+    void *p = a->next;
+    a->next += classSize;
+    pthread_mutex_unlock( &a->lock );
+    return p;
+}
+
+void arenaFree( Arena *a, void *p, size_t size )
+{
+    if ( !p ) {
+        return;
+    }
+
+    // Large blocks are unlinked and given back right away.
+    if ( size > ARENA_LARGE_LIMIT ) {
+        Large *l = (Large *)( (char *)p - LARGE_HEADER );
+        pthread_mutex_lock( &a->lock );
+        if ( l->prev ) {
+            l->prev->next = l->next;
+        } else {
+            a->large = l->next;
+        }
+        if ( l->next ) {
+            l->next->prev = l->prev;
+        }
+        a->inUse -= size;
+        pthread_mutex_unlock( &a->lock );
+        free( l );
+        return;
+    }
+
+    // Others go on the free list for their class.
+    size_t classSize;
+    int c = sizeClass( size, &classSize );
+    FreeBlock *f = (FreeBlock *)p;
+    pthread_mutex_lock( &a->lock );
+    f->next = a->freeList[ c ];
+    a->freeList[ c ] = f;
+    a->inUse -= classSize;
+    pthread_mutex_unlock( &a->lock );
+}
+
+void arenaUsage( Arena *a, size_t *inUse, size_t *allocated )
+{
+    pthread_mutex_lock( &a->lock );
+    *inUse = a->inUse;
+    *allocated = a->allocated;
+    pthread_mutex_unlock( &a->lock );
+}
@@ -0,0 +1,108 @@
+/**
+    @file arena.h
+    @author Brian Morris (bcmorri3)
+
+    The arena.h header file declares a memory arena for the Models of a Scene and their
+    points. Small and medium blocks are carved out of large slabs and rounded up to a size
+    class; freed blocks go on a free list for their class and are reused by later requests
+    of the same class. Freeing the arena releases every slab at once.
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+/** Alignment of every block handed out by an arena, wide enough for an AVX register. */
+#define ARENA_ALIGN 32
+
+/** Size of each slab blocks are carved from. */
+#define ARENA_SLAB ( 1 << 20 )
+
+/** Blocks up to this size are rounded to a multiple of ARENA_ALIGN. */
+#define ARENA_FINE_LIMIT 1024
+
+/** Blocks up to this size come from slabs; bigger ones get their own allocation. */
+#define ARENA_LARGE_LIMIT ( ARENA_SLAB / 4 )
+
+/** Number of size classes: the fine classes, then powers of two up to the large limit. */
+#define ARENA_CLASSES 40
+
+/** A freed block waiting to be reused, stored in the block itself. */
+typedef struct FreeBlockTag {
+    /** The next free block of the same class. */
+    struct FreeBlockTag *next;
+} FreeBlock;
+
+/** A memory arena. The fields are private to arena.c. */
+typedef struct {
+    /** Free blocks of each size class. */
+    FreeBlock *freeList[ ARENA_CLASSES ];
+
+    /** The slabs, linked through their first bytes. */
+    void *slabs;
+
+    /** Next unused byte of the newest slab. */
+    char *next;
+
+    /** End of the newest slab. */
+    char *end;
+
+    /** The large blocks that are in use, linked through a header before each one. */
+    void *large;
+
+    /** Number of bytes currently handed out, after rounding to the size class. */
+    size_t inUse;
+
+    /** Number of bytes handed out since the arena was made, counting reused blocks. */
+    size_t allocated;
+
+    /** Makes the arena safe to use from several threads. */
+    pthread_mutex_t lock;
+} Arena;
+
+/**
+    This function dynamically allocates an empty Arena.
+
+    @return A pointer to the new Arena.
+ */
+Arena *makeArena();
+
+/**
+    This function frees an Arena, including every block allocated from it.
+
+    @param a the Arena to free.
+ */
+void freeArena( Arena *a );
+
+/**
+    This function allocates a block of at least the given size from the arena, aligned to
+    ARENA_ALIGN bytes.
+
+    @param a the Arena to allocate from.
+    @param size the number of bytes needed.
+
+    @return A pointer to the block.
+ */
+void *arenaAlloc( Arena *a, size_t size );
+
+/**
+    This function returns a block to the arena so it can be reused.
+
+    @param a the Arena the block came from.
+    @param p the block, or NULL to do nothing.
+    @param size the size that was passed to arenaAlloc for the block.
+ */
+void arenaFree( Arena *a, void *p, size_t size );
+
+/**
+    This function reports how much memory an arena has handed out.
+
+    @param a the Arena.
+    @param inUse set to the number of bytes currently in use.
+    @param allocated set to the number of bytes handed out since the arena was made.
+ */
+void arenaUsage( Arena *a, size_t *inUse, size_t *allocated );
+
+#endif
@@ -0,0 +1,128 @@
+#!/bin/bash
+# Benchmarks for the drawing program.  Each case generates a synthetic scene,
+# runs a script against it with DRAWING_STATS set, and reports the mean time
+# of each kind of command, so every operation is timed on its own.  Results
+# go to bench-results.txt.  With an argument of "baseline" they are also
+# saved as bench-baseline.txt, and later runs show each time next to the
+# baseline's and the ratio between them.
+#
+# The "points" cases time one model of each size in BENCH_POINTS segments.
+# The "models" cases time scenes of BENCH_MODELS small models, for the
+# commands that look up, sort or remove models by name, and for one rotate of
+# all of them as a group.  BENCH_THREADS sets the thread count, 1 by default
+# so transforms run inline and are timed by their own commands rather than by
+# whatever waits for them.
+
+POINTS=${BENCH_POINTS:-"1000 10000 100000 1000000"}
+MODELS=${BENCH_MODELS:-"10 100 1000 10000"}
+THREADS=${BENCH_THREADS:-1}
+DIR=bench
+RESULTS=bench-results.txt
+BASELINE=bench-baseline.txt
+
+# Generate a model file that is a random walk of connected segments.
+genModel() {
+  FILE=$1
+  SEGMENTS=$2
+  awk -v n="$SEGMENTS" 'BEGIN {
+    srand( 1 )
+    x = 0; y = 0
+    for ( i = 0; i < n; i++ ) {
+      nx = x + rand() * 2 - 1; ny = y + rand() * 2 - 1
+      printf "%.3f %.3f\n%.3f %.3f\n\n", x, y, nx, ny
+      x = nx; y = ny
+    }
+  }' > "$DIR/$FILE"
+}
+
+# Run the script in the bench directory and add the mean time of each kind
+# of command to the results, labeled with the case and its size.
+runCase() {
+  CASE=$1
+  SIZE=$2
+
+  rm -f "$DIR/stats.json"
+  ( cd "$DIR" && DRAWING_THREADS=$THREADS DRAWING_STATS=stats.json \
+      ../drawing --script script.txt > /dev/null 2> /dev/null )
+  if [ ! -f "$DIR/stats.json" ]; then
+    echo "**** $CASE $SIZE: no statistics written"
+    FAIL=1
+    return 1
+  fi
+
+  sed -n 's/^ *"\([a-z]*\)": {"count": \([0-9]*\), "total_ns": \([0-9]*\).*/\1 \2 \3/p' \
+      "$DIR/stats.json" |
+  while read COMMAND COUNT TOTAL; do
+    echo "$CASE $SIZE $COMMAND $COUNT $(( TOTAL / COUNT / 1000 ))"
+  done >> "$RESULTS"
+}
+
+FAIL=0
+make drawing > /dev/null || exit 1
+rm -rf "$DIR" "$RESULTS"
+mkdir "$DIR"
+
+# One model, growing in size.
+for N in $POINTS; do
+  echo " points $N"
+  genModel p.txt "$N"
+  cat > "$DIR/script.txt" <<EOF
+load a p.txt
+translate a 1 2
+rotate a 30
+scale a 1.5
+copy b a
+simplify b 0.5
+query 0 0 10 10
+nearest 5 5
+render out.ppm 512 512
+save out.txt
+delete b
+quit
+EOF
+  runCase points "$N"
+done
+
+# Many small models, growing in number.
+genModel s.txt 4
+for N in $MODELS; do
+  echo " models $N"
+  awk -v n="$N" 'BEGIN {
+    for ( i = 0; i < n; i++ ) print "load m" i " s.txt"
+    for ( i = 0; i < n; i++ ) print "translate m" i " 1 1"
+    print "group all m*"
+    print "rotate all 30"
+    print "list"
+    print "save out.txt"
+    for ( i = 0; i < n; i++ ) print "delete m" i
+    print "quit"
+  }' > "$DIR/script.txt"
+  runCase models "$N"
+done
+
+rm -rf "$DIR"
+
+# Print the results, against the baseline if there is one.
+printf "%-7s %8s %-10s %8s %12s" case size command count "mean us"
+if [ -f "$BASELINE" ] && [ "$1" != "baseline" ]; then
+  printf " %12s %7s\n" "baseline us" ratio
+  awk 'NR == FNR { base[ $1 " " $2 " " $3 ] = $5; next }
+       {
+         key = $1 " " $2 " " $3
+         printf "%-7s %8s %-10s %8s %12s", $1, $2, $3, $4, $5
+         if ( key in base && base[ key ] > 0 )
+           printf " %12s %7.2f\n", base[ key ], $5 / base[ key ]
+         else
+           printf " %12s %7s\n", "-", "-"
+       }' "$BASELINE" "$RESULTS"
+else
+  printf "\n"
+  awk '{ printf "%-7s %8s %-10s %8s %12s\n", $1, $2, $3, $4, $5 }' "$RESULTS"
+fi
+
+if [ "$1" == "baseline" ]; then
+  cp "$RESULTS" "$BASELINE"
+  echo "Saved $BASELINE"
+fi
+
+exit $FAIL
@@ -0,0 +1,468 @@
+/**
+    @file binary.c
+    @author Brian Morris (bcmorri3)
+
+    The binary.c program contains the functions defined in binary.h for reading and
+    writing the binary model format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "binary.h"
+#include "spill.h"
+
+/** Number of bytes in the file header. */
+#define HEADER_LEN 32
+
+/** Number of bytes in a directory entry. */
+#define ENTRY_LEN 48
+
+/** Number of bytes reserved for a name in a directory entry. */
+#define ENTRY_NAME_LEN 24
+
+/** Offset of the version in the header. */
+#define VERSION_AT 4
+
+/** Offset of the flags in the header. */
+#define FLAGS_AT 6
+
+/** Offset of the model count in the header. */
+#define COUNT_AT 8
+
+/** Offset of the checksum in the header. */
+#define CHECKSUM_AT 16
+
+/** Offset of the file length in the header. */
+#define LENGTH_AT 24
+
+/** Offset of the point count in a directory entry. */
+#define POINTS_AT 24
+
+/** Offset of the x-coordinate offset in a directory entry. */
+#define XOFF_AT 32
+
+/** Offset of the y-coordinate offset in a directory entry. */
+#define YOFF_AT 40
+
+/** Starting value of the checksum. */
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+/** Multiplier used to mix each word into the checksum. */
+#define HASH_PRIME 0x100000001b3ULL
+
+/** Number of bits in a byte. */
+#define BYTE_BITS 8
+
+/** Mask for the low byte of a value. */
+#define BYTE_MASK 0xFF
+
+/** Zero bytes used to pad the point arrays out to POINT_ALIGN. */
+static unsigned char const padding[ POINT_ALIGN ];
+
+/**
+    The hostIsLittle function reports whether doubles and integers are stored little-endian
+    on this machine, in which case the point arrays can be used straight from the file.
+
+    @return True on a little-endian machine.
+ */
+static bool hostIsLittle()
+{
+    uint16_t probe = 1;
+    unsigned char first;
+    memcpy( &first, &probe, 1 );
+    return first == 1;
+}
+
+/**
+    The getLE function reads a little-endian unsigned integer.
+
+    @param p the first byte of the integer.
+    @param len the number of bytes in the integer.
+
+    @return The value of the integer.
+ */
+static uint64_t getLE( unsigned char const *p, int len )
+{
+    uint64_t v = 0;
+    for ( int i = len - 1; i >= 0; i-- ) {
+        v = ( v << BYTE_BITS ) | p[ i ];
+    }
+    return v;
+}
+
+/**
+    The putLE function stores an unsigned integer in little-endian order.
+
+    @param p where to store the first byte.
+    @param v the value to store.
+    @param len the number of bytes to store.
+ */
+static void putLE( unsigned char *p, uint64_t v, int len )
+{
+    for ( int i = 0; i < len; i++ ) {
+        p[ i ] = v & BYTE_MASK;
+        v >>= BYTE_BITS;
+    }
+}
+
+/**
+    The alignUp function rounds a file offset up to the next POINT_ALIGN boundary.
+
+    @param off the offset to round.
+
+    @return The rounded offset.
+ */
+static uint64_t alignUp( uint64_t off )
+{
+    return ( off + POINT_ALIGN - 1 ) / POINT_ALIGN * POINT_ALIGN;
+}
+
+/**
+    The hashWords function adds a run of little-endian 64-bit words to a checksum. Every
+    part of a binary file after the header is a whole number of words.
+
+    @param h the checksum so far.
+    @param p the first byte of the words.
+    @param len the number of bytes, a multiple of 8.
+
+    @return The updated checksum.
+ */
+static uint64_t hashWords( uint64_t h, unsigned char const *p, size_t len )
+{
+    bool little = hostIsLittle();
+    for ( size_t i = 0; i < len; i += sizeof( uint64_t ) ) {
+        uint64_t w;
+        memcpy( &w, p + i, sizeof( w ) );
+        if ( !little ) {
+            w = __builtin_bswap64( w );
+        }
+        h = ( h ^ w ) * HASH_PRIME;
+    }
+    return h;
+}
+
+/**
+    The readDoubles function copies little-endian doubles out of the file, swapping bytes
+    if this machine is big-endian and rounding them if coordinates are stored as floats.
+
+    @param dest where to store the values.
+    @param src the first byte of the values in the file.
+    @param n the number of values.
+ */
+static void readDoubles( Coord *dest, unsigned char const *src, int n )
+{
+    if ( hostIsLittle() && sizeof( Coord ) == sizeof( double ) ) {
+        memcpy( dest, src, n * sizeof( double ) );
+        return;
+    }
+    for ( int i = 0; i < n; i++ ) {
+        uint64_t bits = getLE( src + i * sizeof( double ), sizeof( double ) );
+        double v;
+        memcpy( &v, &bits, sizeof( double ) );
+        dest[ i ] = (Coord)v;
+    }
+}
+
+/**
+    The writeBytes function writes bytes to the output file and adds them to the checksum.
+
+    @param output the output file.
+    @param p the bytes to write.
+    @param len the number of bytes, a multiple of 8.
+    @param h the checksum, updated in place.
+ */
+static void writeBytes( FILE *output, void const *p, size_t len, uint64_t *h )
+{
+    fwrite( p, 1, len, output );
+    *h = hashWords( *h, (unsigned char const *)p, len );
+}
+
+/**
+    The writeDoubles function writes doubles to the output file in little-endian order and
+    adds them to the checksum.
+
+    @param output the output file.
+    @param v the values to write.
+    @param n the number of values.
+    @param h the checksum, updated in place.
+ */
+static void writeDoubles( FILE *output, double const *v, int n, uint64_t *h )
+{
+    if ( hostIsLittle() ) {
+        writeBytes( output, v, n * sizeof( double ), h );
+        return;
+    }
+    for ( int i = 0; i < n; i++ ) {
+        uint64_t bits;
+        unsigned char word[ sizeof( double ) ];
+        memcpy( &bits, v + i, sizeof( double ) );
+        putLE( word, bits, sizeof( double ) );
+        writeBytes( output, word, sizeof( word ), h );
+    }
+}
+
+bool isBinary( unsigned char const *head, int len )
+{
+    return len >= BINARY_MAGIC_LEN && memcmp( head, BINARY_MAGIC, BINARY_MAGIC_LEN ) == 0;
+}
+
+bool hasBinaryExtension( char const *fname )
+{
+    size_t len = strlen( fname );
+    size_t extLen = strlen( BINARY_EXTENSION );
+    return len > extLen && strcmp( fname + len - extLen, BINARY_EXTENSION ) == 0;
+}
+
+/**
+    The invalidBinary function records that a binary file is badly formatted and releases
+    its mapping.
+
+    @param status set to LOAD_INVALID.
+    @param map the mapping of the file.
+    @param len the length of the mapping.
+
+    @return NULL, so callers can return the result.
+ */
+static Model *invalidBinary( int *status, void *map, size_t len )
+{
+    *status = LOAD_INVALID;
+    munmap( map, len );
+    return NULL;
+}
+
+Model *loadBinary( char const *fname, Arena *arena, int *status )
+{
+    // Map the whole file, privately, so transforms can change the points in place.
+    int fd = open( fname, O_RDONLY );
+    if ( fd < 0 ) {
+        *status = LOAD_CANT_OPEN;
+        return NULL;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size < HEADER_LEN ) {
+        close( fd );
+        *status = LOAD_INVALID;
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void *map = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED ) {
+        *status = LOAD_CANT_OPEN;
+        return NULL;
+    }
+    unsigned char *file = (unsigned char *)map;
+
+    // Check the header.
+    uint64_t count = getLE( file + COUNT_AT, sizeof( uint32_t ) );
+    int flags = (int)getLE( file + FLAGS_AT, sizeof( uint16_t ) );
+    if ( !isBinary( file, size ) || getLE( file + VERSION_AT, sizeof( uint16_t ) ) != BINARY_VERSION
+         || getLE( file + LENGTH_AT, sizeof( uint64_t ) ) != size || count == 0
+         || count > ( size - HEADER_LEN ) / ENTRY_LEN ) {
+        return invalidBinary( status, map, size );
+    }
+    if ( ( flags & BINARY_CHECKSUM )
+         && hashWords( HASH_SEED, file + HEADER_LEN, ( size - HEADER_LEN ) & ~(size_t)7 )
+            != getLE( file + CHECKSUM_AT, sizeof( uint64_t ) ) ) {
+        return invalidBinary( status, map, size );
+    }
+
+    // Check every directory entry, and count the points.
+    uint64_t total = 0;
+    for ( uint64_t i = 0; i < count; i++ ) {
+        unsigned char *entry = file + HEADER_LEN + i * ENTRY_LEN;
+        uint64_t points = getLE( entry + POINTS_AT, sizeof( uint64_t ) );
+        uint64_t xOff = getLE( entry + XOFF_AT, sizeof( uint64_t ) );
+        uint64_t yOff = getLE( entry + YOFF_AT, sizeof( uint64_t ) );
+        if ( points % 2 != 0 || points > size / sizeof( double ) || xOff % sizeof( double ) != 0
+             || yOff % sizeof( double ) != 0 || xOff > size - points * sizeof( double )
+             || yOff > size - points * sizeof( double ) ) {
+            return invalidBinary( status, map, size );
+        }
+        total += points;
+    }
+    if ( total == 0 || total > INT32_MAX ) {
+        return invalidBinary( status, map, size );
+    }
+
+    // If every array is usable in place, each Model becomes a Chunk of the mapping. Floats
+    // have to be converted, so they are never used in place. Nor are the points in
+    // out-of-core mode, since pages of a private mapping that change can't go back to the
+    // file; they're copied to a spill file instead.
+    bool inPlace = hostIsLittle() && sizeof( Coord ) == sizeof( double ) && !spillOn();
+    for ( uint64_t i = 0; i < count; i++ ) {
+        unsigned char *entry = file + HEADER_LEN + i * ENTRY_LEN;
+        if ( getLE( entry + XOFF_AT, sizeof( uint64_t ) ) % POINT_ALIGN != 0
+             || getLE( entry + YOFF_AT, sizeof( uint64_t ) ) % POINT_ALIGN != 0 ) {
+            inPlace = false;
+        }
+    }
+
+    Model *m = makeModel( inPlace ? 0 : (int)total, arena );
+    Mapping *mapping = m && inPlace ? makeMapping( map, size ) : NULL;
+    if ( !m || ( inPlace && !mapping ) ) {
+        if ( m ) {
+            freeModel( m );
+        }
+        *status = LOAD_NO_MEMORY;
+        munmap( map, size );
+        return NULL;
+    }
+    int pos = 0;
+    for ( uint64_t i = 0; i < count; i++ ) {
+        unsigned char *entry = file + HEADER_LEN + i * ENTRY_LEN;
+        int points = (int)getLE( entry + POINTS_AT, sizeof( uint64_t ) );
+        unsigned char *x = file + getLE( entry + XOFF_AT, sizeof( uint64_t ) );
+        unsigned char *y = file + getLE( entry + YOFF_AT, sizeof( uint64_t ) );
+        if ( points == 0 ) {
+            continue;
+        }
+        if ( inPlace ) {
+            // The Chunks added so far let go of the mapping with the Model, then so does this.
+            if ( !addMappedChunk( m, mapping, (Coord *)x, (Coord *)y, points ) ) {
+                freeModel( m );
+                releaseMapping( mapping );
+                *status = LOAD_NO_MEMORY;
+                return NULL;
+            }
+        } else {
+            // Otherwise copy all the Models into one Chunk.
+            readDoubles( m->head->xList + pos, x, points );
+            readDoubles( m->head->yList + pos, y, points );
+            pos += points;
+        }
+    }
+
+    // The Chunks hold their own references to the mapping.
+    if ( inPlace ) {
+        releaseMapping( mapping );
+    } else {
+        munmap( map, size );
+    }
+    measureModel( m );
+    *status = LOAD_OK;
+    return m;
+}
+
+/**
+    The writeCoords function writes one of the coordinate arrays of a Model's Chunks, with
+    every point in segment order, and adds it to the checksum.
+
+    @param output the output file.
+    @param m the Model.
+    @param useX true to write the x-coordinates, false for the y-coordinates.
+    @param h the checksum, updated in place.
+
+    @return True, or false if there wasn't room to expand a Chunk's points.
+ */
+static bool writeCoords( FILE *output, Model const *m, bool useX, uint64_t *h )
+{
+    double *buffer = NULL;
+    for ( Chunk *c = m->head; c; c = c->next ) {
+        Coord const *coords = useX ? c->xList : c->yList;
+
+        // Indexed Chunks, and floats, have to be expanded into doubles first.
+        double const *v = (double const *)coords;
+        if ( c->idx || sizeof( Coord ) != sizeof( double ) ) {
+            double *bigger = (double *)realloc( buffer, c->count * sizeof( double ) );
+            if ( !bigger ) {
+                free( buffer );
+                return false;
+            }
+            buffer = bigger;
+            expandPoints( c, coords, buffer );
+            v = buffer;
+        }
+        writeDoubles( output, v, c->count, h );
+    }
+    free( buffer );
+    return true;
+}
+
+int saveBinary( Model **list, int count, char const *fname )
+{
+    FILE *output = fopen( fname, "wb" );
+    if ( !output ) {
+        return BINARY_CANT_OPEN;
+    }
+
+    // Lay out the directory, with each array starting on an aligned offset.
+    unsigned char *dir = (unsigned char *)calloc( count ? count : 1, ENTRY_LEN );
+    if ( !dir ) {
+        fclose( output );
+        remove( fname );
+        return BINARY_NO_MEMORY;
+    }
+    uint64_t off = alignUp( HEADER_LEN + (uint64_t)count * ENTRY_LEN );
+    for ( int i = 0; i < count; i++ ) {
+        unsigned char *entry = dir + i * ENTRY_LEN;
+        uint64_t bytes = (uint64_t)list[ i ]->pCount * sizeof( double );
+        strncpy( (char *)entry, list[ i ]->name, ENTRY_NAME_LEN - 1 );
+        putLE( entry + POINTS_AT, list[ i ]->pCount, sizeof( uint64_t ) );
+        putLE( entry + XOFF_AT, off, sizeof( uint64_t ) );
+        off = alignUp( off + bytes );
+        putLE( entry + YOFF_AT, off, sizeof( uint64_t ) );
+        off = alignUp( off + bytes );
+    }
+
+    // Leave room for the header, then write everything it covers.
+    unsigned char header[ HEADER_LEN ] = { 0 };
+    fwrite( header, 1, HEADER_LEN, output );
+    uint64_t h = HASH_SEED;
+    uint64_t pos = HEADER_LEN + (uint64_t)count * ENTRY_LEN;
+    writeBytes( output, dir, (size_t)count * ENTRY_LEN, &h );
+    bool room = true;
+    for ( int i = 0; room && i < count; i++ ) {
+        Model *m = list[ i ];
+        writeBytes( output, padding, alignUp( pos ) - pos, &h );
+        pos = alignUp( pos );
+        room = writeCoords( output, m, true, &h );
+        pos += (uint64_t)m->pCount * sizeof( double );
+
+        writeBytes( output, padding, alignUp( pos ) - pos, &h );
+        pos = alignUp( pos );
+        room = room && writeCoords( output, m, false, &h );
+        pos += (uint64_t)m->pCount * sizeof( double );
+    }
+
+    // A file missing some of its points is no use.
+    if ( !room ) {
+        fclose( output );
+        free( dir );
+        remove( fname );
+        return BINARY_NO_MEMORY;
+    }
+    writeBytes( output, padding, alignUp( pos ) - pos, &h );
+    pos = alignUp( pos );
+
+    // Go back and fill in the header.
+    memcpy( header, BINARY_MAGIC, BINARY_MAGIC_LEN );
+    putLE( header + VERSION_AT, BINARY_VERSION, sizeof( uint16_t ) );
+    putLE( header + FLAGS_AT, BINARY_CHECKSUM, sizeof( uint16_t ) );
+    putLE( header + COUNT_AT, count, sizeof( uint32_t ) );
+    putLE( header + CHECKSUM_AT, h, sizeof( uint64_t ) );
+    putLE( header + LENGTH_AT, pos, sizeof( uint64_t ) );
+    bool ok = fseek( output, 0, SEEK_SET ) == 0
+              && fwrite( header, 1, HEADER_LEN, output ) == HEADER_LEN;
+
+    // A short write anywhere sets the stream's error flag, and the last of the data may
+    // only fail to go out when the file is closed.
+    ok = !ferror( output ) && ok;
+    if ( fclose( output ) != 0 ) {
+        ok = false;
+    }
+    free( dir );
+
+    // Don't leave a truncated file behind to fail when it's loaded.
+    if ( !ok ) {
+        remove( fname );
+        return BINARY_CANT_WRITE;
+    }
+    return BINARY_SAVED;
+}
@@ -0,0 +1,99 @@
+/**
+    @file binary.h
+    @author Brian Morris (bcmorri3)
+
+    The binary.h header file declares functions for reading and writing the binary model
+    format. A binary file holds one or more named Models as little-endian doubles, laid out
+    so a Model can be memory mapped straight from the file without any parsing.
+
+    Layout, all integers little-endian:
+
+        header     magic "P4BN", uint16 version, uint16 flags, uint32 model count,
+                   uint32 reserved, uint64 checksum, uint64 file length (32 bytes)
+        directory  per model: char name[ 24 ], uint64 point count, uint64 offset of the
+                   x-coordinates, uint64 offset of the y-coordinates (48 bytes each)
+        points     the coordinate arrays, each starting on a POINT_ALIGN boundary
+
+    When the BINARY_CHECKSUM flag is set, the checksum covers every byte after the header.
+ */
+
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include <stdbool.h>
+#include "model.h"
+
+/** The first bytes of every binary model file. */
+#define BINARY_MAGIC "P4BN"
+
+/** Number of bytes in BINARY_MAGIC. */
+#define BINARY_MAGIC_LEN 4
+
+/** Version of the binary format written by saveBinary. */
+#define BINARY_VERSION 1
+
+/** Header flag that means the file has a checksum. */
+#define BINARY_CHECKSUM 0x1
+
+/** saveScene writes the binary format for file names ending with this. */
+#define BINARY_EXTENSION ".bin"
+
+/** Return value of saveBinary when the file was written. */
+#define BINARY_SAVED 0
+
+/** Return value of saveBinary when the file couldn't be opened. */
+#define BINARY_CANT_OPEN 1
+
+/** Return value of saveBinary when writing the file failed. */
+#define BINARY_CANT_WRITE 2
+
+/** Return value of saveBinary when there wasn't enough memory to write the file. */
+#define BINARY_NO_MEMORY 3
+
+/**
+    This function reports whether the given header bytes start with BINARY_MAGIC.
+
+    @param head the first bytes of a file.
+    @param len the number of bytes in head.
+
+    @return True if the bytes are the start of a binary model file.
+ */
+bool isBinary( unsigned char const *head, int len );
+
+/**
+    This function reports whether the given output file name should get the binary format.
+
+    @param fname the name of the output file.
+
+    @return True if the name ends with BINARY_EXTENSION.
+ */
+bool hasBinaryExtension( char const *fname );
+
+/**
+    This function loads a binary model file. All the Models in the file are combined, in
+    order, into one Model, the same way loading a saved text scene gives one Model with all
+    of its segments. The file is memory mapped, and each Model in it becomes a Chunk that
+    refers directly to the mapping. Nothing is printed; errors are returned in status.
+
+    @param fname the name of the input file.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+    @param status set to LOAD_OK, or to the reason the file couldn't be loaded.
+
+    @return A pointer to the loaded Model, or NULL if there is an error.
+ */
+Model *loadBinary( char const *fname, Arena *arena, int *status );
+
+/**
+    This function writes the given Models to a binary model file, with a checksum. If
+    writing the file fails, or there isn't enough memory to, the partly written file is
+    removed.
+
+    @param list the Models to write, in order.
+    @param count the number of Models in the list.
+    @param fname the name of the output file.
+
+    @return BINARY_SAVED, BINARY_CANT_OPEN, BINARY_CANT_WRITE or BINARY_NO_MEMORY.
+ */
+int saveBinary( Model **list, int count, char const *fname );
+
+#endif
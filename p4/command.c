@@ -0,0 +1,300 @@
+/**
+    @file command.c
+    @author Brian Morris (bcmorri3)
+
+    The command.c program contains the tokenizer, verb lookup and number parser defined in
+    command.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "command.h"
+
+/** Most significant digits that always fit in a 64-bit integer. */
+#define MAX_DIGITS 19
+
+/** Largest integer a double holds exactly. */
+#define MAX_EXACT ( (uint64_t)1 << 53 )
+
+/** Largest power of ten a double holds exactly. */
+#define MAX_POW10 22
+
+/** Exponent digits past this size can't matter, it keeps the exponent from overflowing. */
+#define EXP_LIMIT 100000
+
+/** Longest token parseNumber will copy for strtod. */
+#define NUMBER_LEN 1000
+
+/** The name of each command, by its index. */
+static char const *const names[ NUM_VALID_COMMANDS ] = {
+    "load", "save", "delete", "list", "translate", "scale", "rotate", "quit", "copy", "merge",
+    "query", "nearest", "render", "intersect", "simplify", "stats",
+    "group", "bounds", "checkpoint", "restore"
+};
+
+/** Powers of ten that are exact doubles. */
+static double const pow10[ MAX_POW10 + 1 ] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+    The isBlank function reports whether a character is whitespace, as isspace() does in
+    the C locale.
+
+    @param ch the character to check.
+
+    @return True if the character separates tokens.
+ */
+static bool isBlank( char ch )
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+/**
+    The isDigit function reports whether a character is a decimal digit.
+
+    @param ch the character to check.
+
+    @return True if the character is between '0' and '9'.
+ */
+static bool isDigit( char ch )
+{
+    return ch >= '0' && ch <= '9';
+}
+
+void tokenizeLine( char const *line, CommandLine *cl )
+{
+    char const *p = line;
+    cl->count = 0;
+    cl->cleanEnd = true;
+
+    while ( 1 ) {
+        // Skip the whitespace in front of the next token.
+        while ( isBlank( *p ) ) {
+            p++;
+        }
+        if ( !*p ) {
+            return;
+        }
+
+        // Too many tokens for any command.
+        if ( cl->count == MAX_TOKENS ) {
+            cl->cleanEnd = false;
+            return;
+        }
+
+        // Record the token, and whether it ends the line cleanly.
+        char const *start = p;
+        while ( *p && !isBlank( *p ) ) {
+            p++;
+        }
+        cl->start[ cl->count ] = start;
+        cl->len[ cl->count ] = p - start;
+        cl->count++;
+        cl->cleanEnd = *p == '\0' || *p == '\n';
+    }
+}
+
+int lookupVerb( char const *word, int len )
+{
+    // Pick the only candidate from the length and first letter, then confirm it.
+    int candidate = INVALID_COMMAND;
+    char const *name = NULL;
+    switch ( len ) {
+        case 4:
+            switch ( word[ 0 ] ) {
+                case 'l':
+                    candidate = word[ 1 ] == 'o' ? LOAD_COMMAND : LIST_COMMAND;
+                    name = word[ 1 ] == 'o' ? "load" : "list";
+                    break;
+                case 's':
+                    candidate = SAVE_COMMAND;
+                    name = "save";
+                    break;
+                case 'q':
+                    candidate = QUIT_COMMAND;
+                    name = "quit";
+                    break;
+                case 'c':
+                    candidate = COPY_COMMAND;
+                    name = "copy";
+                    break;
+            }
+            break;
+        case 5:
+            if ( word[ 0 ] == 's' && word[ 1 ] == 't' ) {
+                candidate = STATS_COMMAND;
+                name = "stats";
+            } else if ( word[ 0 ] == 's' ) {
+                candidate = SCALE_COMMAND;
+                name = "scale";
+            } else if ( word[ 0 ] == 'm' ) {
+                candidate = MERGE_COMMAND;
+                name = "merge";
+            } else if ( word[ 0 ] == 'q' ) {
+                candidate = QUERY_COMMAND;
+                name = "query";
+            } else if ( word[ 0 ] == 'g' ) {
+                candidate = GROUP_COMMAND;
+                name = "group";
+            }
+            break;
+        case 6:
+            if ( word[ 0 ] == 'd' ) {
+                candidate = DELETE_COMMAND;
+                name = "delete";
+            } else if ( word[ 0 ] == 'r' && word[ 1 ] == 'o' ) {
+                candidate = ROTATE_COMMAND;
+                name = "rotate";
+            } else if ( word[ 0 ] == 'r' ) {
+                candidate = RENDER_COMMAND;
+                name = "render";
+            } else if ( word[ 0 ] == 'b' ) {
+                candidate = BOUNDS_COMMAND;
+                name = "bounds";
+            }
+            break;
+        case 7:
+            if ( word[ 0 ] == 'n' ) {
+                candidate = NEAREST_COMMAND;
+                name = "nearest";
+            } else if ( word[ 0 ] == 'r' ) {
+                candidate = RESTORE_COMMAND;
+                name = "restore";
+            }
+            break;
+        case 8:
+            candidate = SIMPLIFY_COMMAND;
+            name = "simplify";
+            break;
+        case 9:
+            if ( word[ 0 ] == 't' ) {
+                candidate = TRANSLATE_COMMAND;
+                name = "translate";
+            } else if ( word[ 0 ] == 'i' ) {
+                candidate = INTERSECT_COMMAND;
+                name = "intersect";
+            }
+            break;
+        case 10:
+            candidate = CHECKPOINT_COMMAND;
+            name = "checkpoint";
+            break;
+    }
+
+    if ( name && memcmp( word, name, len ) == 0 ) {
+        return candidate;
+    }
+    return INVALID_COMMAND;
+}
+
+bool parseNumber( char const *token, int len, double *value )
+{
+    int i = 0;
+    bool negative = false;
+    if ( i < len && ( token[ i ] == '+' || token[ i ] == '-' ) ) {
+        negative = token[ i ] == '-';
+        i++;
+    }
+
+    // Collect up to MAX_DIGITS significant digits, noting where the decimal point goes.
+    uint64_t mant = 0;
+    int digits = 0;
+    int sigDigits = 0;
+    int exp10 = 0;
+    bool inexact = false;
+    for ( ; i < len && isDigit( token[ i ] ); i++, digits++ ) {
+        if ( sigDigits < MAX_DIGITS ) {
+            mant = mant * 10 + ( token[ i ] - '0' );
+            sigDigits += mant != 0;
+        } else {
+            exp10++;
+            inexact |= token[ i ] != '0';
+        }
+    }
+    if ( i < len && token[ i ] == '.' ) {
+        for ( i++; i < len && isDigit( token[ i ] ); i++, digits++ ) {
+            if ( sigDigits < MAX_DIGITS ) {
+                mant = mant * 10 + ( token[ i ] - '0' );
+                sigDigits += mant != 0;
+                exp10--;
+            } else {
+                inexact |= token[ i ] != '0';
+            }
+        }
+    }
+    if ( digits == 0 ) {
+        return false;
+    }
+
+    // An exponent needs at least one digit.
+    if ( i < len && ( token[ i ] == 'e' || token[ i ] == 'E' ) ) {
+        i++;
+        bool expNegative = false;
+        if ( i < len && ( token[ i ] == '+' || token[ i ] == '-' ) ) {
+            expNegative = token[ i ] == '-';
+            i++;
+        }
+        if ( i == len || !isDigit( token[ i ] ) ) {
+            return false;
+        }
+        int e = 0;
+        for ( ; i < len && isDigit( token[ i ] ); i++ ) {
+            if ( e < EXP_LIMIT ) {
+                e = e * 10 + ( token[ i ] - '0' );
+            }
+        }
+        exp10 += expNegative ? -e : e;
+    }
+
+    // Anything left over isn't part of a plain number.
+    if ( i != len ) {
+        return false;
+    }
+
+    // When both the digits and the power of ten are exact doubles, one multiply or divide
+    // gives the correctly rounded value, the same one strtod would.
+    if ( !inexact && mant <= MAX_EXACT && exp10 >= -MAX_POW10 && exp10 <= MAX_POW10 ) {
+        double v = (double)mant;
+        v = exp10 < 0 ? v / pow10[ -exp10 ] : v * pow10[ exp10 ];
+        *value = negative ? -v : v;
+        return true;
+    }
+
+    // Otherwise let strtod do it, leaving out-of-range values to scanf.
+    if ( len > NUMBER_LEN ) {
+        return false;
+    }
+    char copy[ NUMBER_LEN + 1 ];
+    memcpy( copy, token, len );
+    copy[ len ] = '\0';
+    errno = 0;
+    *value = strtod( copy, NULL );
+    return errno != ERANGE;
+}
+
+char const *commandName( int index )
+{
+    return names[ index ];
+}
+
+bool readsOnly( int index )
+{
+    switch ( index ) {
+        case SAVE_COMMAND:
+        case LIST_COMMAND:
+        case QUERY_COMMAND:
+        case NEAREST_COMMAND:
+        case RENDER_COMMAND:
+        case INTERSECT_COMMAND:
+        case STATS_COMMAND:
+        case BOUNDS_COMMAND:
+        case INVALID_COMMAND:
+            return true;
+        default:
+            return false;
+    }
+}
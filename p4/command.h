@@ -0,0 +1,164 @@
+/**
+    @file command.h
+    @author Brian Morris (bcmorri3)
+
+    The command.h header file declares the single-pass tokenizer and verb lookup used by
+    the drawing program. A command line is split into whitespace-separated tokens in place,
+    without copying or allocating, and simple decimal numbers are converted without going
+    through scanf.
+ */
+
+#ifndef _COMMAND_H_
+#define _COMMAND_H_
+
+#include <stdbool.h>
+
+/** The index value of an invalid command. */
+#define INVALID_COMMAND -1
+
+/** The index value of the load command. */
+#define LOAD_COMMAND 0
+
+/** The index value of the save command. */
+#define SAVE_COMMAND 1
+
+/** The index value of the delete command. */
+#define DELETE_COMMAND 2
+
+/** The index value of the list command. */
+#define LIST_COMMAND 3
+
+/** The index value of the translate command. */
+#define TRANSLATE_COMMAND 4
+
+/** The index value of the scale command. */
+#define SCALE_COMMAND 5
+
+/** The index value of the rotate command. */
+#define ROTATE_COMMAND 6
+
+/** The index value of the quit command. */
+#define QUIT_COMMAND 7
+
+/** The index value of the copy command. */
+#define COPY_COMMAND 8
+
+/** The index value of the merge command. */
+#define MERGE_COMMAND 9
+
+/** The index value of the query command. */
+#define QUERY_COMMAND 10
+
+/** The index value of the nearest command. */
+#define NEAREST_COMMAND 11
+
+/** The index value of the render command. */
+#define RENDER_COMMAND 12
+
+/** The index value of the intersect command. */
+#define INTERSECT_COMMAND 13
+
+/** The index value of the simplify command. */
+#define SIMPLIFY_COMMAND 14
+
+/** The index value of the stats command. */
+#define STATS_COMMAND 15
+
+/** The index value of the group command. */
+#define GROUP_COMMAND 16
+
+/** The index value of the bounds command. */
+#define BOUNDS_COMMAND 17
+
+/** The index value of the checkpoint command. */
+#define CHECKPOINT_COMMAND 18
+
+/** The index value of the restore command. */
+#define RESTORE_COMMAND 19
+
+/** The number of valid commands for the program. */
+#define NUM_VALID_COMMANDS 20
+
+/** The length of the string used to parse parameters, the longest line a command uses. */
+#define PARAM_LEN 1000
+
+/**
+    The most tokens recorded for a line, the verb plus the four parameters of the longest
+    command. A line with more tokens than this is flagged by cleanEnd.
+ */
+#define MAX_TOKENS 5
+
+/** The tokens of a command line, pointing into the line itself. */
+typedef struct {
+    /** Number of tokens found, at most MAX_TOKENS. */
+    int count;
+
+    /** Start of each token. */
+    char const *start[ MAX_TOKENS ];
+
+    /** Length of each token. */
+    int len[ MAX_TOKENS ];
+
+    /**
+        True if the character right after the last token is a newline or the end of the
+        line, which is what the commands require. It is false if the line had more than
+        MAX_TOKENS tokens.
+     */
+    bool cleanEnd;
+} CommandLine;
+
+/**
+    This function splits a line into tokens separated by whitespace, the same way a series
+    of scanf "%s" conversions would.
+
+    @param line the null terminated line to split.
+    @param cl the CommandLine to fill in.
+ */
+void tokenizeLine( char const *line, CommandLine *cl );
+
+/**
+    This function returns the index of the command with the given name. Rather than
+    comparing against every name, it switches on the length and first letter.
+
+    @param word the start of the name, not necessarily null terminated.
+    @param len the length of the name.
+
+    @return The index of the command, or INVALID_COMMAND if there isn't one with the name.
+ */
+int lookupVerb( char const *word, int len );
+
+/**
+    This function reports whether a command only reads the Scene, apart from caches the
+    Scene locks for itself, so the server can run it alongside other such commands.
+
+    @param index the index of the command, or INVALID_COMMAND.
+
+    @return True if the command doesn't change the Scene.
+ */
+bool readsOnly( int index );
+
+/**
+    This function returns the name of a command.
+
+    @param index the index of the command, which must be valid.
+
+    @return The name, as it is typed.
+ */
+char const *commandName( int index );
+
+/**
+    This function converts a token that is a plain decimal number: an optional sign, digits
+    with an optional decimal point, and an optional exponent. Those are exactly the tokens
+    scanf's "%lf" consumes completely, and the value is the same one scanf would store.
+    Anything else, including values that overflow or underflow, is rejected so the caller
+    can fall back to scanf.
+
+    @param token the start of the token, not necessarily null terminated.
+    @param len the length of the token.
+    @param value set to the value of the number.
+
+    @return True if the token was a plain decimal number.
+ */
+bool parseNumber( char const *token, int len, double *value );
+
+#endif
@@ -11,44 +11,24 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <math.h>
 #include <string.h>
+#include <float.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "scene.h"
 #include "model.h"
-
-/** The array position of an x-coordinate to a point in a line segment. */
-#define X_COORD 0
-
-/** The array position of a y-coordinate to a point in a line segment. */
-#define Y_COORD 1
-
-/** The value of pi. */
-#define PI acos( -1.0 )
-
-/** The number of degrees that must be used to convert degrees to radians. */
-#define DEG_TO_RAD 180
-
-/** The number of valid commands for the program. */
-#define NUM_VALID_COMMANDS 10
-
-/** The maximum length of a command string. */
-#define MAX_COMMAND_LEN 9
-
-/** The format string used to scan a command string. */
-#define SCAN_COMMAND "%10s"
+#include "command.h"
+#include "pool.h"
+#include "render.h"
+#include "simplify.h"
+#include "output.h"
+#include "server.h"
 
 /** The maximum length of a model name or file name. */
 #define NAME_LEN 20
 
-/** The format string used to scan the parameters of the load command. */
-#define SCAN_LOAD "%*s%21s%21s"
-
-/** The format string used to scan the parameters of the save command. */
-#define SCAN_SAVE "%*s%21s"
-
-/** The format string used to scan the parameters of the delete command. */
-#define SCAN_DELETE "%*s%21s"
-
 /** The format string used to scan the parameters of the translate command. */
 #define SCAN_TRANSLATE "%*s%21s%lf%lf"
 
@@ -58,101 +38,159 @@
 /** The format string used to scan the parameters of the rotate command. */
 #define SCAN_ROTATE "%*s%21s%lf"
 
-/** The format string used to scan the parameters of the copy command. */
-#define SCAN_COPY "%*s%21s%21s"
+/** The format string used to scan the parameters of the query command. */
+#define SCAN_QUERY "%*s%lf%lf%lf%lf"
 
-/** The format string used to scan the parameters of the merge command. */
-#define SCAN_MERGE "%*s%21s%21s%21s"
+/** The format string used to scan the parameters of the nearest command. */
+#define SCAN_NEAREST "%*s%lf%lf"
 
-/** The index value of an invalid command. */
-#define INVALID_COMMAND -1
+/** The format string used to scan the parameters of the render command. */
+#define SCAN_RENDER "%*s%21s%lf%lf"
 
-/** The index value of the load command. */
-#define LOAD_COMMAND 0
+/** The format string used to scan the parameters of the simplify command. */
+#define SCAN_SIMPLIFY "%*s%21s%lf"
 
-/** The index value of the save command. */
-#define SAVE_COMMAND 1
+/** The option that runs the commands in a file instead of standard input. */
+#define SCRIPT_OPTION "--script"
 
-/** The index value of the delete command. */
-#define DELETE_COMMAND 2
+/** The option that serves the Scene to clients on a Unix-domain socket. */
+#define SERVE_OPTION "--serve"
 
-/** The index value of the list command. */
-#define LIST_COMMAND 3
+/** The option that sends standard input to a server and prints its replies. */
+#define CONNECT_OPTION "--connect"
 
-/** The index value of the translate command. */
-#define TRANSLATE_COMMAND 4
+/** Size of the buffer for error messages in script mode. */
+#define SCRIPT_BUFFER ( 1 << 16 )
 
-/** The index value of the scale command. */
-#define SCALE_COMMAND 5
+/** The most names any command takes. */
+#define MAX_NAMES 3
 
-/** The index value of the rotate command. */
-#define ROTATE_COMMAND 6
+/** The most numbers any command takes. */
+#define MAX_NUMS 4
 
-/** The index value of the quit command. */
-#define QUIT_COMMAND 7
-
-/** The index value of the copy command. */
-#define COPY_COMMAND 8
-
-/** The index value of the merge command. */
-#define MERGE_COMMAND 9
-
-/** The length of the string used to parse parameters. */
-#define PARAM_LEN 1000
+/**
+    The character that ends a command line, besides a newline. The rotate command has
+    always accepted a '0' here instead of the null character the others accept.
+ */
+#define END_CHAR '\0'
 
-/** The number of matches that fscanf must find for a command with 1 parameter to be valid. */
-#define ONE_REQUIRED 1
+/** The character accepted in place of END_CHAR by the rotate command. */
+#define ROTATE_END_CHAR '0'
 
-/** The number of matches that fscanf must find for a command with 2 parameters to be valid. */
-#define TWO_REQUIRED 2
+/** The parameters of a command, once they have been parsed. */
+typedef struct {
+    /** The Model and file names, in the order they appear. */
+    char name[ MAX_NAMES ][ NAME_LEN + 2 ];
 
-/** The number of matches that fscanf must find for a command with 3 parameters to be valid. */
-#define THREE_REQUIRED 3
+    /** The numbers, in the order they appear. */
+    double num[ MAX_NUMS ];
+} Params;
 
 /**
-    The translate function translates a point by adding the given value a to the x-coordinate
-    of a point and the value b to the y-coordinate of a point.
+    The reportInvalid function prints the error message for an invalid command.
 
-    @param pt the point to translate.
-    @param a the value to translate the x-coordinate by.
-    @param b the value to translate the y-coordinate by.
+    @param commandNum the number of the invalid command.
  */
-void translate( double pt[ NUM_COORDS ], double a, double b )
+static void reportInvalid( int commandNum )
 {
-    pt[ X_COORD ] += a;
-    pt[ Y_COORD ] += b;
+    fprintf( errStream(), "Command %d invalid\n", commandNum );
 }
 
 /**
-    The scale function scales a point by multiplying both the x-coordinate and y-coordinate of
-    a point by the value of a.
-
-    @param pt the point to scale.
-    @param a the scaling factor of the point.
-    @param b a second double parameter for other functions that need two parameters, unused here.
+    The scanParams function is the slow path for parsing a command with numeric parameters.
+    It runs the line through fscanf, the way every command used to, and is only used for
+    numbers parseNumber doesn't accept, such as "1e", "0x10", "inf" or "1-2", so they are
+    still treated exactly as scanf treats them.
+
+    @param params the input line.
+    @param scan the scanf format for the command.
+    @param names the number of names the command takes, zero or one.
+    @param expected the number of values the format must match.
+    @param endChar the character accepted after the last parameter, besides a newline.
+    @param p the Params to fill in.
+
+    @return True if the parameters are valid.
  */
-void scale( double pt[ NUM_COORDS ], double a, double b )
+static bool scanParams( char const *params, char const *scan, int names, int expected,
+                        char endChar, Params *p )
 {
-    pt[ X_COORD ] *= a;
-    pt[ Y_COORD ] *= a;
+    // Char to determine if there is any input remaining on the input line.
+    char trailingChar;
+
+    // Treat params as a file to ensure that the input cursor is moved properly.
+    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+
+    // The formats take the name first, if there is one, then the numbers. Extra arguments
+    // are ignored.
+    bool valid;
+    if ( names ) {
+        valid = fscanf( sparams, scan, p->name[ 0 ], &p->num[ 0 ], &p->num[ 1 ] ) == expected;
+    } else {
+        valid = fscanf( sparams, scan, &p->num[ 0 ], &p->num[ 1 ], &p->num[ 2 ],
+                        &p->num[ 3 ] ) == expected;
+    }
+
+    // If there is additional input after the last parameter, it is invalid.
+    if ( valid && fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n'
+         && trailingChar != EOF && trailingChar != endChar ) {
+        valid = false;
+    }
+
+    // If the Model name is too long, it is invalid.
+    if ( valid && names && strlen( p->name[ 0 ] ) > NAME_LEN ) {
+        valid = false;
+    }
+
+    fclose( sparams );
+    return valid;
 }
 
 /**
-    The rotate function rotates a point by the given angle a using the rotation formula commonly
-    used in linear algebra and trigonometry.
-
-    @param pt the point to rotate.
-    @param a the angle of the rotation.
-    @param b a second double parameter for other functions that need two parameters, unused here.
+    The parseParams function parses the parameters of a command from its tokens: first the
+    given number of names, then the given number of numbers, with nothing after them. Names
+    longer than NAME_LEN are invalid. If a number isn't a plain decimal number, the line is
+    handed to scanParams so odd input still gets scanf's treatment.
+
+    @param cl the tokens of the line.
+    @param params the input line.
+    @param names the number of names the command takes.
+    @param nums the number of numbers the command takes.
+    @param scan the scanf format for commands with numbers, or NULL.
+    @param endChar the character accepted after the last parameter, besides a newline.
+    @param p the Params to fill in.
+
+    @return True if the parameters are valid.
  */
-void rotate( double pt[ NUM_COORDS ], double a, double b )
+static bool parseParams( CommandLine const *cl, char const *params, int names, int nums,
+                         char const *scan, char endChar, Params *p )
 {
-    // Temporary x and y variables as rotation depends on the original x and y values.
-    double x = pt[ X_COORD ];
-    double y = pt[ Y_COORD ];
+    // A name that's too long always makes the command invalid.
+    for ( int i = 1; i <= names && i < cl->count; i++ ) {
+        if ( cl->len[ i ] > NAME_LEN ) {
+            return false;
+        }
+    }
 
-    pt[ X_COORD ] = x * cos( a * PI / DEG_TO_RAD ) - y * sin( a * PI / DEG_TO_RAD );
-    pt[ Y_COORD ] = x * sin( a * PI / DEG_TO_RAD ) + y * cos( a * PI / DEG_TO_RAD );
+    // Every token after the names should be a plain number, or scanf has to decide.
+    for ( int i = names + 1; i < cl->count; i++ ) {
+        double value;
+        if ( !parseNumber( cl->start[ i ], cl->len[ i ], &value ) ) {
+            return scan && scanParams( params, scan, names, names + nums, endChar, p );
+        }
+        if ( i - names - 1 < nums ) {
+            p->num[ i - names - 1 ] = value;
+        }
+    }
+
+    // Then there must be exactly the right number of tokens, with nothing after the last.
+    if ( cl->count != 1 + names + nums || !cl->cleanEnd ) {
+        return false;
+    }
+    for ( int i = 0; i < names; i++ ) {
+        memcpy( p->name[ i ], cl->start[ i + 1 ], cl->len[ i + 1 ] );
+        p->name[ i ][ cl->len[ i + 1 ] ] = '\0';
+    }
+    return true;
 }
 
 /**
@@ -174,87 +212,29 @@ void flushInput( Scene *s )
     }
 }
 
-/**
-    The getValidCommand function returns the array index of a valid command if the given string
-    is a valid command. If the command is invalid -1 is returned instead.
-
-    @param commmand the command that needs to be validated.
-
-    @return The array index of the valid command, or -1 if invalid.
- */
-int getValidCommand( char const * command )
-{
-    // Valid command list.
-    char *validCommands[] = { "load", "save", "delete", "list", "translate", "scale", "rotate",
-                              "quit", "copy", "merge" };
-    // Find a match.
-    for ( int i = 0; i < NUM_VALID_COMMANDS; i++ ) {
-        if ( strcmp( command, validCommands[ i ] ) == 0 ) {
-            return i;
-        }
-    }
-
-    // No match found.
-    return INVALID_COMMAND;
-}
-
 /**
     The loadCommand function loads a Model into the given scene. If the command parameters are
     invalid, an error message is output and the Model is not added to the scene.
 
     @param s the Scene to add a model to.
     @param commandNum the number of the command that issued a model to be loaded.
+    @param cl the tokens of the input line.
     @param params the input string that contains the parameters for loading a model.
  */
-void loadCommand( Scene *s, int commandNum, char const * params )
+void loadCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for Model name.
-    char modelName[ NAME_LEN + 2 ];
-    // Array for file name.
-    char fileName[ NAME_LEN + 2 ];
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
-
-    // If there are not two matches, print error message.
-    if ( fscanf( sparams, SCAN_LOAD, modelName, fileName ) != TWO_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
+    // The Model name and file name.
+    Params p;
 
-    // If there is additional input after the second parameter.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If the name of the Model or file name is too long, print error message.
-    if ( strlen( modelName ) > NAME_LEN || strlen( fileName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // Determine if the scene already contains the model.
-    bool hasModel = containsModel( s, modelName );
-
-    // If the model is already contained within the scene, print error message.
-    if ( hasModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If the parameters are invalid, or the model is already contained within the scene,
+    // print error message.
+    if ( !parseParams( cl, params, 2, 0, NULL, END_CHAR, &p ) || containsModel( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
     // Add the model to the scene.
-    addModel( s, fileName, modelName );
-
-    // Close file object.
-    fclose( sparams );
+    addModel( s, p.name[ 1 ], p.name[ 0 ], commandNum );
 }
 
 /**
@@ -263,45 +243,22 @@ void loadCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene to save to an output file.
     @param commandNum the number of the command that issued the Scene to be saved.
+    @param cl the tokens of the input line.
     @param params the input string that contains the parameters to save the Scene.
  */
-void saveCommand( Scene *s, int commandNum, char const * params )
+void saveCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for file name.
-    char fileName[ NAME_LEN + 2 ];
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+    // The file name.
+    Params p;
 
-    // If the number of required parameters is not met, print error message.
-    if ( fscanf( sparams, SCAN_SAVE, fileName ) != ONE_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If there is trailing input, print error message.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If the file name is too long, print error message.
-    if ( strlen( fileName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If the parameters are invalid, print error message.
+    if ( !parseParams( cl, params, 1, 0, NULL, END_CHAR, &p ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
     // Save the scene.
-    saveScene( s, fileName );
-
-    // Close file object.
-    fclose( sparams );
+    saveScene( s, p.name[ 0 ] );
 }
 
 /**
@@ -310,56 +267,23 @@ void saveCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene to delete a Model from.
     @param commandNum the number of the command that issued a Model to be deleted.
+    @param cl the tokens of the input line.
     @param params the input string that contains the parameters to delete a Model.
  */
-void deleteCommand( Scene *s, int commandNum, char const * params )
+void deleteCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for the model name.
-    char modelName[ NAME_LEN + 2 ];
-
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+    // The Model name.
+    Params p;
 
-    // If the number of required parameters is not met, print error message.
-    if ( fscanf( sparams, SCAN_DELETE, modelName ) != ONE_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If there is trailing input, print error message.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If the Model name is too long, print error message.
-    if ( strlen( modelName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // Determine if the Scene contains the Model.
-    bool hasModel = containsModel( s, modelName );
-
-    // If the Model is not found within the Scene, print error message.
-    if ( !hasModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If the parameters are invalid, or the Model is not found within the Scene, print
+    // error message.
+    if ( !parseParams( cl, params, 1, 0, NULL, END_CHAR, &p ) || !containsModel( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
     // Remove the model from the Scene.
-    removeModel( s, modelName );
-
-    // Close the file object.
-    fclose( sparams );
+    removeModel( s, p.name[ 0 ] );
 }
 
 /**
@@ -369,200 +293,366 @@ void deleteCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene containing the Models to display.
     @param commandNum the number of the command that issued the Models of a Scene to be listed.
-    @param params the input string that contains the parameters to list a Scene.
+    @param cl the tokens of the input line.
  */
-void listCommand( Scene *s, int commandNum, char const * params )
+void listCommand( Scene *s, int commandNum, CommandLine const *cl )
 {
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
-
-    // If there is any other input on the params line, print error message.
-    if ( fscanf( sparams, "%*s%c", &trailingChar ) == 1 && trailingChar != '\n'
-         && trailingChar != EOF && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If there is any other input on the params line, print error message. A blank line
+    // that repeats the command has no tokens, and is fine.
+    if ( cl->count > 0 && ( cl->count > 1 || !cl->cleanEnd ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
     // List the Scene.
     list( s );
-
-    // Close the file object.
-    fclose( sparams );
 }
 
 /**
-    The translateCommand function applies the translate function to a given Model in the given
-    Scene. If the Model cannot be found in the Scene or any of the required parameters are invalid,
-    an error message is output and the translate function is not applied to the Model.
-
-    @param s the Scene containing the Model to translate.
-    @param commandNum the number of the command that issued a Model to be translated.
-    @param params the input string that contains the parameters to translate a Model.
+    The transformCommand function applies a transform to a given Model in the given Scene.
+    It handles the translate, scale and rotate commands, which differ only in how many
+    numbers they take and the Transform those numbers make. In place of a Model's name, the
+    name of a group or a pattern like "Mia-*" transforms every Model it stands for. If no
+    Model can be found in the Scene or any of the required parameters are invalid, an error
+    message is output and nothing is transformed.
+
+    @param s the Scene containing the Model to transform.
+    @param commandNum the number of the command that issued a Model to be transformed.
+    @param commandIndex which of the transform commands this is.
+    @param cl the tokens of the input line.
+    @param params the input string that contains the parameters to transform a Model.
  */
-void translateCommand( Scene *s, int commandNum, char const * params )
+void transformCommand( Scene *s, int commandNum, int commandIndex, CommandLine const *cl,
+                       char const * params )
 {
-    // Array for the Model name.
-    char modelName[ NAME_LEN + 2 ];
-    // First double value used for translation.
-    double a;
-    // Second double value used for translation.
-    double b;
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+    // The Model name, and the values for the transform.
+    Params p;
+    // Whether the parameters are valid.
+    bool valid;
+
+    if ( commandIndex == TRANSLATE_COMMAND ) {
+        valid = parseParams( cl, params, 1, 2, SCAN_TRANSLATE, END_CHAR, &p );
+    } else if ( commandIndex == SCALE_COMMAND ) {
+        valid = parseParams( cl, params, 1, 1, SCAN_SCALE, END_CHAR, &p );
+    } else {
+        valid = parseParams( cl, params, 1, 1, SCAN_ROTATE, ROTATE_END_CHAR, &p );
+    }
 
-    // If the number of required parameters is not met, print error message.
-    if ( fscanf( sparams, SCAN_TRANSLATE, modelName, &a, &b ) != THREE_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If the parameters are invalid, print error message.
+    if ( !valid ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // If there is trailing input, print error message.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
+    // Make the Transform.
+    Transform t;
+    if ( commandIndex == TRANSLATE_COMMAND ) {
+        t = makeTranslate( p.num[ 0 ], p.num[ 1 ] );
+    } else if ( commandIndex == SCALE_COMMAND ) {
+        t = makeScale( p.num[ 0 ] );
+    } else {
+        t = makeRotate( p.num[ 0 ] );
     }
 
-    // If the Model name is too long, print error message.
-    if ( strlen( modelName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
+    // Determine if the Scene contains the Model, transforming it if so.
+    if ( !transformScene( s, p.name[ 0 ], &t ) ) {
+        reportInvalid( commandNum );
     }
+}
 
-    // Determine if the Scene contains the Model.
-    bool hasModel = applyToScene( s, modelName, &translate, a, b );
-    // If it doesn't have the Model, print error message.
-    if ( !hasModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
+/**
+    The groupCommand function adds a member to a group of Models, defining the group if it's
+    new. The member is a Model name, or an fnmatch pattern such as "Mia-*" for the names of
+    Models. A transform given the group's name then applies to every Model in the Scene
+    that is a member at the time. If the parameters are invalid, or the group's name is
+    the name of a Model, an error message is output and the group is left as it was.
+
+    @param s the Scene to define the group in.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the group's name and the member.
+ */
+void groupCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
+{
+    // The group name and the member.
+    Params p;
+
+    // If the parameters are invalid, or a Model has the group's name, print error message.
+    if ( !parseParams( cl, params, 2, 0, NULL, END_CHAR, &p ) || containsModel( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
+        return;
     }
 
-    // Close the file object.
-    fclose( sparams );
+    // Add the member to the group.
+    addToGroup( s, p.name[ 0 ], p.name[ 1 ] );
 }
 
 /**
-    The scaleCommand function applies the scale function to a given Model in the given Scene.
-    If the Model cannot be found in the Scene or any of the required parameters are invalid,
-    an error message is output and the scale function is not applied to the Model.
+    The checkpointCommand function saves the Models of the Scene under a name, to be put
+    back later by the restore command. If the parameters are invalid, or there is any
+    trailing input after them, the command is considered invalid and an error message is
+    output.
+
+    @param s the Scene.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the checkpoint's name.
+ */
+void checkpointCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
+{
+    // The checkpoint name.
+    Params p;
 
-    @param s the Scene containing the Model to scale.
-    @param commandNum the number of the command that issued a Model to be scaled.
-    @param params the input string that contains the parameters to scale a Model.
+    // If the parameters are invalid, print error message.
+    if ( !parseParams( cl, params, 1, 0, NULL, END_CHAR, &p ) ) {
+        reportInvalid( commandNum );
+        return;
+    }
+
+    // Save the Models.
+    checkpointScene( s, p.name[ 0 ] );
+}
+
+/**
+    The restoreCommand function puts back the Models saved by a checkpoint command. If the
+    parameters are invalid, there is any trailing input after them, or there is no
+    checkpoint with the name, the command is considered invalid and an error message is
+    output.
+
+    @param s the Scene.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the checkpoint's name.
  */
-void scaleCommand( Scene *s, int commandNum, char const * params )
+void restoreCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for the Model name.
-    char modelName[ NAME_LEN + 2 ];
-    // The scaling factor of the scale command.
-    double a;
-    // Dummy variable for second parameter.
-    double b = 0;
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
+    // The checkpoint name.
+    Params p;
 
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+    // If the parameters are invalid, or there's no such checkpoint, print error message.
+    if ( !parseParams( cl, params, 1, 0, NULL, END_CHAR, &p ) || !restoreScene( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
+    }
+}
 
-    // If the input line does not contain the number of required parameters, print error message.
-    if ( fscanf( sparams, SCAN_SCALE, modelName, &a ) != TWO_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+/**
+    The boundsCommand function prints the bounding box of a Model, or of every Model a group
+    or pattern stands for, or of the whole Scene if no name is given. If the name is too
+    long, there is trailing input after it, or there are no Models to bound, the command is
+    considered invalid and an error message is output.
+
+    @param s the Scene.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+ */
+void boundsCommand( Scene *s, int commandNum, CommandLine const *cl )
+{
+    // A blank line repeating the command has no tokens, like one with just the verb.
+    if ( cl->count > 2 || !cl->cleanEnd || ( cl->count == 2 && cl->len[ 1 ] > NAME_LEN ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // If the input line contains any trailing input, print error message.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
+    // The name, if there is one.
+    char name[ NAME_LEN + 1 ];
+    if ( cl->count == 2 ) {
+        memcpy( name, cl->start[ 1 ], cl->len[ 1 ] );
+        name[ cl->len[ 1 ] ] = '\0';
     }
 
-    // If the Model name is too loing, print error message.
-    if ( strlen( modelName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
+    if ( !boundsScene( s, cl->count == 2 ? name : NULL ) ) {
+        reportInvalid( commandNum );
     }
+}
 
-    // Determine if the given Scene contains the Model.
-    bool hasModel = applyToScene( s, modelName, &scale, a, b );
+/**
+    The queryCommand function prints every segment that touches a rectangle, given by two
+    opposite corners. If the parameters are invalid, or there is any trailing input after
+    them, the command is considered invalid and an error message is output.
+
+    @param s the Scene to search.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the corners of the rectangle.
+ */
+void queryCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
+{
+    // The coordinates of the corners.
+    Params p;
 
-    // If it doesn't contain the Model, print error message.
-    if ( !hasModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
+    // If the parameters are invalid, print error message.
+    if ( !parseParams( cl, params, 0, 4, SCAN_QUERY, END_CHAR, &p ) ) {
+        reportInvalid( commandNum );
+        return;
     }
 
-    // Close file object.
-    fclose( sparams );
+    // Print the segments in the rectangle.
+    queryScene( s, p.num[ 0 ], p.num[ 1 ], p.num[ 2 ], p.num[ 3 ] );
 }
 
 /**
-    The rotateCommand function applies the rotate function to a given Model in the given Scene.
-    If the Model cannot be found in the Scene or any of the required parameters are invalid,
-    an error message is output and the rotate function is not applied to the Model.
+    The nearestCommand function prints the segment nearest a point. If the parameters are
+    invalid, there is any trailing input after them, or there are no segments in the Scene,
+    the command is considered invalid and an error message is output.
+
+    @param s the Scene to search.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the point.
+ */
+void nearestCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
+{
+    // The coordinates of the point.
+    Params p;
 
-    @param s the Scene containing the Model to rotate.
-    @param commandNum the number of the command that issued a Model to be rotated.
-    @param params the input string that contains the parameters to rotate a Model.
+    // If the parameters are invalid or there is nothing to find, print error message.
+    if ( !parseParams( cl, params, 0, 2, SCAN_NEAREST, END_CHAR, &p )
+         || !nearestScene( s, p.num[ 0 ], p.num[ 1 ] ) ) {
+        reportInvalid( commandNum );
+    }
+}
+
+/**
+    The renderCommand function draws the given Scene into an image file. If the command
+    parameters are invalid, or the width or height isn't a whole number from 1 to
+    MAX_IMAGE_SIZE, an error message is output and the file is not created.
+
+    @param s the Scene to draw.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the file name and the size of the image.
  */
-void rotateCommand( Scene *s, int commandNum, char const * params )
+void renderCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for the Model name.
-    char modelName[ NAME_LEN + 2 ];
-    // The angle to rotate the Model by.
-    double a;
-    // Dummy variable for second parameter.
-    double b = 0;
+    // The file name, then the width and height.
+    Params p;
 
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
+    // If the parameters are invalid, or the size can't be used, print error message.
+    bool valid = parseParams( cl, params, 1, 2, SCAN_RENDER, END_CHAR, &p );
+    for ( int i = 0; valid && i < 2; i++ ) {
+        valid = p.num[ i ] >= 1 && p.num[ i ] <= MAX_IMAGE_SIZE && p.num[ i ] == (int)p.num[ i ];
+    }
+    if ( !valid ) {
+        reportInvalid( commandNum );
+        return;
+    }
 
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
+    // Draw the scene.
+    renderScene( s, p.name[ 0 ], (int)p.num[ 0 ], (int)p.num[ 1 ] );
+}
 
-    // If the required number of parameters is not found, print error message.
-    if ( fscanf( sparams, SCAN_ROTATE, modelName, &a ) != TWO_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+/**
+    The simplifyCommand function simplifies the polylines of a Model in the given Scene,
+    dropping points that are within a tolerance of the simplified polylines. If the Model
+    cannot be found in the Scene, the tolerance is negative or not a number, or there is
+    any trailing input after the parameters, an error message is output and the Model is
+    not changed.
+
+    @param s the Scene containing the Model to simplify.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+    @param params the input string containing the Model name and the tolerance.
+ */
+void simplifyCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
+{
+    // The Model name and the tolerance.
+    Params p;
+
+    // If the parameters are invalid, print error message.
+    if ( !parseParams( cl, params, 1, 1, SCAN_SIMPLIFY, END_CHAR, &p )
+         || !( p.num[ 0 ] >= 0 && p.num[ 0 ] <= DBL_MAX ) ) {
+        reportInvalid( commandNum );
+        return;
+    }
+    if ( !containsModel( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // If there is any trailing input, print error message.
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // Simplify the Model, which may shrink the Scene's box.
+    Model *m = editModel( s, p.name[ 0 ] );
+    if ( !m ) {
+        reportNoMemory( p.name[ 0 ] );
         return;
     }
+    countPoints( s->stats, m->pCount );
+    if ( !simplifyModel( m, p.num[ 0 ] ) ) {
+        reportNoMemory( p.name[ 0 ] );
+    }
+    s->boxValid = false;
+}
 
-    // If the Model name is too long, print error messsage.
-    if ( strlen( modelName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+/**
+    The statsCommand function prints the statistics recorded for each kind of command. If
+    statistics are off, or there is any trailing input after the command, the command is
+    considered invalid and an error message is output.
+
+    @param s the Scene.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+ */
+void statsCommand( Scene *s, int commandNum, CommandLine const *cl )
+{
+    // If there is any trailing input, or nothing to print, output error message.
+    if ( !s->stats || ( cl->count > 0 && ( cl->count > 1 || !cl->cleanEnd ) ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // Determine if the Scene already contains the Model.
-    bool hasModel = applyToScene( s, modelName, &rotate, a, b );
+    printStats( s->stats, s->arena );
+}
+
+/**
+    The intersectCommand function prints the pairs of segments from different Models that
+    meet, among the Models named, or all the Models if none are named. Any number of names
+    can be given. If a name is too long or isn't a Model in the Scene, or there is trailing
+    input after the names, the command is considered invalid and an error message is output.
+
+    @param s the Scene to search.
+    @param commandNum the number of the command.
+    @param cl the tokens of the input line.
+ */
+void intersectCommand( Scene *s, int commandNum, CommandLine const *cl )
+{
+    // The names given, which can be more than one CommandLine holds.
+    int count = 0;
+    int cap = RESIZE;
+    char (*names)[ NAME_LIMIT + 1 ] = malloc( cap * sizeof( *names ) );
+    bool valid = true;
+
+    // Take the names a CommandLine at a time, after the verb. A blank line repeating the
+    // command has no tokens at all, like one with just the verb.
+    CommandLine part = *cl;
+    char const *end = part.count > 0 ? part.start[ 0 ] + part.len[ 0 ] : "";
+    for ( int first = 1; valid; first = 0 ) {
+        for ( int i = first; i < part.count && valid; i++ ) {
+            valid = part.len[ i ] <= NAME_LEN;
+            if ( valid ) {
+                if ( count == cap ) {
+                    cap *= RESIZE;
+                    names = realloc( names, cap * sizeof( *names ) );
+                }
+                memcpy( names[ count ], part.start[ i ], part.len[ i ] );
+                names[ count++ ][ part.len[ i ] ] = '\0';
+            }
+        }
+        if ( part.count > 0 ) {
+            end = part.start[ part.count - 1 ] + part.len[ part.count - 1 ];
+        }
 
-    // If it does not have the Model, print error message.
-    if ( !hasModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
+        // A full CommandLine might have more names after it.
+        if ( part.count < MAX_TOKENS ) {
+            break;
+        }
+        tokenizeLine( end, &part );
     }
 
-    // Close file object.
-    fclose( sparams );
+    // The last name has to end the line, and every Model has to be there.
+    valid = valid && ( *end == '\0' || *end == '\n' );
+    if ( !valid || !intersectScene( s, names, count ) ) {
+        reportInvalid( commandNum );
+    }
+    free( names );
 }
 
 /**
@@ -572,28 +662,18 @@ void rotateCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene to free.
     @param commandNum the number of the command that issued the program to quit.
-    @param params the input string that contains the parameters to quit the program.
+    @param cl the tokens of the input line.
  */
-void quitCommand( Scene *s, int commandNum, char const * params )
+void quitCommand( Scene *s, int commandNum, CommandLine const *cl )
 {
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
-
     // If there is any trailing input, output error message.
-    if ( fscanf( sparams, "%*s%c", &trailingChar ) == 1 && trailingChar != '\n'
-         && trailingChar != EOF && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    if ( cl->count > 0 && ( cl->count > 1 || !cl->cleanEnd ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
     // Free the Scene.
     freeScene( s );
-    // Close file object.
-    fclose( sparams );
     // Exit the program.
     exit( EXIT_SUCCESS );
 }
@@ -606,71 +686,37 @@ void quitCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene to copy a Model from.
     @param commandNum the number of the command that issued a Model to be copied.
+    @param cl the tokens of the input line.
     @param params the input string containing the parameters for the copy command.
  */
-void copyCommand( Scene *s, int commandNum, char const * params )
+void copyCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for destination Model name.
-    char destName[ NAME_LEN + 2 ];
-    // Array for source Model name.
-    char sourceName[ NAME_LEN + 2 ];
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
+    // The destination and source Model names.
+    Params p;
 
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
-
-    // If there are not two matches, print error message.
-    if ( fscanf( sparams, SCAN_COPY, destName, sourceName ) != TWO_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // If the parameters are invalid, the destination model is already contained within the
+    // Scene, or the source Model does not exist in the scene, print error message.
+    if ( !parseParams( cl, params, 2, 0, NULL, END_CHAR, &p ) || containsModel( s, p.name[ 0 ] ) ) {
+        reportInvalid( commandNum );
         return;
     }
-
-    // If there is additional input after the second parameter
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // If the name of the destination or source is too long, print error message.
-    if ( strlen( destName ) > NAME_LEN || strlen( sourceName ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
-    }
-
-    // Determine if the Scene already contains the destination Model.
-    bool hasDestModel = containsModel( s, destName );
-    // Determne if the Scene contains the source Model.
-    bool hasSourceModel = containsModel( s, sourceName );
-
-    // If the destination model is already contained within the Scene, or the source Model does not
-    // exist in the scene, print error message.
-    if ( hasDestModel || !hasSourceModel ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    Model *sourceModel = getModel( s, p.name[ 1 ] );
+    if ( !sourceModel ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // Get the source Model.
-    Model *sourceModel = getModel( s, sourceName );
-    if ( !sourceModel ) {
-        fclose( sparams );
+    // Create a copy.
+    countPoints( s->stats, sourceModel->pCount );
+    Model *duplicate = copyModel( sourceModel, s->arena );
+    if ( !duplicate ) {
+        reportNoMemory( p.name[ 0 ] );
         return;
-    } else {
-        // Create a copy.
-        Model *duplicate = copyModel( sourceModel );
-        // Assign it a name.
-        strcpy( duplicate->name, destName );
-        // Add it to the Scene.
-        addModelPointer( s, duplicate );
     }
-
-    // Close file object.
-    fclose( sparams );
+    // Assign it a name.
+    strcpy( duplicate->name, p.name[ 0 ] );
+    // Add it to the Scene.
+    addModelPointer( s, duplicate );
 }
 
 /**
@@ -681,100 +727,356 @@ void copyCommand( Scene *s, int commandNum, char const * params )
 
     @param s the Scene containing the Models to merge.
     @param commandNum the number of the command that issued Models to be merged.
+    @param cl the tokens of the input line.
     @param params the input string containing the parameters for the merge command.
  */
-void mergeCommand( Scene *s, int commandNum, char const * params )
+void mergeCommand( Scene *s, int commandNum, CommandLine const *cl, char const * params )
 {
-    // Array for destination Model name.
-    char destName[ NAME_LEN + 2 ];
-    // Array for first source Model name.
-    char sourceName1[ NAME_LEN + 2 ];
-    //Array for second source Model name.
-    char sourceName2[ NAME_LEN + 2 ];
-    // Char to determine if there is any input remaining on the input line.
-    char trailingChar;
-
-    // Treat params as a file to ensure that the input cursor is moved properly.
-    FILE *sparams = fmemopen( (void *)params, strlen( params ), "r" );
-
-    // If there are not two matches, print error message.
-    if ( fscanf( sparams, SCAN_MERGE, destName, sourceName1, sourceName2 ) != THREE_REQUIRED ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // The destination and source Model names.
+    Params p;
+
+    // If the parameters are invalid, the destination model is already contained within the
+    // Scene, or the source Models do not exist in the scene, print error message.
+    if ( !parseParams( cl, params, 3, 0, NULL, END_CHAR, &p ) || containsModel( s, p.name[ 0 ] )
+         || !containsModel( s, p.name[ 1 ] ) || !containsModel( s, p.name[ 2 ] ) ) {
+        reportInvalid( commandNum );
         return;
     }
 
-    // If there is additional input after the third parameter
-    if ( fscanf( sparams, "%c", &trailingChar ) == 1 && trailingChar != '\n' && trailingChar != EOF
-         && trailingChar != '\0' ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // Merging empties the sources, so a checkpoint holding one keeps it and the merge gets
+    // a clone sharing its points.
+    Model *sourceModel1 = editModel( s, p.name[ 1 ] );
+    Model *sourceModel2 = editModel( s, p.name[ 2 ] );
+    if ( !sourceModel1 || !sourceModel2 ) {
+        reportNoMemory( p.name[ 0 ] );
         return;
     }
 
-    // If the name of the Models are too long, print error message.
-    if ( strlen( destName ) > NAME_LEN || strlen( sourceName1 ) > NAME_LEN
-         || strlen( sourceName2 ) > NAME_LEN ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
+    // Merge the models, leaving the sources as they were if there's no room.
+    countPoints( s->stats, sourceModel1->pCount + sourceModel2->pCount );
+    Model *m = mergeModels( sourceModel1, sourceModel2, s->arena );
+    if ( !m ) {
+        reportNoMemory( p.name[ 0 ] );
         return;
     }
+    strcpy( m->name, p.name[ 0 ] );
 
-    // Determine if the Scene already contains the destination Model.
-    bool hasDestModel = containsModel( s, destName );
-    // Determne if the scene contains the first source Model.
-    bool hasSourceModel1 = containsModel( s, sourceName1 );
-    // Determine if the Scene contains the second source Model.
-    bool hasSourceModel2 = containsModel( s, sourceName2 );
+    //Add the merged Model to the list.
+    addModelPointer( s, m );
+    // Remove source Models.
+    removeModel( s, p.name[ 1 ] );
+    removeModel( s, p.name[ 2 ] );
+}
 
-    // If the destination model is already contained within the Scene, or the source Models do not
-    // exist in the scene, print error message.
-    if ( hasDestModel || !hasSourceModel1 || !hasSourceModel2 ) {
-        fprintf( stderr, "Command %d invalid\n", commandNum );
-        fclose( sparams );
-        return;
+/**
+    The runCommand function runs one command line against the given Scene. A blank line
+    repeats the last command given, the way it always has.
+
+    @param s the Scene to run the command on.
+    @param commandNum the number of the command.
+    @param commandIndex the index of the last command given, updated to this one.
+    @param params the command line, null terminated.
+ */
+static void runCommand( Scene *s, int commandNum, int *commandIndex, char const *params )
+{
+    // Time the command, tokenizing included.
+    beginCommand( s->stats, s->arena );
+
+    // Split the line into tokens, and look up the command.
+    CommandLine cl;
+    tokenizeLine( params, &cl );
+    if ( cl.count > 0 ) {
+        *commandIndex = lookupVerb( cl.start[ 0 ], cl.len[ 0 ] );
     }
 
-    // Retrieve the source Models.
-    Model *sourceModel1 = getModel( s, sourceName1 );
-    Model *sourceModel2 = getModel( s, sourceName2 );
-    if ( !sourceModel1 || !sourceModel2 ) {
-        fclose( sparams );
-        return;
-    } else {
-        // Merge the models.
-        Model *m = mergeModels( sourceModel1, sourceModel2 );
-        strcpy( m->name, destName );
+    // Determine which function to call.
+    switch ( *commandIndex ) {
+        case LOAD_COMMAND:
+            loadCommand( s, commandNum, &cl, params );
+            break;
+        case SAVE_COMMAND:
+            saveCommand( s, commandNum, &cl, params );
+            break;
+        case DELETE_COMMAND:
+            deleteCommand( s, commandNum, &cl, params );
+            break;
+        case LIST_COMMAND:
+            listCommand( s, commandNum, &cl );
+            break;
+        case TRANSLATE_COMMAND:
+        case SCALE_COMMAND:
+        case ROTATE_COMMAND:
+            transformCommand( s, commandNum, *commandIndex, &cl, params );
+            break;
+        case QUIT_COMMAND:
+            quitCommand( s, commandNum, &cl );
+            break;
+        case COPY_COMMAND:
+            copyCommand( s, commandNum, &cl, params );
+            break;
+        case MERGE_COMMAND:
+            mergeCommand( s, commandNum, &cl, params );
+            break;
+        case QUERY_COMMAND:
+            queryCommand( s, commandNum, &cl, params );
+            break;
+        case NEAREST_COMMAND:
+            nearestCommand( s, commandNum, &cl, params );
+            break;
+        case RENDER_COMMAND:
+            renderCommand( s, commandNum, &cl, params );
+            break;
+        case INTERSECT_COMMAND:
+            intersectCommand( s, commandNum, &cl );
+            break;
+        case SIMPLIFY_COMMAND:
+            simplifyCommand( s, commandNum, &cl, params );
+            break;
+        case STATS_COMMAND:
+            statsCommand( s, commandNum, &cl );
+            break;
+        case GROUP_COMMAND:
+            groupCommand( s, commandNum, &cl, params );
+            break;
+        case BOUNDS_COMMAND:
+            boundsCommand( s, commandNum, &cl );
+            break;
+        case CHECKPOINT_COMMAND:
+            checkpointCommand( s, commandNum, &cl, params );
+            break;
+        case RESTORE_COMMAND:
+            restoreCommand( s, commandNum, &cl, params );
+            break;
+        default:
+            // Print error message.
+            reportInvalid( commandNum );
+            break;
+    }
+
+    endCommand( s->stats, s->arena, *commandIndex );
+}
+
+/**
+    The nextLine function copies the next line of a script into a buffer, keeping only what
+    fgets would have kept and dropping the rest of a long line.
+
+    @param pos the start of the line.
+    @param end the end of the script.
+    @param params the buffer, with room for PARAM_LEN characters and a null terminator.
 
-        //Add the merged Model to the list.
-        addModelPointer( s, m );
-        // Remove source Models.
-        removeModel( s, sourceName1 );
-        removeModel( s, sourceName2 );
+    @return The start of the following line.
+ */
+static char const *nextLine( char const *pos, char const *end, char *params )
+{
+    // Find the end of the line.
+    char const *newline = memchr( pos, '\n', end - pos );
+    size_t len = newline ? (size_t)( newline - pos ) + 1 : (size_t)( end - pos );
+
+    // Keep what fgets would have.
+    size_t keep = len < PARAM_LEN ? len : PARAM_LEN;
+    memcpy( params, pos, keep );
+    params[ keep ] = '\0';
+    return pos + len;
+}
+
+/**
+    The baseName function returns the last component of a path.
+
+    @param path the path.
+
+    @return The part of the path after its last slash.
+ */
+static char const *baseName( char const *path )
+{
+    char const *slash = strrchr( path, '/' );
+    return slash ? slash + 1 : path;
+}
+
+/**
+    The findLoads function scans a script for valid load commands and has the Scene's
+    Prefetcher start reading their files. Once the script saves or renders to a file, later
+    loads of a file with the same name aren't read ahead, since they have to see what was
+    written. Names are compared without their directories, to be safe with different paths
+    to one file.
+
+    @param s the Scene.
+    @param pos the start of the script.
+    @param end the end of the script.
+ */
+static void findLoads( Scene *s, char const *pos, char const *end )
+{
+    // Each line, and its tokens.
+    char params[ PARAM_LEN + 1 ];
+    CommandLine cl;
+    Params p;
+
+    // The files saved so far.
+    int sCount = 0;
+    int sCap = RESIZE;
+    char (*saved)[ NAME_LEN + 2 ] = malloc( sCap * sizeof( *saved ) );
+
+    s->prefetch = makePrefetcher( s->arena );
+    for ( int commandNum = 1; pos < end; commandNum++ ) {
+        pos = nextLine( pos, end, params );
+        tokenizeLine( params, &cl );
+        if ( cl.count == 0 ) {
+            continue;
+        }
+
+        int commandIndex = lookupVerb( cl.start[ 0 ], cl.len[ 0 ] );
+        bool writes = commandIndex == SAVE_COMMAND
+                      && parseParams( &cl, params, 1, 0, NULL, END_CHAR, &p );
+
+        // A render might write the file it names, whether or not its size is valid.
+        if ( commandIndex == RENDER_COMMAND && cl.count > 1 && cl.len[ 1 ] <= NAME_LEN ) {
+            memcpy( p.name[ 0 ], cl.start[ 1 ], cl.len[ 1 ] );
+            p.name[ 0 ][ cl.len[ 1 ] ] = '\0';
+            writes = true;
+        }
+
+        if ( writes ) {
+            // Remember the file.
+            if ( sCount == sCap ) {
+                sCap *= RESIZE;
+                saved = realloc( saved, sCap * sizeof( *saved ) );
+            }
+            strcpy( saved[ sCount++ ], baseName( p.name[ 0 ] ) );
+        } else if ( commandIndex == LOAD_COMMAND
+                    && parseParams( &cl, params, 2, 0, NULL, END_CHAR, &p ) ) {
+            // Read the file ahead, if the script hasn't written it.
+            bool written = false;
+            for ( int i = 0; i < sCount && !written; i++ ) {
+                written = strcmp( saved[ i ], baseName( p.name[ 1 ] ) ) == 0;
+            }
+            if ( !written ) {
+                addPrefetch( s->prefetch, commandNum, p.name[ 1 ] );
+            }
+        }
     }
+    free( saved );
 
-    // Close file object.
-    fclose( sparams );
+    startPrefetch( s->prefetch );
+}
+
+/**
+    The runScript function runs every command in a script file, back to back and without
+    prompts. The file is memory mapped rather than read a line at a time, and error messages
+    are held in a large buffer instead of being written one by one. Lines are numbered and
+    cut to PARAM_LEN characters exactly as they are when read from standard input, so the
+    error messages match an interactive run. The one difference is that a last line with no
+    newline is still run. The files of the load commands are read ahead on the thread pool.
+
+    @param s the Scene to run the commands on.
+    @param fname the name of the script file.
+
+    @return Program exit status.
+ */
+static int runScript( Scene *s, char const *fname )
+{
+    // Map the script.
+    int fd = open( fname, O_RDONLY );
+    struct stat st;
+    if ( fd < 0 || fstat( fd, &st ) != 0 ) {
+        fprintf( stderr, "Can't open file: %s\n", fname );
+        if ( fd >= 0 ) {
+            close( fd );
+        }
+        freeScene( s );
+        return EXIT_FAILURE;
+    }
+    size_t size = st.st_size;
+    char const *script = NULL;
+    if ( size > 0 ) {
+        script = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( script == MAP_FAILED ) {
+            fprintf( stderr, "Can't open file: %s\n", fname );
+            close( fd );
+            freeScene( s );
+            return EXIT_FAILURE;
+        }
+        madvise( (void *)script, size, MADV_SEQUENTIAL );
+    }
+    close( fd );
+
+    // Errors are written out when the buffer fills, or at exit.
+    setvbuf( stderr, NULL, _IOFBF, SCRIPT_BUFFER );
+
+    // Command number counter.
+    int commandNum = 1;
+    // The index of the last command given.
+    int commandIndex = INVALID_COMMAND;
+    // Each line is copied here so it is null terminated.
+    char params[ PARAM_LEN + 1 ];
+
+    // Start reading the files of the load commands.
+    if ( poolThreads() > 1 ) {
+        findLoads( s, script, script + size );
+    }
+
+    char const *pos = script;
+    char const *end = script + size;
+    while ( pos < end ) {
+        pos = nextLine( pos, end, params );
+        runCommand( s, commandNum++, &commandIndex, params );
+    }
+
+    if ( script ) {
+        munmap( (void *)script, size );
+    }
+    freeScene( s );
+    return EXIT_SUCCESS;
 }
 
 /**
     The main function handles getting input from the user, passing the responsibility
     of error checking to the other functions. If the command input is invalid, an error
     message is output and the user is reprompted for a new command. If EOF is encountered
-    or the user decides to quit the program, a successful exit status is returned.
+    or the user decides to quit the program, a successful exit status is returned. Given
+    SCRIPT_OPTION and a file name, it runs the commands in the file instead. Given
+    SERVE_OPTION and a socket path, it serves the Scene to clients, and given CONNECT_OPTION
+    and a socket path, it is a client of such a server.
+
+    @param argc the number of command-line arguments.
+    @param argv the command-line arguments.
 
     @return Program exit status.
  */
-int main()
+int main( int argc, char *argv[] )
 {
+    // Check the command-line arguments.
+    if ( argc != 1 && ( argc != 3 || ( strcmp( argv[ 1 ], SCRIPT_OPTION ) != 0
+                                       && strcmp( argv[ 1 ], SERVE_OPTION ) != 0
+                                       && strcmp( argv[ 1 ], CONNECT_OPTION ) != 0 ) ) ) {
+        fprintf( stderr, "usage: drawing [%s <file> | %s <socket> | %s <socket>]\n",
+                 SCRIPT_OPTION, SERVE_OPTION, CONNECT_OPTION );
+        return EXIT_FAILURE;
+    }
+
+    // A client has no Scene of its own.
+    if ( argc == 3 && strcmp( argv[ 1 ], CONNECT_OPTION ) == 0 ) {
+        return runClient( argv[ 2 ] );
+    }
+
     // Create an empty Scene.
     Scene *s = makeScene();
 
+    // Serve it, if asked to.
+    if ( argc == 3 && strcmp( argv[ 1 ], SERVE_OPTION ) == 0 ) {
+        int status = serveScene( s, argv[ 2 ], runCommand );
+        freeScene( s );
+        return status;
+    }
+
+    // Run a script, if there is one.
+    if ( argc == 3 ) {
+        return runScript( s, argv[ 2 ] );
+    }
+
     // Command number counter.
     int commandNum = 1;
 
-    // Array to store a command.
-    char command[ MAX_COMMAND_LEN + 2 ];
+    // The index of the last command given. A blank line repeats it.
+    int commandIndex = INVALID_COMMAND;
 
     // Array to store parameter lines.
     char params[ PARAM_LEN + 1 ];
@@ -792,51 +1094,9 @@ int main()
             flushInput( s );
         }
 
-        // Parse command value.
-        sscanf( params, SCAN_COMMAND, command );
-        // The index of the command.
-        int commandIndex = getValidCommand( command );
-
-        // If the command is valid, determine which function to call.
-        if ( commandIndex != INVALID_COMMAND ) {
-            switch ( commandIndex ) {
-                case LOAD_COMMAND:
-                    loadCommand( s, commandNum, params );
-                    break;
-                case SAVE_COMMAND:
-                    saveCommand( s, commandNum, params );
-                    break;
-                case DELETE_COMMAND:
-                    deleteCommand( s, commandNum, params );
-                    break;
-                case LIST_COMMAND:
-                    listCommand( s, commandNum, params );
-                    break;
-                case TRANSLATE_COMMAND:
-                    translateCommand( s, commandNum, params );
-                    break;
-                case SCALE_COMMAND:
-                    scaleCommand( s, commandNum, params );
-                    break;
-                case ROTATE_COMMAND:
-                    rotateCommand( s, commandNum, params );
-                    break;
-                case QUIT_COMMAND:
-                    quitCommand( s, commandNum, params );
-                    break;
-                 case COPY_COMMAND:
-                    copyCommand( s, commandNum, params );
-                    break;
-                case MERGE_COMMAND:
-                    mergeCommand( s, commandNum, params );
-                    break;
-                default:
-                    break;
-            }
-        } else {
-            // Print error message.
-            fprintf( stderr, "Command %d invalid\n", commandNum );
-        }
+        // Run the command.
+        runCommand( s, commandNum, &commandIndex, params );
+
         // Reprompt.
         printf( "cmd %d> ", ++commandNum );
     }
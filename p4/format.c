@@ -0,0 +1,212 @@
+/**
+    @file format.c
+    @author Brian Morris (bcmorri3)
+
+    The format.c program contains the formatter defined in format.h. A double is split
+    into its integer significand and binary exponent so the value times 1000 can be
+    rounded exactly with integer arithmetic, the same way printf rounds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "format.h"
+
+/** The value is scaled by this much to keep three digits after the decimal point. */
+#define SCALE 1000
+
+/** Number of digits after the decimal point. */
+#define DECIMALS 3
+
+/** Number of explicit significand bits in a double. */
+#define MANTISSA_BITS 52
+
+/** Mask for the significand bits in a double. */
+#define MANTISSA_MASK ( ( (uint64_t)1 << MANTISSA_BITS ) - 1 )
+
+/** Mask for the exponent bits in a double, once shifted down. */
+#define EXPONENT_MASK 0x7FF
+
+/** Offset to turn the stored exponent into the power of two of the significand. */
+#define EXPONENT_BIAS 1075
+
+/** Values at least this big are passed to snprintf, since value * 1000 might not fit. */
+#define FAST_LIMIT 9007199254740992.0
+
+/** Scaled values below this are whole numbers a double holds exactly. */
+#define EXACT_LIMIT ( (uint64_t)1 << ( MANTISSA_BITS + 1 ) )
+
+/** Most characters formatModel adds for one point: two coordinates and three newlines. */
+#define POINT_LEN ( 2 * ( COORD_LEN + 1 ) + 3 )
+
+/** Buffer size to start with, in characters. */
+#define INITIAL_TEXT 4096
+
+/**
+    The scaleMagnitude function returns the magnitude of a value times 1000, rounded half to
+    even the way printf rounds. The value has to be less than FAST_LIMIT in magnitude.
+
+    @param v the value to scale.
+
+    @return The rounded magnitude of v * 1000.
+ */
+static uint64_t scaleMagnitude( double v )
+{
+    // Pull the significand and exponent out of the double.
+    uint64_t bits;
+    memcpy( &bits, &v, sizeof( bits ) );
+    int biased = (int)( ( bits >> MANTISSA_BITS ) & EXPONENT_MASK );
+    uint64_t mant = bits & MANTISSA_MASK;
+    int exp;
+    if ( biased == 0 ) {
+        // Subnormal, no implicit leading bit.
+        exp = 1 - EXPONENT_BIAS;
+    } else {
+        mant |= (uint64_t)1 << MANTISSA_BITS;
+        exp = biased - EXPONENT_BIAS;
+    }
+
+    // The value times 1000, rounded half to even. mant * 1000 is always less than 2^63.
+    uint64_t scaled = mant * SCALE;
+    uint64_t q;
+    if ( exp >= 0 ) {
+        // An integer less than 2^53, so this can't overflow.
+        q = scaled << exp;
+    } else if ( exp >= -63 ) {
+        int shift = -exp;
+        q = scaled >> shift;
+        uint64_t rem = scaled & ( ( (uint64_t)1 << shift ) - 1 );
+        uint64_t half = (uint64_t)1 << ( shift - 1 );
+        if ( rem > half || ( rem == half && ( q & 1 ) ) ) {
+            q++;
+        }
+    } else {
+        // Less than half of 0.001 in magnitude.
+        q = 0;
+    }
+    return q;
+}
+
+bool scaleCoord( double v, int64_t *q )
+{
+    // Infinities, NaN and values too big for the fast path can't be scaled.
+    if ( !( fabs( v ) < FAST_LIMIT ) ) {
+        return false;
+    }
+
+    // Past EXACT_LIMIT, q / 1000.0 might not read back as the same value.
+    uint64_t mag = scaleMagnitude( v );
+    if ( mag >= EXACT_LIMIT ) {
+        return false;
+    }
+    *q = signbit( v ) ? -(int64_t)mag : (int64_t)mag;
+    return true;
+}
+
+int formatCoord( double v, char *buf )
+{
+    // Let printf handle infinities, NaN and anything too big for the fast path.
+    if ( !( fabs( v ) < FAST_LIMIT ) ) {
+        return snprintf( buf, COORD_LEN + 1, "%.3lf", v );
+    }
+    uint64_t q = scaleMagnitude( v );
+
+    // Write the digits backward into a scratch buffer, fraction first.
+    char digits[ COORD_LEN ];
+    int pos = COORD_LEN;
+    uint64_t whole = q / SCALE;
+    uint64_t frac = q % SCALE;
+    for ( int i = 0; i < DECIMALS; i++ ) {
+        digits[ --pos ] = '0' + frac % 10;
+        frac /= 10;
+    }
+    digits[ --pos ] = '.';
+    do {
+        digits[ --pos ] = '0' + whole % 10;
+        whole /= 10;
+    } while ( whole );
+
+    // printf keeps the sign of negative values, even ones that round to zero.
+    if ( signbit( v ) ) {
+        digits[ --pos ] = '-';
+    }
+
+    int len = COORD_LEN - pos;
+    memcpy( buf, digits + pos, len );
+    return len;
+}
+
+void initText( TextBuffer *b )
+{
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+void freeText( TextBuffer *b )
+{
+    free( b->data );
+    initText( b );
+}
+
+/**
+    The reserveText function makes sure the buffer has room for at least the given number
+    of additional characters.
+
+    @param b the TextBuffer to grow.
+    @param extra the number of characters that will be added.
+
+    @return True, or false if there was no room to grow it, leaving it as it was.
+ */
+static bool reserveText( TextBuffer *b, size_t extra )
+{
+    if ( b->len + extra > b->cap ) {
+        size_t cap = b->cap ? b->cap : INITIAL_TEXT;
+        while ( b->len + extra > cap ) {
+            cap *= 2;
+        }
+        char *data = (char *)realloc( b->data, cap );
+        if ( !data ) {
+            return false;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    return true;
+}
+
+bool formatModel( Model const *m, TextBuffer *b )
+{
+    for ( Chunk const *c = m->head; c; c = c->next ) {
+        if ( !formatPoints( c, 0, c->count, b ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool formatPoints( Chunk const *c, int start, int end, TextBuffer *b )
+{
+    for ( int j = start; j < end; j++ ) {
+        if ( !reserveText( b, POINT_LEN ) ) {
+            return false;
+        }
+        char *out = b->data + b->len;
+
+        // Find where the point is stored, if its Chunk is indexed.
+        int v = c->idx ? c->idx[ j ] : j;
+        out += formatCoord( c->xList[ v ], out );
+        *out++ = ' ';
+        out += formatCoord( c->yList[ v ], out );
+        *out++ = '\n';
+
+        // Blank line after the second point of each segment. Chunks hold whole segments.
+        if ( j % 2 == 1 ) {
+            *out++ = '\n';
+        }
+        b->len = out - b->data;
+    }
+    return true;
+}
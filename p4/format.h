@@ -0,0 +1,97 @@
+/**
+    @file format.h
+    @author Brian Morris (bcmorri3)
+
+    The format.h header file declares a fast formatter for coordinates and Models. It
+    produces exactly the same text as printf's "%.3lf" conversion, but without the cost of
+    parsing a format string and going through the general floating point code for every
+    value.
+ */
+
+#ifndef _FORMAT_H_
+#define _FORMAT_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "model.h"
+
+/** Longest string formatCoord can produce, not counting a null terminator. */
+#define COORD_LEN 320
+
+/** A growable buffer of text. */
+typedef struct {
+    /** The text, not null terminated. */
+    char *data;
+
+    /** Number of characters in the buffer. */
+    size_t len;
+
+    /** Number of characters the buffer has room for. */
+    size_t cap;
+} TextBuffer;
+
+/**
+    This function writes the given value into buf with three digits after the decimal
+    point, exactly as printf( "%.3lf" ) would. That includes round-half-even on values
+    that are exactly halfway between two outputs and the sign of negative zero.
+
+    @param v the value to format.
+    @param buf storage for at least COORD_LEN + 1 characters.
+
+    @return The number of characters written, not counting any null terminator.
+ */
+int formatCoord( double v, char *buf );
+
+/**
+    This function puts a value on the grid of thousandths that formatCoord prints it on,
+    giving the value times 1000 rounded exactly as formatCoord rounds it. Dividing the
+    result by 1000.0 gives the same double as reading the printed text back. The sign of
+    a value that rounds to zero is lost.
+
+    @param v the value to scale.
+    @param q set to the rounded value times 1000.
+
+    @return True, or false if v is too big, infinite or NaN for the result to be exact.
+ */
+bool scaleCoord( double v, int64_t *q );
+
+/**
+    This function initializes an empty TextBuffer.
+
+    @param b the TextBuffer to initialize.
+ */
+void initText( TextBuffer *b );
+
+/**
+    This function frees the storage used by a TextBuffer, leaving it empty.
+
+    @param b the TextBuffer to free.
+ */
+void freeText( TextBuffer *b );
+
+/**
+    This function appends the line segments of the given Model to the buffer, in the
+    format used by saveScene: one point per line, and a blank line after each segment.
+
+    @param m the Model to format.
+    @param b the TextBuffer to append to.
+
+    @return True, or false if the buffer couldn't grow, leaving only some of the text in it.
+ */
+bool formatModel( Model const *m, TextBuffer *b );
+
+/**
+    This function appends some of the points of a Chunk to the buffer, the way formatModel()
+    does, so a large Model can be formatted a piece at a time.
+
+    @param c the Chunk.
+    @param start the index of the first point, which must start a segment.
+    @param end the index after the last point, which must end a segment.
+    @param b the TextBuffer to append to.
+
+    @return True, or false if the buffer couldn't grow, leaving only some of the text in it.
+ */
+bool formatPoints( Chunk const *c, int start, int end, TextBuffer *b );
+
+#endif
@@ -0,0 +1,519 @@
+/**
+    @file intersect.c
+    @author Brian Morris (bcmorri3)
+
+    The intersect.c program contains the search for intersecting segments defined in
+    intersect.h. The orientation test is filtered with a bound on its rounding error, as
+    in Shewchuk's adaptive predicates, and falls back to exact arithmetic on expansions
+    only when the filter can't tell the sign.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "intersect.h"
+#include "pool.h"
+
+/** Half the gap between 1 and the next double, the unit roundoff. */
+#define DBL_HALF_EPS ( 1.0 / 9007199254740992.0 )
+
+/** Bound on the relative rounding error of the orientation determinant in doubles. */
+#define ORIENT_BOUND ( ( 3.0 + 16.0 * DBL_HALF_EPS ) * DBL_HALF_EPS )
+
+/** Doubles in the exact expansion of the orientation determinant. */
+#define ORIENT_TERMS 16
+
+/** Pairs of nodes to split the search into for each thread of the pool. */
+#define TASKS_PER_THREAD 16
+
+/** Initial capacity of the lists of node pairs and of crossings. */
+#define INITIAL_CAP 16
+
+/** A pair of nodes, one from each of two Models' indexes, still to be searched. */
+typedef struct {
+    /** Index of the first Model in the list searched. */
+    int first;
+
+    /** Index of the second Model in the list searched. */
+    int second;
+
+    /** Node of the first Model's index. */
+    int nodeA;
+
+    /** Node of the second Model's index. */
+    int nodeB;
+} NodePair;
+
+/** A Model's place in the sweep across the Models' boxes. */
+typedef struct {
+    /** Left edge of the Model's box. */
+    double loX;
+
+    /** Index of the Model in the list searched. */
+    int model;
+} ModelEdge;
+
+/** A growable list of node pairs. */
+typedef struct {
+    /** The pairs. */
+    NodePair *list;
+
+    /** Number of pairs in the list. */
+    int count;
+
+    /** Capacity of the list. */
+    int cap;
+} PairList;
+
+/** A growable list of crossings found by one task. */
+typedef struct {
+    /** The crossings. */
+    Crossing *list;
+
+    /** Number of crossings in the list. */
+    int count;
+
+    /** Capacity of the list. */
+    int cap;
+} CrossingList;
+
+/** The state shared by the tasks of a search. */
+typedef struct {
+    /** The indexes of the Models. */
+    SpatialIndex * const *indexes;
+
+    /** The node pairs each task starts from. */
+    NodePair *tasks;
+
+    /** The crossings found by each task. */
+    CrossingList *found;
+} Search;
+
+/**
+    The twoSum function adds two doubles exactly, as the rounded sum and its error.
+
+    @param a the first value.
+    @param b the second value.
+    @param err set to the rounding error, so a + b is exactly the sum plus err.
+
+    @return The rounded sum.
+ */
+static double twoSum( double a, double b, double *err )
+{
+    double s = a + b;
+    double bv = s - a;
+    *err = ( a - ( s - bv ) ) + ( b - bv );
+    return s;
+}
+
+/**
+    The twoProduct function multiplies two doubles exactly, as the rounded product and its
+    error.
+
+    @param a the first value.
+    @param b the second value.
+    @param err set to the rounding error, so a * b is exactly the product plus err.
+
+    @return The rounded product.
+ */
+static double twoProduct( double a, double b, double *err )
+{
+    double p = a * b;
+    *err = fma( a, b, -p );
+    return p;
+}
+
+/**
+    The exactOrient function finds the sign of the orientation determinant exactly. Each
+    difference is split into a rounded value and its error, the determinant is expanded
+    into the sixteen exact products of those parts, and the products are summed into an
+    expansion whose largest nonzero part has the sign of the whole.
+
+    @param ax the x-coordinate of the first point.
+    @param ay the y-coordinate of the first point.
+    @param bx the x-coordinate of the second point.
+    @param by the y-coordinate of the second point.
+    @param cx the x-coordinate of the third point.
+    @param cy the y-coordinate of the third point.
+
+    @return 1 if the points turn counterclockwise, -1 if clockwise, 0 if collinear.
+ */
+static int exactOrient( double ax, double ay, double bx, double by, double cx, double cy )
+{
+    // The differences, each as a value and an error.
+    double acx[ 2 ], acy[ 2 ], bcx[ 2 ], bcy[ 2 ];
+    acx[ 0 ] = twoSum( ax, -cx, acx + 1 );
+    acy[ 0 ] = twoSum( ay, -cy, acy + 1 );
+    bcx[ 0 ] = twoSum( bx, -cx, bcx + 1 );
+    bcy[ 0 ] = twoSum( by, -cy, bcy + 1 );
+
+    // The products of acx and bcy, less the products of acy and bcx.
+    double terms[ ORIENT_TERMS ];
+    int n = 0;
+    for ( int i = 0; i < 2; i++ ) {
+        for ( int j = 0; j < 2; j++ ) {
+            terms[ n ] = twoProduct( acx[ i ], bcy[ j ], terms + n + 1 );
+            n += 2;
+            terms[ n ] = twoProduct( -acy[ i ], bcx[ j ], terms + n + 1 );
+            n += 2;
+        }
+    }
+
+    // Add them into an expansion, smallest parts first.
+    double e[ ORIENT_TERMS ];
+    int len = 0;
+    for ( int i = 0; i < ORIENT_TERMS; i++ ) {
+        double q = terms[ i ];
+        for ( int j = 0; j < len; j++ ) {
+            q = twoSum( q, e[ j ], e + j );
+        }
+        e[ len++ ] = q;
+    }
+
+    for ( int i = len - 1; i >= 0; i-- ) {
+        if ( e[ i ] != 0 ) {
+            return e[ i ] > 0 ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+/**
+    The orient function reports which way three points turn.
+
+    @param ax the x-coordinate of the first point.
+    @param ay the y-coordinate of the first point.
+    @param bx the x-coordinate of the second point.
+    @param by the y-coordinate of the second point.
+    @param cx the x-coordinate of the third point.
+    @param cy the y-coordinate of the third point.
+
+    @return 1 if the points turn counterclockwise, -1 if clockwise, 0 if collinear.
+ */
+static int orient( double ax, double ay, double bx, double by, double cx, double cy )
+{
+    double left = ( ax - cx ) * ( by - cy );
+    double right = ( ay - cy ) * ( bx - cx );
+    double det = left - right;
+
+    // Most of the time the rounded determinant is far enough from zero to trust.
+    if ( fabs( det ) > ORIENT_BOUND * ( fabs( left ) + fabs( right ) ) ) {
+        return det > 0 ? 1 : -1;
+    }
+    return exactOrient( ax, ay, bx, by, cx, cy );
+}
+
+/**
+    The within function reports whether a point is inside the box of a segment, boundary
+    included. For a point on the segment's line, that means it is on the segment.
+
+    @param ax the x-coordinate of the start of the segment.
+    @param ay the y-coordinate of the start of the segment.
+    @param bx the x-coordinate of the end of the segment.
+    @param by the y-coordinate of the end of the segment.
+    @param px the x-coordinate of the point.
+    @param py the y-coordinate of the point.
+
+    @return True if the point is in the box.
+ */
+static bool within( double ax, double ay, double bx, double by, double px, double py )
+{
+    return fmin( ax, bx ) <= px && px <= fmax( ax, bx ) && fmin( ay, by ) <= py
+           && py <= fmax( ay, by );
+}
+
+/**
+    The contact function decides how two segments meet.
+
+    @param a the ends of the first segment, as x and y of the start, then of the end.
+    @param b the ends of the second segment, the same way.
+
+    @return One of the CONTACT values.
+ */
+static int contact( double const a[ 4 ], double const b[ 4 ] )
+{
+    for ( int i = 0; i < 4; i++ ) {
+        if ( !isfinite( a[ i ] ) || !isfinite( b[ i ] ) ) {
+            return CONTACT_NONE;
+        }
+    }
+
+    // Which side of each segment the ends of the other are on.
+    int o1 = orient( a[ 0 ], a[ 1 ], a[ 2 ], a[ 3 ], b[ 0 ], b[ 1 ] );
+    int o2 = orient( a[ 0 ], a[ 1 ], a[ 2 ], a[ 3 ], b[ 2 ], b[ 3 ] );
+    int o3 = orient( b[ 0 ], b[ 1 ], b[ 2 ], b[ 3 ], a[ 0 ], a[ 1 ] );
+    int o4 = orient( b[ 0 ], b[ 1 ], b[ 2 ], b[ 3 ], a[ 2 ], a[ 3 ] );
+
+    // Ends strictly on both sides of each other is a proper crossing.
+    if ( o1 * o2 < 0 && o3 * o4 < 0 ) {
+        return CONTACT_CROSS;
+    }
+
+    // Otherwise they only meet if an end of one lies on the other.
+    if ( !( ( o1 == 0 && within( a[ 0 ], a[ 1 ], a[ 2 ], a[ 3 ], b[ 0 ], b[ 1 ] ) )
+            || ( o2 == 0 && within( a[ 0 ], a[ 1 ], a[ 2 ], a[ 3 ], b[ 2 ], b[ 3 ] ) )
+            || ( o3 == 0 && within( b[ 0 ], b[ 1 ], b[ 2 ], b[ 3 ], a[ 0 ], a[ 1 ] ) )
+            || ( o4 == 0 && within( b[ 0 ], b[ 1 ], b[ 2 ], b[ 3 ], a[ 2 ], a[ 3 ] ) ) ) ) {
+        return CONTACT_NONE;
+    }
+
+    // Collinear segments of some length that share more than a point overlap. Compare
+    // them along an axis the first one isn't perpendicular to.
+    bool pointA = a[ 0 ] == a[ 2 ] && a[ 1 ] == a[ 3 ];
+    bool pointB = b[ 0 ] == b[ 2 ] && b[ 1 ] == b[ 3 ];
+    if ( o1 == 0 && o2 == 0 && !pointA && !pointB ) {
+        int axis = a[ 0 ] != a[ 2 ] ? 0 : 1;
+        double lo = fmax( fmin( a[ axis ], a[ axis + 2 ] ), fmin( b[ axis ], b[ axis + 2 ] ) );
+        double hi = fmin( fmax( a[ axis ], a[ axis + 2 ] ), fmax( b[ axis ], b[ axis + 2 ] ) );
+        if ( lo < hi ) {
+            return CONTACT_OVERLAP;
+        }
+    }
+    return CONTACT_TOUCH;
+}
+
+/**
+    The boxesMeet function reports whether the boxes of two nodes overlap or touch.
+
+    @param a the first index.
+    @param i the node of the first index.
+    @param b the second index.
+    @param j the node of the second index.
+
+    @return True if the boxes meet.
+ */
+static bool boxesMeet( SpatialIndex const *a, int i, SpatialIndex const *b, int j )
+{
+    return a->loX[ i ] <= b->hiX[ j ] && b->loX[ j ] <= a->hiX[ i ] && a->loY[ i ] <= b->hiY[ j ]
+           && b->loY[ j ] <= a->hiY[ i ];
+}
+
+/**
+    The extent function returns a measure of the size of a node's box.
+
+    @param ix the index.
+    @param node the node.
+
+    @return The width plus the height of the box.
+ */
+static double extent( SpatialIndex const *ix, int node )
+{
+    return ( ix->hiX[ node ] - ix->loX[ node ] ) + ( ix->hiY[ node ] - ix->loY[ node ] );
+}
+
+/**
+    The addPair function adds a node pair to a list, growing it if it has to.
+
+    @param pl the list.
+    @param p the pair to add.
+ */
+static void addPair( PairList *pl, NodePair p )
+{
+    if ( pl->count == pl->cap ) {
+        pl->cap *= 2;
+        pl->list = (NodePair *)realloc( pl->list, pl->cap * sizeof( NodePair ) );
+    }
+    pl->list[ pl->count++ ] = p;
+}
+
+/**
+    The splitPair function replaces a pair of nodes with the pairs of their children that
+    still have to be searched. The node with children and the bigger box is split. Pairs of
+    leaves can't be split.
+
+    @param indexes the indexes of the Models.
+    @param p the pair to split.
+    @param out the list to add the children to.
+
+    @return False if the pair was two leaves, and nothing was added.
+ */
+static bool splitPair( SpatialIndex * const *indexes, NodePair p, PairList *out )
+{
+    SpatialIndex const *a = indexes[ p.first ];
+    SpatialIndex const *b = indexes[ p.second ];
+    bool leafA = a->leafLen[ p.nodeA ] > 0;
+    bool leafB = b->leafLen[ p.nodeB ] > 0;
+    if ( leafA && leafB ) {
+        return false;
+    }
+
+    for ( int k = 0; k < 2; k++ ) {
+        NodePair child = p;
+        if ( !leafA && ( leafB || extent( a, p.nodeA ) >= extent( b, p.nodeB ) ) ) {
+            child.nodeA = a->first[ p.nodeA ] + k;
+        } else {
+            child.nodeB = b->first[ p.nodeB ] + k;
+        }
+        if ( boxesMeet( a, child.nodeA, b, child.nodeB ) ) {
+            addPair( out, child );
+        }
+    }
+    return true;
+}
+
+/**
+    The testLeaves function tests every segment of one leaf against every segment of
+    another, and records the pairs that meet.
+
+    @param indexes the indexes of the Models.
+    @param p the pair of leaves.
+    @param found the list to add crossings to.
+ */
+static void testLeaves( SpatialIndex * const *indexes, NodePair p, CrossingList *found )
+{
+    SpatialIndex const *a = indexes[ p.first ];
+    SpatialIndex const *b = indexes[ p.second ];
+    int endA = a->first[ p.nodeA ] + a->leafLen[ p.nodeA ];
+    int endB = b->first[ p.nodeB ] + b->leafLen[ p.nodeB ];
+
+    for ( int s = a->first[ p.nodeA ]; s < endA; s++ ) {
+        double sa[ 4 ] = { a->px[ 2 * s ], a->py[ 2 * s ], a->px[ 2 * s + 1 ], a->py[ 2 * s + 1 ] };
+        for ( int t = b->first[ p.nodeB ]; t < endB; t++ ) {
+            double sb[ 4 ] = { b->px[ 2 * t ], b->py[ 2 * t ], b->px[ 2 * t + 1 ],
+                               b->py[ 2 * t + 1 ] };
+            int kind = contact( sa, sb );
+            if ( kind == CONTACT_NONE ) {
+                continue;
+            }
+            if ( found->count == found->cap ) {
+                found->cap = found->cap ? found->cap * 2 : INITIAL_CAP;
+                found->list = (Crossing *)realloc( found->list, found->cap * sizeof( Crossing ) );
+            }
+            Crossing c = { p.first, p.second, a->id[ s ], b->id[ t ], kind };
+            found->list[ found->count++ ] = c;
+        }
+    }
+}
+
+/**
+    The searchTask function is run by parallelFor to search under one pair of nodes.
+
+    @param ctx the Search.
+    @param i the index of the task.
+ */
+static void searchTask( void *ctx, int i )
+{
+    Search *search = (Search *)ctx;
+    PairList stack = { (NodePair *)malloc( INITIAL_CAP * sizeof( NodePair ) ), 0, INITIAL_CAP };
+    addPair( &stack, search->tasks[ i ] );
+
+    while ( stack.count > 0 ) {
+        NodePair p = stack.list[ --stack.count ];
+        if ( !splitPair( search->indexes, p, &stack ) ) {
+            testLeaves( search->indexes, p, search->found + i );
+        }
+    }
+    free( stack.list );
+}
+
+/**
+    The compareEdges function orders Models by the left edges of their boxes, for qsort.
+
+    @param a the first ModelEdge.
+    @param b the second ModelEdge.
+
+    @return Negative, zero or positive as a comes before, with or after b.
+ */
+static int compareEdges( void const *a, void const *b )
+{
+    ModelEdge const *x = (ModelEdge const *)a;
+    ModelEdge const *y = (ModelEdge const *)b;
+    if ( x->loX != y->loX ) {
+        return x->loX < y->loX ? -1 : 1;
+    }
+    return x->model - y->model;
+}
+
+/**
+    The compareCrossings function orders crossings by Model, then by segment, for qsort.
+
+    @param a the first Crossing.
+    @param b the second Crossing.
+
+    @return Negative, zero or positive as a comes before, with or after b.
+ */
+static int compareCrossings( void const *a, void const *b )
+{
+    Crossing const *x = (Crossing const *)a;
+    Crossing const *y = (Crossing const *)b;
+    if ( x->first != y->first ) {
+        return x->first - y->first;
+    }
+    if ( x->second != y->second ) {
+        return x->second - y->second;
+    }
+    if ( x->id1 != y->id1 ) {
+        return x->id1 - y->id1;
+    }
+    return x->id2 - y->id2;
+}
+
+int findCrossings( SpatialIndex * const *list, int count, Crossing **crossings )
+{
+    // Sort the Models by the left edges of their boxes. A box that doesn't meet itself, as
+    // one with a coordinate that isn't a number, can't meet any other.
+    ModelEdge *edges = (ModelEdge *)malloc( ( count ? count : 1 ) * sizeof( ModelEdge ) );
+    int edgeCount = 0;
+    for ( int i = 0; i < count; i++ ) {
+        if ( boxesMeet( list[ i ], 0, list[ i ], 0 ) ) {
+            ModelEdge e = { list[ i ]->loX[ 0 ], i };
+            edges[ edgeCount++ ] = e;
+        }
+    }
+    qsort( edges, edgeCount, sizeof( ModelEdge ), compareEdges );
+
+    // Then sweep across them, starting with the roots of every pair of Models whose boxes
+    // meet. Each box is only checked against the ones that start before it ends.
+    PairList tasks = { (NodePair *)malloc( INITIAL_CAP * sizeof( NodePair ) ), 0, INITIAL_CAP };
+    for ( int a = 0; a < edgeCount; a++ ) {
+        int i = edges[ a ].model;
+        for ( int b = a + 1; b < edgeCount && edges[ b ].loX <= list[ i ]->hiX[ 0 ]; b++ ) {
+            int j = edges[ b ].model;
+            if ( boxesMeet( list[ i ], 0, list[ j ], 0 ) ) {
+                NodePair p = { i < j ? i : j, i < j ? j : i, 0, 0 };
+                addPair( &tasks, p );
+            }
+        }
+    }
+    free( edges );
+
+    // Split the pairs a level at a time until there's enough work to go around.
+    int target = poolThreads() > 1 ? poolThreads() * TASKS_PER_THREAD : 0;
+    bool split = true;
+    while ( split && tasks.count > 0 && tasks.count < target ) {
+        PairList next = { (NodePair *)malloc( tasks.cap * 2 * sizeof( NodePair ) ), 0, tasks.cap * 2 };
+        split = false;
+        for ( int i = 0; i < tasks.count; i++ ) {
+            if ( splitPair( list, tasks.list[ i ], &next ) ) {
+                split = true;
+            } else {
+                addPair( &next, tasks.list[ i ] );
+            }
+        }
+        free( tasks.list );
+        tasks = next;
+    }
+
+    // Search under each pair.
+    Search search = { list, tasks.list, (CrossingList *)calloc( tasks.count ? tasks.count : 1,
+                                                                sizeof( CrossingList ) ) };
+    parallelFor( tasks.count, searchTask, &search );
+
+    // Then gather what they found, in order.
+    int total = 0;
+    for ( int i = 0; i < tasks.count; i++ ) {
+        total += search.found[ i ].count;
+    }
+    *crossings = (Crossing *)malloc( ( total ? total : 1 ) * sizeof( Crossing ) );
+    int pos = 0;
+    for ( int i = 0; i < tasks.count; i++ ) {
+        for ( int j = 0; j < search.found[ i ].count; j++ ) {
+            ( *crossings )[ pos++ ] = search.found[ i ].list[ j ];
+        }
+        free( search.found[ i ].list );
+    }
+    qsort( *crossings, total, sizeof( Crossing ), compareCrossings );
+
+    free( search.found );
+    free( tasks.list );
+    return total;
+}
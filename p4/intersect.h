@@ -0,0 +1,73 @@
+/**
+    @file intersect.h
+    @author Brian Morris (bcmorri3)
+
+    The intersect.h header file declares the search for segments of different Models that
+    intersect. The pairs of Models to search come from sorting their boxes by left edge and
+    sweeping across them, which takes O(M log M) time for M Models plus a step for each
+    pair of boxes that overlap in x. Candidate pairs of segments then come from walking the
+    spatial indexes of two Models together, descending only into pairs of nodes whose boxes
+    meet.
+
+    The walk takes time in proportion to the pairs of nodes whose boxes meet. For segments
+    spread across the plane that is close to n + m + k, for Models of n and m segments with
+    k pairs that meet, but it has no output-sensitive bound: segments whose boxes overlap
+    without the segments meeting, as long nearly parallel ones do, can take it up to n * m.
+    That is weaker than the O(n log n + k) of a Bentley-Ottmann sweep, which orders its
+    events by intersection points. Those points are rational rather than doubles, and
+    comparing them exactly needs more than the orientation test used here.
+
+    Each candidate pair is then decided with exact orientation tests, so touching ends,
+    T junctions, collinear overlaps and zero length segments are all classified correctly,
+    however close to degenerate the coordinates are.
+ */
+
+#ifndef _INTERSECT_H_
+#define _INTERSECT_H_
+
+#include "spatial.h"
+
+/** Two segments that don't meet. */
+#define CONTACT_NONE 0
+
+/** Two segments that cross at a point inside both of them. */
+#define CONTACT_CROSS 1
+
+/** Two segments that meet at a single point at the end of at least one of them. */
+#define CONTACT_TOUCH 2
+
+/** Two collinear segments that share more than a point. */
+#define CONTACT_OVERLAP 3
+
+/** A pair of segments from different Models that meet. */
+typedef struct {
+    /** Index of the first segment's Model in the list searched. */
+    int first;
+
+    /** Index of the second segment's Model in the list searched, after first. */
+    int second;
+
+    /** Number of the segment within the first Model. */
+    int id1;
+
+    /** Number of the segment within the second Model. */
+    int id2;
+
+    /** How the segments meet, one of the CONTACT values. */
+    int kind;
+} Crossing;
+
+/**
+    This function finds every pair of segments from different Models in a list that meet.
+    The work is spread across the thread pool. See the top of this file for how it grows.
+
+    @param list the spatial indexes of the Models.
+    @param count the number of Models.
+    @param crossings set to a dynamically allocated list of the pairs, in order of first,
+                     second, id1 and id2. The caller frees it.
+
+    @return The number of pairs.
+ */
+int findCrossings( SpatialIndex * const *list, int count, Crossing **crossings );
+
+#endif
@@ -9,19 +9,543 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/mman.h>
 #include "model.h"
+#include "pool.h"
+#include "binary.h"
+#include "packed.h"
+#include "spatial.h"
+#include "spill.h"
+#include "output.h"
 
-Model *loadModel( char const *fname )
+/** Number of coordinates in one POINT_ALIGN-byte block. */
+#define ALIGN_COORDS ( POINT_ALIGN / sizeof( Coord ) )
+
+/** Smallest range of points given to one task when a Model is split up. */
+#define RANGE_POINTS 16384
+
+/** Number of ranges to aim for per thread, so uneven Models still balance. */
+#define RANGES_PER_THREAD 4
+
+/** Multiplier for mixing the bits of a point into a hash, from the golden ratio. */
+#define HASH_MIX 0x9E3779B97F4A7C15ULL
+
+/**
+    Bytes reserved for the Chunk struct at the front of a Chunk's allocation. It is a
+    multiple of POINT_ALIGN so the coordinate arrays that follow are aligned.
+ */
+#define CHUNK_HEADER ( ( sizeof( Chunk ) + POINT_ALIGN - 1 ) / POINT_ALIGN * POINT_ALIGN )
+
+/** A range of points in one Chunk, the unit of work for a parallel transform. */
+typedef struct {
+    /** The Chunk the points belong to. */
+    Chunk *c;
+
+    /** Index of the first point in the range. */
+    int start;
+
+    /** Number of points in the range. */
+    int len;
+} PointRange;
+
+/** The state shared by the tasks of one parallel transform. */
+typedef struct {
+    /** The Transform to apply. */
+    Transform const *t;
+
+    /** The ranges of points to transform. */
+    PointRange *ranges;
+} TransformJob;
+
+/**
+    The pointStride function returns the number of coordinates in the x array of a Chunk,
+    rounded up so the y array that follows it is aligned too.
+
+    @param numPoints the number of points in the Chunk.
+
+    @return The length of the x array, including padding.
+ */
+static size_t pointStride( int numPoints )
+{
+    return ( numPoints + ALIGN_COORDS - 1 ) / ALIGN_COORDS * ALIGN_COORDS;
+}
+
+/**
+    The chunkBytes function returns the size of the allocation holding a Chunk.
+
+    @param c the Chunk.
+
+    @return The number of bytes allocated for it.
+ */
+static size_t chunkBytes( Chunk const *c )
+{
+    if ( c->map || c->owner ) {
+        return CHUNK_HEADER;
+    }
+    size_t bytes = CHUNK_HEADER + 2 * pointStride( c->vCount ) * sizeof( Coord );
+    return c->idx ? bytes + c->count * sizeof( int ) : bytes;
+}
+
+/**
+    The allocBytes function allocates an aligned block from the arena, or from the heap if
+    there is no arena.
+
+    @param arena the Arena to allocate from, or NULL.
+    @param bytes the number of bytes needed.
+
+    @return A pointer to the block.
+ */
+static void *allocBytes( Arena *arena, size_t bytes )
+{
+    if ( arena ) {
+        return arenaAlloc( arena, bytes );
+    }
+    void *block;
+    if ( posix_memalign( &block, POINT_ALIGN, bytes ) != 0 ) {
+        return NULL;
+    }
+    return block;
+}
+
+/**
+    The freeBytes function gives a block back to wherever allocBytes got it from.
+
+    @param arena the Arena it came from, or NULL.
+    @param p the block.
+    @param bytes the number of bytes that were requested.
+ */
+static void freeBytes( Arena *arena, void *p, size_t bytes )
+{
+    if ( arena ) {
+        arenaFree( arena, p, bytes );
+    } else {
+        free( p );
+    }
+}
+
+/**
+    The appendChunk function adds a Chunk to the end of a Model.
+
+    @param m the Model to add to.
+    @param c the Chunk to add.
+ */
+static void appendChunk( Model *m, Chunk *c )
+{
+    c->next = NULL;
+    if ( m->tail ) {
+        m->tail->next = c;
+    } else {
+        m->head = c;
+    }
+    m->tail = c;
+    m->pCount += c->count;
+}
+
+/**
+    The freeChunk function frees a Chunk. Arrays shared with other Chunks are kept until
+    the last of them is freed, then released along with their mapping, if they have one.
+
+    @param arena the Arena the Chunk came from, or NULL.
+    @param c the Chunk to free.
+ */
+static void freeChunk( Arena *arena, Chunk *c )
+{
+    // A Chunk using another's arrays only has a header of its own.
+    if ( c->owner ) {
+        Chunk *owner = c->owner;
+        freeBytes( arena, c, CHUNK_HEADER );
+        c = owner;
+    }
+    if ( __atomic_sub_fetch( &c->refs, 1, __ATOMIC_ACQ_REL ) > 0 ) {
+        return;
+    }
+    if ( c->map ) {
+        releaseMapping( c->map );
+    }
+    freeBytes( arena, c, chunkBytes( c ) );
+}
+
+/**
+    The shareChunk function makes a Chunk that uses the arrays of another, so a Model can
+    have the same points as another without copying them.
+
+    @param arena the Arena to allocate from, the one the other Chunk came from.
+    @param c the Chunk whose arrays are used.
+
+    @return A pointer to the new Chunk, not yet added to any Model, or NULL if there was no
+            room for it.
+ */
+static Chunk *shareChunk( Arena *arena, Chunk *c )
+{
+    Chunk *owner = c->owner ? c->owner : c;
+    Chunk *view = (Chunk *)allocBytes( arena, CHUNK_HEADER );
+    if ( !view ) {
+        return NULL;
+    }
+    *view = *c;
+    view->map = NULL;
+    view->owner = owner;
+    view->refs = 0;
+    __atomic_add_fetch( &owner->refs, 1, __ATOMIC_RELAXED );
+    return view;
+}
+
+/**
+    The expandCoords function copies one of the coordinate arrays of a Chunk into an array
+    of stored coordinates, in segment order, expanding the shared points of an indexed
+    Chunk.
+
+    @param c the Chunk.
+    @param v the Chunk's xList or yList.
+    @param out the array to fill, with room for the Chunk's count of points.
+ */
+static void expandCoords( Chunk const *c, Coord const *v, Coord *out )
+{
+    if ( !c->idx ) {
+        memcpy( out, v, c->count * sizeof( Coord ) );
+        return;
+    }
+    for ( int i = 0; i < c->count; i++ ) {
+        out[ i ] = v[ c->idx[ i ] ];
+    }
+}
+
+/**
+    The copyPoints function copies every point of a Model, in order, into the arrays of a
+    Chunk, starting at the given index.
+
+    @param dest the Chunk to copy into.
+    @param pos the index of the first point to fill.
+    @param src the Model to copy from.
+
+    @return The index after the last point copied.
+ */
+static int copyPoints( Chunk *dest, int pos, Model const *src )
+{
+    for ( Chunk *c = src->head; c; c = c->next ) {
+        expandCoords( c, c->xList, dest->xList + pos );
+        expandCoords( c, c->yList, dest->yList + pos );
+        pos += c->count;
+    }
+    return pos;
+}
+
+/**
+    The newChunk function allocates a Chunk, with its coordinate arrays and, if it is
+    indexed, its index array all in one aligned block. In out-of-core mode, the arrays of a
+    Chunk storing at least SPILL_POINTS points go in a spill file instead, if one can be
+    made.
+
+    @param arena the Arena to allocate from, or NULL.
+    @param count the number of points.
+    @param vCount the number of points stored in the coordinate arrays.
+    @param indexed true if the Chunk needs an index array.
+
+    @return A pointer to the new Chunk, not yet added to any Model, or NULL if there was no
+            room for it.
+ */
+static Chunk *newChunk( Arena *arena, int count, int vCount, bool indexed )
+{
+    size_t stride = pointStride( vCount );
+    size_t arrays = 2 * stride * sizeof( Coord ) + ( indexed ? count * sizeof( int ) : 0 );
+    Mapping *map = vCount >= SPILL_POINTS ? spillMapping( arrays ) : NULL;
+    Chunk *c = (Chunk *)allocBytes( arena, map ? CHUNK_HEADER : CHUNK_HEADER + arrays );
+    if ( !c ) {
+        if ( map ) {
+            releaseMapping( map );
+        }
+        return NULL;
+    }
+    c->count = count;
+    c->vCount = vCount;
+    c->map = map;
+    c->owner = NULL;
+    c->refs = 1;
+    c->xList = (Coord *)( map ? (char *)map->base : (char *)c + CHUNK_HEADER );
+    c->yList = c->xList + stride;
+    c->idx = indexed ? (int *)( c->yList + stride ) : NULL;
+    return c;
+}
+
+/**
+    The pointHash function hashes the exact bits of a point's coordinates.
+
+    @param x the x-coordinate.
+    @param y the y-coordinate.
+
+    @return The hash.
+ */
+static uint64_t pointHash( Coord x, Coord y )
+{
+    uint64_t bx = 0, by = 0;
+    memcpy( &bx, &x, sizeof( x ) );
+    memcpy( &by, &y, sizeof( y ) );
+    uint64_t h = ( bx ^ ( by * HASH_MIX ) ) * HASH_MIX;
+    return h ^ ( h >> 32 );
+}
+
+/**
+    The sharePoints function replaces the single plain Chunk of a Model with an indexed
+    one, if enough of its points repeat to make that smaller. Points are only shared when
+    their coordinates have exactly the same bits, so saving the Model gives back exactly
+    what was loaded.
+
+    @param m the Model, with one Chunk that isn't indexed.
+ */
+static void sharePoints( Model *m )
+{
+    Chunk *c = m->head;
+    int n = c->count;
+
+    // An open addressing table of distinct points, at most half full.
+    int size = 1;
+    while ( size < 2 * n ) {
+        size *= 2;
+    }
+    int *table = (int *)malloc( size * sizeof( int ) );
+    int *idx = (int *)malloc( n * sizeof( int ) );
+
+    // Sharing is only a saving, so without room to work it out the points stay as they are.
+    if ( !table || !idx ) {
+        free( table );
+        free( idx );
+        return;
+    }
+    memset( table, -1, size * sizeof( int ) );
+
+    // Give each point the position of the first point with the same bits, and move the
+    // distinct points to the front of the arrays.
+    int vCount = 0;
+    for ( int i = 0; i < n; i++ ) {
+        Coord x = c->xList[ i ];
+        Coord y = c->yList[ i ];
+        int slot = pointHash( x, y ) & ( size - 1 );
+        while ( table[ slot ] >= 0 && ( memcmp( c->xList + table[ slot ], &x, sizeof( x ) ) != 0
+                                        || memcmp( c->yList + table[ slot ], &y, sizeof( y ) ) != 0 ) ) {
+            slot = ( slot + 1 ) & ( size - 1 );
+        }
+        if ( table[ slot ] < 0 ) {
+            table[ slot ] = vCount;
+            c->xList[ vCount ] = x;
+            c->yList[ vCount ] = y;
+            vCount++;
+        }
+        idx[ i ] = table[ slot ];
+    }
+    free( table );
+
+    // Keep the indexed form only if it saves memory, storing an int for each point but
+    // only the distinct coordinates, and there's room to make it.
+    Chunk *shared = NULL;
+    if ( 2 * sizeof( Coord ) * (size_t)vCount + sizeof( int ) * (size_t)n
+         < 2 * sizeof( Coord ) * (size_t)n ) {
+        shared = newChunk( m->arena, n, vCount, true );
+    }
+    if ( shared ) {
+        memcpy( shared->xList, c->xList, vCount * sizeof( Coord ) );
+        memcpy( shared->yList, c->yList, vCount * sizeof( Coord ) );
+        memcpy( shared->idx, idx, n * sizeof( int ) );
+        freeChunk( m->arena, c );
+        m->head = NULL;
+        m->tail = NULL;
+        m->pCount = 0;
+        appendChunk( m, shared );
+    } else if ( vCount < n ) {
+        // Some points were moved, so put them back in order.
+        for ( int i = n - 1; i >= 0; i-- ) {
+            c->xList[ i ] = c->xList[ idx[ i ] ];
+            c->yList[ i ] = c->yList[ idx[ i ] ];
+        }
+    }
+    free( idx );
+}
+
+void expandPoints( Chunk const *c, Coord const *v, double *out )
+{
+    if ( !c->idx && sizeof( Coord ) == sizeof( double ) ) {
+        memcpy( out, v, c->count * sizeof( double ) );
+        return;
+    }
+    for ( int i = 0; i < c->count; i++ ) {
+        out[ i ] = v[ c->idx ? c->idx[ i ] : i ];
+    }
+}
+
+void measureModel( Model *m )
+{
+    // The shared points of an indexed Chunk are all in use, so only those need checking.
+    // Spilled points are let go of a block at a time.
+    Box b = emptyBox();
+    for ( Chunk *c = m->head; c; c = c->next ) {
+        for ( int start = 0; start < c->vCount; start += SPILL_BLOCK ) {
+            int end = c->vCount - start < SPILL_BLOCK ? c->vCount : start + SPILL_BLOCK;
+            for ( int i = start; i < end; i++ ) {
+                Box pt = { c->xList[ i ], c->yList[ i ], c->xList[ i ], c->yList[ i ] };
+                addBox( &b, &pt );
+            }
+            releasePoints( c, start, end - start );
+        }
+    }
+    m->box = b;
+}
+
+Model *makeModel( int numPoints, Arena *arena )
+{
+    Model *m = (Model *)allocBytes( arena, sizeof( Model ) );
+    if ( !m ) {
+        return NULL;
+    }
+    m->name[ 0 ] = '\0';
+    m->fname[ 0 ] = '\0';
+    m->pCount = 0;
+    m->head = NULL;
+    m->tail = NULL;
+    m->arena = arena;
+    m->index = NULL;
+    m->saved = NULL;
+    m->savedLen = 0;
+    m->box = emptyBox();
+    m->refs = 1;
+
+    if ( numPoints > 0 && !addChunk( m, numPoints ) ) {
+        freeBytes( arena, m, sizeof( Model ) );
+        return NULL;
+    }
+    return m;
+}
+
+Chunk *addChunk( Model *m, int count )
+{
+    // The Chunk and both of its arrays share one aligned block, unless they're spilled.
+    Chunk *c = newChunk( m->arena, count, count, false );
+    if ( c ) {
+        appendChunk( m, c );
+    }
+    return c;
+}
+
+Mapping *makeMapping( void *base, size_t len )
+{
+    Mapping *map = (Mapping *)malloc( sizeof( Mapping ) );
+    if ( !map ) {
+        return NULL;
+    }
+    map->base = base;
+    map->len = len;
+    map->refs = 1;
+    map->spill = false;
+    return map;
+}
+
+void releaseMapping( Mapping *map )
+{
+    if ( __atomic_sub_fetch( &map->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) {
+        munmap( map->base, map->len );
+        free( map );
+    }
+}
+
+bool addMappedChunk( Model *m, Mapping *map, Coord *xList, Coord *yList, int count )
+{
+    Chunk *c = (Chunk *)allocBytes( m->arena, CHUNK_HEADER );
+    if ( !c ) {
+        return false;
+    }
+    c->count = count;
+    c->vCount = count;
+    c->xList = xList;
+    c->yList = yList;
+    c->idx = NULL;
+    c->map = map;
+    c->owner = NULL;
+    c->refs = 1;
+    __atomic_add_fetch( &map->refs, 1, __ATOMIC_RELAXED );
+    appendChunk( m, c );
+    return true;
+}
+
+bool flattenModel( Model *m )
+{
+    if ( m->head == m->tail && ( !m->head || !m->head->idx ) ) {
+        return true;
+    }
+
+    // Copy everything into one new Chunk, then free the old ones. Without room for it, the
+    // Model is left as it was.
+    Chunk *old = m->head;
+    Chunk *oldTail = m->tail;
+    int count = m->pCount;
+    m->head = NULL;
+    m->tail = NULL;
+    m->pCount = 0;
+    Chunk *flat = addChunk( m, count );
+    if ( !flat ) {
+        m->head = old;
+        m->tail = oldTail;
+        m->pCount = count;
+        return false;
+    }
+    int pos = 0;
+    while ( old ) {
+        Chunk *next = old->next;
+        expandCoords( old, old->xList, flat->xList + pos );
+        expandCoords( old, old->yList, flat->yList + pos );
+        pos += old->count;
+        freeChunk( m->arena, old );
+        old = next;
+    }
+    return true;
+}
+
+void dropIndex( Model *m )
+{
+    freeIndex( m->index );
+    m->index = NULL;
+}
+
+void dropSaved( Model *m )
+{
+    free( m->saved );
+    m->saved = NULL;
+    m->savedLen = 0;
+}
+
+void releaseMappings( Model *m )
+{
+    for ( Chunk *c = m->head; c; c = c->next ) {
+        if ( c->map ) {
+            releaseMapping( c->map );
+        }
+    }
+}
+
+Model *readModel( char const *fname, Arena *arena, int *status )
 {
     // Open the input file.
     FILE *lineCounter = fopen( fname, "r" );
 
-    // If it's NULL, print error message.
+    // If it's NULL, it can't be opened.
     if ( !lineCounter ) {
-        fprintf( stderr, "Can't open file: %s\n", fname );
+        *status = LOAD_CANT_OPEN;
         return NULL;
     }
 
+    // Check for the magic bytes of the binary and packed formats, which are the same length.
+    unsigned char head[ BINARY_MAGIC_LEN ];
+    int headLen = fread( head, 1, BINARY_MAGIC_LEN, lineCounter );
+    if ( isBinary( head, headLen ) || isPacked( head, headLen ) ) {
+        fclose( lineCounter );
+        Model *m = isBinary( head, headLen ) ? loadBinary( fname, arena, status )
+                                             : loadPacked( fname, arena, status );
+        if ( m ) {
+            strcpy( m->fname, fname );
+        }
+        return m;
+    }
+    rewind( lineCounter );
+
     // Used to store x-coordinate of a point.
     double x;
     // Used to store y-coordinate of a point.
@@ -36,99 +560,401 @@ Model *loadModel( char const *fname )
         matches = fscanf( lineCounter, "%lf %lf", &x, &y );
     }
 
-    // If there are no points, or an incomplete line segment, print error message.
+    // If there are no points, or an incomplete line segment, the format is invalid.
     if ( numPoints == 0 || numPoints % 2 != 0 ) {
-        fprintf( stderr, "Invalid model format: %s\n", fname );
+        *status = LOAD_INVALID;
         fclose( lineCounter );
         return NULL;
     }
     fclose( lineCounter );
 
-    // Dynamically allocate the Model.
-    Model *m = (Model *)malloc( sizeof( Model ) );
-    m->pList = (double (*)[ NUM_COORDS ])malloc( numPoints * NUM_COORDS * sizeof( double ) );
-    m->pCount = numPoints;
+    // Dynamically allocate the Model, if there's room for it.
+    Model *m = makeModel( numPoints, arena );
+    if ( !m ) {
+        *status = LOAD_NO_MEMORY;
+        return NULL;
+    }
     strcpy( m->fname, fname );
 
-    // Re-read input file and store its contents in the Model.
+    // Re-read input file and store its contents in the Model, letting go of each block of
+    // spilled points once it's written.
     FILE *input = fopen( fname, "r" );
 
+    Chunk *c = m->head;
     int count = 0;
     while ( fscanf( input, "%lf %lf", &x, &y ) == 2 && count < numPoints ) {
-        m->pList[ count ][ 0 ] = x;
-        m->pList[ count ][ 1 ] = y;
+        c->xList[ count ] = x;
+        c->yList[ count ] = y;
         count++;
+        if ( count % SPILL_BLOCK == 0 ) {
+            releasePoints( c, count - SPILL_BLOCK, SPILL_BLOCK );
+        }
     }
     fclose( input );
 
+    // Store the shared ends of connected segments once, and find the extent. Spilled points
+    // aren't shared, since that takes a table the size of the points in memory.
+    if ( !chunkSpilled( c ) ) {
+        sharePoints( m );
+    }
+    measureModel( m );
+
     // Return the model.
+    *status = LOAD_OK;
+    return m;
+}
+
+void reportLoadError( char const *fname, int status )
+{
+    if ( status == LOAD_CANT_OPEN ) {
+        fprintf( errStream(), "Can't open file: %s\n", fname );
+    } else if ( status == LOAD_INVALID ) {
+        fprintf( errStream(), "Invalid model format: %s\n", fname );
+    } else if ( status == LOAD_NO_MEMORY ) {
+        fprintf( errStream(), "Not enough memory for file: %s\n", fname );
+    }
+}
+
+void reportNoMemory( char const *mname )
+{
+    fprintf( errStream(), "Not enough memory for model: %s\n", mname );
+}
+
+Model *loadModel( char const *fname, Arena *arena )
+{
+    int status;
+    Model *m = readModel( fname, arena, &status );
+    if ( !m ) {
+        reportLoadError( fname, status );
+    }
     return m;
 }
 
 void freeModel( Model *m )
 {
-    // Free its points.
-    free( m->pList );
+    // Free its Chunks of points.
+    Chunk *c = m->head;
+    while ( c ) {
+        Chunk *next = c->next;
+        freeChunk( m->arena, c );
+        c = next;
+    }
+    dropIndex( m );
+    dropSaved( m );
     // Free the model pointer.
-    free( m );
+    freeBytes( m->arena, m, sizeof( Model ) );
+}
+
+/**
+    The chunkShared function reports whether a Chunk's arrays are used by another Chunk.
+
+    @param c the Chunk.
+
+    @return True if the Chunk is a view, or others are views of it.
+ */
+static bool chunkShared( Chunk const *c )
+{
+    return c->owner || __atomic_load_n( &c->refs, __ATOMIC_ACQUIRE ) != 1;
+}
+
+bool sharesPoints( Model const *m )
+{
+    for ( Chunk const *c = m->head; c; c = c->next ) {
+        if ( chunkShared( c ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ownPoints( Model *m )
+{
+    Chunk *prev = NULL;
+    for ( Chunk *c = m->head; c; prev = c, c = c->next ) {
+        if ( !chunkShared( c ) ) {
+            continue;
+        }
+
+        // Copy the arrays into a Chunk laid out the same way, and put it in this one's place.
+        Chunk *copy = newChunk( m->arena, c->count, c->vCount, c->idx != NULL );
+        if ( !copy ) {
+            return false;
+        }
+        memcpy( copy->xList, c->xList, c->vCount * sizeof( Coord ) );
+        memcpy( copy->yList, c->yList, c->vCount * sizeof( Coord ) );
+        if ( c->idx ) {
+            memcpy( copy->idx, c->idx, c->count * sizeof( int ) );
+        }
+        copy->next = c->next;
+        if ( prev ) {
+            prev->next = copy;
+        } else {
+            m->head = copy;
+        }
+        if ( m->tail == c ) {
+            m->tail = copy;
+        }
+        freeChunk( m->arena, c );
+        c = copy;
+    }
+    return true;
+}
+
+void transformModel( Model *m, Transform const *t )
+{
+    transformModels( &m, 1, t );
+}
+
+/**
+    The transformChunk function applies a Transform to a range of the stored points of a
+    Chunk, a block at a time, letting go of each block of spilled points once it's done.
+
+    @param t the Transform to apply.
+    @param c the Chunk.
+    @param start the index of the first point.
+    @param len the number of points.
+ */
+static void transformChunk( Transform const *t, Chunk *c, int start, int len )
+{
+    for ( int end = start + len; start < end; start += SPILL_BLOCK ) {
+        int n = end - start < SPILL_BLOCK ? end - start : SPILL_BLOCK;
+        transformCoords( t, c->xList + start, c->yList + start, n );
+        releasePoints( c, start, n );
+    }
+}
+
+/**
+    The transformRange function is run by parallelFor to transform one range of points.
+
+    @param ctx the TransformJob.
+    @param i the index of the range to transform.
+ */
+static void transformRange( void *ctx, int i )
+{
+    TransformJob *job = (TransformJob *)ctx;
+    PointRange *r = job->ranges + i;
+    transformChunk( job->t, r->c, r->start, r->len );
 }
 
-void applyToModel( Model *m, void (*f)( double pt[ NUM_COORDS ], double a, double b ), double a,
-                   double b )
+void transformModels( Model **list, int count, Transform const *t )
 {
-    // For every point in the Model, apply the function f.
-    for ( int i = 0; i < m->pCount; i++ ) {
-        f( m->pList[ i ], a, b );
+    // Keep the spatial indexes up to date, or drop the ones that can't be. The saved text
+    // is out of date either way.
+    for ( int i = 0; i < count; i++ ) {
+        if ( list[ i ]->index && !updateIndex( list[ i ]->index, t ) ) {
+            dropIndex( list[ i ] );
+        }
+        dropSaved( list[ i ] );
+    }
+
+    // Count the stored points, to see if this is worth spreading across threads.
+    long total = 0;
+    for ( int i = 0; i < count; i++ ) {
+        for ( Chunk *c = list[ i ]->head; c; c = c->next ) {
+            total += c->vCount;
+        }
     }
+
+    // Large jobs are split into ranges of points, spread across the pool.
+    PointRange *ranges = NULL;
+    int rangeCount = 0;
+    long rangeLen = 0;
+    if ( total >= PARALLEL_POINTS && poolThreads() > 1 ) {
+        // Pick a range length, a multiple of the alignment so ranges start on aligned points.
+        rangeLen = total / ( poolThreads() * RANGES_PER_THREAD );
+        if ( rangeLen < RANGE_POINTS ) {
+            rangeLen = RANGE_POINTS;
+        }
+        rangeLen = rangeLen / ALIGN_COORDS * ALIGN_COORDS;
+
+        // Split each Chunk into ranges; small Chunks become one range each.
+        for ( int i = 0; i < count; i++ ) {
+            for ( Chunk *c = list[ i ]->head; c; c = c->next ) {
+                rangeCount += ( c->vCount + rangeLen - 1 ) / rangeLen;
+            }
+        }
+        ranges = (PointRange *)malloc( rangeCount * sizeof( PointRange ) );
+    }
+
+    // Small jobs, and ones without room for their ranges, are done here a Chunk at a time.
+    if ( !ranges ) {
+        for ( int i = 0; i < count; i++ ) {
+            for ( Chunk *c = list[ i ]->head; c; c = c->next ) {
+                transformChunk( t, c, 0, c->vCount );
+            }
+        }
+        return;
+    }
+
+    int r = 0;
+    for ( int i = 0; i < count; i++ ) {
+        for ( Chunk *c = list[ i ]->head; c; c = c->next ) {
+            for ( int start = 0; start < c->vCount; start += rangeLen ) {
+                ranges[ r ].c = c;
+                ranges[ r ].start = start;
+                ranges[ r ].len = c->vCount - start < rangeLen ? c->vCount - start : rangeLen;
+                r++;
+            }
+        }
+    }
+
+    TransformJob job = { t, ranges };
+    parallelFor( rangeCount, transformRange, &job );
+    free( ranges );
 }
 
-Model *mergeModels( Model * const sourceModel1, Model * const sourceModel2 )
+/**
+    The spliceChunks function moves every Chunk of the source Model onto the end of the
+    destination Model, leaving the source empty.
+
+    @param dest the Model to move the Chunks to.
+    @param src the Model to move the Chunks from.
+ */
+static void spliceChunks( Model *dest, Model *src )
+{
+    if ( !src->head ) {
+        return;
+    }
+    if ( dest->tail ) {
+        dest->tail->next = src->head;
+    } else {
+        dest->head = src->head;
+    }
+    dest->tail = src->tail;
+    dest->pCount += src->pCount;
+
+    src->head = NULL;
+    src->tail = NULL;
+    src->pCount = 0;
+    dropIndex( src );
+    dropSaved( src );
+    dropSaved( dest );
+}
+
+Model *mergeModels( Model * const sourceModel1, Model * const sourceModel2, Arena *arena )
 {
     // Determine the number of points in the merged Model.
     int numPoints = sourceModel1->pCount + sourceModel2->pCount;
-    // Dynamically allocate the merged Model.
-    Model *m = (Model *)malloc( sizeof( Model ) );
-    m->pList = (double (*)[ NUM_COORDS ])malloc( numPoints * NUM_COORDS * sizeof( double ) );
-    m->pCount = numPoints;
-    strcpy( m->fname, "-" );
 
-    // Counter for merged Model pList index.
-    int count = 0;
+    // The merged Model covers both boxes.
+    Box box = sourceModel1->box;
+    addBox( &box, &sourceModel2->box );
 
-    // Give it the points of sourceModel1.
-    for ( int i = 0; i < sourceModel1->pCount; i++ ) {
-        m->pList[ count ][ 0 ] = sourceModel1->pList[ i ][ 0 ];
-        m->pList[ count ][ 1 ] = sourceModel1->pList[ i ][ 1 ];
-        count++;
+    // Small Models, or ones from another Arena, are copied into a single Chunk.
+    if ( numPoints < SPLICE_POINTS || sourceModel1->arena != arena
+         || sourceModel2->arena != arena ) {
+        Model *m = makeModel( numPoints, arena );
+        if ( !m ) {
+            return NULL;
+        }
+        strcpy( m->fname, "-" );
+        int pos = copyPoints( m->head, 0, sourceModel1 );
+        copyPoints( m->head, pos, sourceModel2 );
+        m->box = box;
+        return m;
     }
-    // Give it the points of sourceModel2.
-    for ( int i = 0; i < sourceModel2->pCount; i++ ) {
-        m->pList[ count ][ 0 ] = sourceModel2->pList[ i ][ 0 ];
-        m->pList[ count ][ 1 ] = sourceModel2->pList[ i ][ 1 ];
-        count++;
+
+    // Otherwise splice the Chunk lists together, once everything it needs has been made.
+    Model *m = makeModel( 0, arena );
+    if ( !m ) {
+        return NULL;
+    }
+    strcpy( m->fname, "-" );
+    m->box = box;
+
+    // Merging a Model with itself needs a copy for the second half.
+    Model *second = sourceModel2;
+    if ( sourceModel1 == sourceModel2 ) {
+        second = copyModel( sourceModel2, arena );
+        if ( !second ) {
+            freeModel( m );
+            return NULL;
+        }
+    }
+
+    spliceChunks( m, sourceModel1 );
+    spliceChunks( m, second );
+
+    if ( second != sourceModel2 ) {
+        freeModel( second );
     }
 
     // Return the merged model.
     return m;
 }
 
-Model *copyModel( Model * const sourceModel )
+Model *copyModel( Model * const sourceModel, Arena *arena )
 {
     // Determine the number of points in the copied Model.
     int numPoints = sourceModel->pCount;
 
     // Dynamically allocate the copied Model.
-    Model *m = (Model *)malloc( sizeof( Model ) );
-    m->pList = (double (*)[ NUM_COORDS ])malloc( numPoints * NUM_COORDS * sizeof( double ) );
-    m->pCount = numPoints;
+    Model *m = makeModel( numPoints, arena );
+    if ( !m ) {
+        return NULL;
+    }
     strcpy( m->fname, sourceModel->fname );
+    m->box = sourceModel->box;
 
-    // Give it the points of the source Model.
-    for ( int i = 0; i < numPoints; i++ ) {
-        m->pList[ i ][ 0 ] = sourceModel->pList[ i ][ 0 ];
-        m->pList[ i ][ 1 ] = sourceModel->pList[ i ][ 1 ];
+    // Give it the points of the source Model, in a single Chunk.
+    if ( numPoints > 0 ) {
+        copyPoints( m->head, 0, sourceModel );
+    }
+
+    // The same points save as the same text, so copying that is cheaper than formatting it.
+    // It's only a cache, so without room for it the copy is formatted when it's saved.
+    if ( sourceModel->saved ) {
+        m->saved = (char *)malloc( sourceModel->savedLen );
+        if ( m->saved ) {
+            memcpy( m->saved, sourceModel->saved, sourceModel->savedLen );
+            m->savedLen = sourceModel->savedLen;
+        }
     }
 
     // Return the duplicate.
     return m;
 }
+
+Model *cloneModel( Model * const sourceModel )
+{
+    // Copy everything but the points and the caches.
+    Model *m = makeModel( 0, sourceModel->arena );
+    if ( !m ) {
+        return NULL;
+    }
+    strcpy( m->name, sourceModel->name );
+    strcpy( m->fname, sourceModel->fname );
+    m->box = sourceModel->box;
+
+    // Share the points, giving up on the clone if there's no room for a view.
+    for ( Chunk *c = sourceModel->head; c; c = c->next ) {
+        Chunk *view = shareChunk( m->arena, c );
+        if ( !view ) {
+            freeModel( m );
+            return NULL;
+        }
+        appendChunk( m, view );
+    }
+    return m;
+}
+
+void replacePoints( Model *m, Model *src )
+{
+    // Free the old points.
+    Chunk *c = m->head;
+    while ( c ) {
+        Chunk *next = c->next;
+        freeChunk( m->arena, c );
+        c = next;
+    }
+    m->head = NULL;
+    m->tail = NULL;
+    m->pCount = 0;
+    dropIndex( m );
+    dropSaved( m );
+
+    // Then take the new ones.
+    spliceChunks( m, src );
+    freeModel( src );
+    measureModel( m );
+}
@@ -10,14 +10,112 @@
 #define _MODEL_H_
 
 #include <stdio.h>
+#include <stdbool.h>
+#include "transform.h"
+#include "arena.h"
 
 /** Maximum length of a Model name and file name string. */
 #define NAME_LIMIT 20
 
-/** The number of coordinates each point of a line segment contains. */
-#define NUM_COORDS 2
+/**
+    Transforms touching fewer points than this run on the calling thread, so small,
+    interactive edits don't pay for waking the thread pool.
+ */
+#define PARALLEL_POINTS 65536
+
+/** Byte alignment of the coordinate arrays, wide enough for an AVX register. */
+#define POINT_ALIGN 32
+
+/** Models with fewer points than this are copied by mergeModels rather than spliced. */
+#define SPLICE_POINTS 4096
+
+/** Load status for a Model file that was read successfully. */
+#define LOAD_OK 0
+
+/** Load status for a Model file that couldn't be opened. */
+#define LOAD_CANT_OPEN 1
+
+/** Load status for a Model file that isn't in the right format. */
+#define LOAD_INVALID 2
+
+/** Load status for a Model file whose points there wasn't room for. */
+#define LOAD_NO_MEMORY 3
+
+/** A file mapping shared by the Chunks that point into it. */
+typedef struct {
+    /** Start of the mapping. */
+    void *base;
+
+    /** Length of the mapping, in bytes. */
+    size_t len;
+
+    /** Number of Chunks, and other owners, still using the mapping. */
+    int refs;
+
+    /**
+        True for a shared mapping of a spill file, from spillMapping(), false for a private
+        mapping of a binary model file.
+     */
+    bool spill;
+} Mapping;
+
+/**
+    A run of points in a Model. The coordinates are stored as separate x and y arrays,
+    rather than as interleaved pairs, so the transform kernels can work on several points
+    at once. A Chunk always holds whole line segments, so its count is even.
+
+    Connected segments repeat their shared ends, so a Chunk can instead be indexed: the
+    arrays hold each distinct point once, and idx gives the position of every point of
+    every segment in them. Transforms then only touch the distinct points. Code that needs
+    the points in segment order should go through expandPoints().
+
+    Chunks of different Models can share the same arrays, once a Model held by a checkpoint
+    is cloned or merged. Shared arrays are only read; a Model copies them before it
+    changes its points.
+ */
+typedef struct ChunkTag {
+    /** Number of points in the chunk. */
+    int count;
+
+    /** Number of points stored in the coordinate arrays, the same as count if idx is NULL. */
+    int vCount;
+
+    /** The x-coordinates of the stored points, aligned to POINT_ALIGN bytes. */
+    Coord *xList;
+
+    /** The y-coordinates of the stored points, parallel to xList and also aligned. */
+    Coord *yList;
+
+    /**
+        For each of the count points, its position in the coordinate arrays, or NULL if
+        the arrays hold every point in order.
+     */
+    int *idx;
+
+    /**
+        The file mapping the coordinates live in, or NULL if they were allocated along
+        with the Chunk itself.
+     */
+    Mapping *map;
+
+    /** The Chunk whose arrays this one uses, or NULL if it has arrays of its own. */
+    struct ChunkTag *owner;
+
+    /**
+        Number of Chunks using this Chunk's arrays, itself included, if it has arrays of its
+        own. The memory goes when the last of them is freed.
+     */
+    int refs;
+
+    /** The next Chunk in the Model. */
+    struct ChunkTag *next;
+} Chunk;
 
-/** Representation for a model, a collection of line segments. */
+/**
+    Representation for a model, a collection of line segments. The points are kept in a
+    list of Chunks, so merging Models can splice their lists together instead of copying
+    every point. Code that needs all the points in one array can call flattenModel().
+ */
 typedef struct {
     /** Name of the model. */
     char name[ NAME_LIMIT + 1 ];
@@ -28,66 +126,294 @@ typedef struct {
     /** Number of points in the model. It has half this many line segments. */
     int pCount;
 
+    /** First Chunk of points, or NULL if the Model is empty. */
+    Chunk *head;
+
+    /** Last Chunk of points, so Chunks can be added in constant time. */
+    Chunk *tail;
+
+    /** The Arena the Model and its Chunks came from, or NULL if they came from malloc. */
+    Arena *arena;
+
+    /** Spatial index of the segments, built when it is first needed, or NULL. */
+    struct SpatialTag *index;
+
     /**
-        List of points in the model, twice as long as the number
-        of segments, since each segment has two points
+        The text saveScene last wrote for the Model's segments, or NULL if the Model has
+        changed since then, or hasn't been saved as text.
      */
-    double (*pList)[ NUM_COORDS ];
+    char *saved;
+
+    /** Length of the saved text. */
+    size_t savedLen;
+
+    /**
+        Bounding box of the points. Transforms don't update it themselves; the Scene moves
+        it with transformBox() when it queues one, so it may be ahead of the points.
+     */
+    Box box;
+
+    /**
+        Number of Model lists holding the Model: the Scene's, and its checkpoints'. A Model
+        held by more than one has to be cloned with cloneModel() before it is changed.
+     */
+    int refs;
 } Model;
 
+/**
+    This function sets the bounding box of a Model to the exact box of its points.
+
+    @param m the Model to measure.
+ */
+void measureModel( Model *m );
+
+/**
+    This function dynamically allocates a Model with room for the given number of points, in
+    a single Chunk. The names are left empty, and the Model counts as held by one list.
+
+    @param numPoints the number of points the Model will hold, or zero for no Chunks.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+
+    @return A pointer to the new Model, or NULL if there was no room for it.
+ */
+Model *makeModel( int numPoints, Arena *arena );
+
+/**
+    This function allocates a Chunk with room for the given number of points and adds it to
+    the end of the Model. The caller fills in the coordinates. In out-of-core mode, large
+    Chunks keep their points in a spill file.
+
+    @param m the Model to add to.
+    @param count the number of points in the Chunk.
+
+    @return A pointer to the new Chunk, or NULL if there was no room for it.
+ */
+Chunk *addChunk( Model *m, int count );
+
+/**
+    This function copies one of the coordinate arrays of a Chunk into an array of doubles
+    holding every point in segment order, expanding the shared points of an indexed Chunk.
+
+    @param c the Chunk.
+    @param v the Chunk's xList or yList.
+    @param out the array to fill, with room for the Chunk's count of points.
+ */
+void expandPoints( Chunk const *c, Coord const *v, double *out );
+
+/**
+    This function wraps a private file mapping so Chunks can share it. The caller holds the
+    first reference, and must release it with releaseMapping().
+
+    @param base the start of the mapping.
+    @param len the length of the mapping, in bytes.
+
+    @return A pointer to the new Mapping, or NULL if there was no room for it.
+ */
+Mapping *makeMapping( void *base, size_t len );
+
+/**
+    This function drops one reference to a Mapping, unmapping it when the last one is gone.
+
+    @param map the Mapping to release.
+ */
+void releaseMapping( Mapping *map );
+
+/**
+    This function adds a Chunk to the end of the Model whose points live in the given
+    mapping. The Chunk takes its own reference to the mapping. The coordinates have to be
+    stored as Coord values.
+
+    @param m the Model to add to.
+    @param map the Mapping holding the points.
+    @param xList the x-coordinates, inside the mapping.
+    @param yList the y-coordinates, inside the mapping.
+    @param count the number of points.
+
+    @return True, or false if there was no room for the Chunk.
+ */
+bool addMappedChunk( Model *m, Mapping *map, Coord *xList, Coord *yList, int count );
+
+/**
+    This function replaces the Chunks of a Model with a single Chunk holding all of its
+    points in order, for code that needs the points in one pair of arrays. A Model that
+    already has one Chunk that isn't indexed is left alone.
+
+    @param m the Model to flatten.
+
+    @return True, or false if there was no room for the new Chunk, leaving the Model as it
+            was.
+ */
+bool flattenModel( Model *m );
+
+/**
+    This function releases the file mappings used by a Model's Chunks without freeing any
+    memory. It is for Models whose Arena is about to be freed all at once.
+
+    @param m the Model whose mappings should be released.
+ */
+void releaseMappings( Model *m );
+
+/**
+    This function frees a Model's spatial index, if it has one, so it will be built again
+    from the current points the next time it is needed.
+
+    @param m the Model.
+ */
+void dropIndex( Model *m );
+
+/**
+    This function frees the text saved for a Model, if it has any, marking it as changed
+    since it was last saved. Anything that moves the Model's points has to call it.
+
+    @param m the Model.
+ */
+void dropSaved( Model *m );
+
 /**
     This function reads a Model from a file with the given name, returning a pointer to a
-    dynamically allocated instance of Model. If the input file can't be opened or the Model
-    isn't in the right format, an error message is printed and NULL is returned.
+    dynamically allocated instance of Model. Files that start with the binary model magic
+    bytes are loaded with loadBinary(), ones with the packed model magic bytes with
+    loadPacked(), and anything else is read as text. Text Models whose
+    segments share enough of their ends are stored in an indexed Chunk. Nothing is printed,
+    so it is safe to call ahead of time on another thread; if the input file can't be
+    opened, the Model isn't in the right format or there's no room for its points, NULL is
+    returned and status says why.
 
     @param fname the name of the input file.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+    @param status set to LOAD_OK, LOAD_CANT_OPEN, LOAD_INVALID or LOAD_NO_MEMORY.
 
     @return A pointer to a dynamically allocated instance of Model, or NULL if there is an error.
  */
-Model *loadModel( char const *fname );
+Model *readModel( char const *fname, Arena *arena, int *status );
+
+/**
+    This function prints the error message for a Model file that couldn't be loaded.
+
+    @param fname the name of the input file.
+    @param status the status readModel() gave for the file.
+ */
+void reportLoadError( char const *fname, int status );
+
+/**
+    This function prints the error message for a command that couldn't make or change a
+    Model because there wasn't enough memory.
+
+    @param mname the name the command was given for the Model.
+ */
+void reportNoMemory( char const *mname );
+
+/**
+    This function reads a Model the way readModel() does, printing an error message if the
+    input file can't be opened or the Model isn't in the right format.
+
+    @param fname the name of the input file.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+
+    @return A pointer to a dynamically allocated instance of Model, or NULL if there is an error.
+ */
+Model *loadModel( char const *fname, Arena *arena );
 
 /**
     This function frees the dynamically allocated memory used to store the given Model including
-    the Model itself and the list of points.
+    the Model itself and the list of points. Memory from an Arena goes back to the Arena for
+    reuse.
 
     @param m the Model to be freed.
  */
 void freeModel( Model *m );
 
 /**
-    This function applies a geometric transformation to every line segment in the given Model.
-    This is accomplished by using the given function f, on the line segments. The parameters a
-    and b are the values used to transform the Model. One or both of a and b will be used to
-    apply the transformation, depending on the type of transformation.
+    This function reports whether any of a Model's Chunks share their arrays with other
+    Chunks, as a clone and the Model it was cloned from do until one of them changes.
+
+    @param m the Model.
+
+    @return True if ownPoints() has anything to copy.
+ */
+bool sharesPoints( Model const *m );
+
+/**
+    This function gives every Chunk of a Model arrays of its own, copying the ones it shares
+    with other Chunks, so its points can be changed in place. It has to be called before a
+    Model's points are transformed, once the Model's queued transforms are done.
 
-    @param m the Model to apply the geometric transformation to.
-    @param f the transformation function to be applied to the Model.
-    @param a the first required value for transformation.
-    @param b the second required value for transformation.
+    @param m the Model.
+
+    @return True, or false if there was no room for a copy. The Model still has all its
+            points either way, but some may still be shared.
  */
-void applyToModel( Model *m, void (*f)( double pt[ NUM_COORDS ], double a, double b ), double a,
-                   double b );
+bool ownPoints( Model *m );
+
+/**
+    This function applies the given Transform to every point in the given Model using the
+    vectorized kernels from transform.h. Large Models are split into ranges of points that
+    are transformed in parallel. Its points can't be shared with another Model; see
+    ownPoints().
+
+    @param m the Model to transform.
+    @param t the Transform to apply.
+ */
+void transformModel( Model *m, Transform const *t );
+
+/**
+    This function applies the given Transform to every point of every Model in the given
+    list. When there are at least PARALLEL_POINTS points in total, the Models, and ranges
+    of points within large Models, are spread across the thread pool. None of the Models
+    can share points with another; see ownPoints().
+
+    @param list the Models to transform.
+    @param count the number of Models in the list.
+    @param t the Transform to apply.
+ */
+void transformModels( Model **list, int count, Transform const *t );
 
 /**
     This function accepts two Model pointers as parameters and merges the points found within
     both models into a single Model pointer. The points of sourceModel1 are added before the
-    points of sourceModel2.
+    points of sourceModel2. Unless the Models are small, or came from a different Arena, their
+    Chunks are moved onto the new Model rather than copied, which leaves the source Models
+    empty; the caller is expected to remove them afterward.
 
     @param sourceModel1 the first source Model to merge.
     @param sourceModel2 the second source Model to merge.
+    @param arena the Arena to allocate from, or NULL to use malloc.
 
-    @return A pointer to a new, merged Model.
+    @return A pointer to a new, merged Model, or NULL if there was no room for it, in which
+            case the source Models are unchanged.
  */
-Model *mergeModels( Model * const sourceModel1, Model * const sourceModel2 );
+Model *mergeModels( Model * const sourceModel1, Model * const sourceModel2, Arena *arena );
 
 /**
     This function accepts a source Model pointer and creates a dynamically allocated
     duplicate of the source Model. A pointer to the duplicate is returned.
 
     @param sourceModel the source Model of the duplicate.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+
+    @return A pointer to the duplicate Model, or NULL if there was no room for it.
+ */
+Model *copyModel( Model * const sourceModel, Arena *arena );
+
+/**
+    This function makes a Model with the same name and points as the given one, in the same
+    Arena. The clone's Chunks use the arrays of the original's rather than copying them, so
+    this takes time for each Chunk but not for each point. Neither Model's points are
+    copied until one of them is changed. The clone has no spatial index or saved text.
+
+    @param sourceModel the Model to clone.
+
+    @return A pointer to the clone, or NULL if there was no room for it.
+ */
+Model *cloneModel( Model * const sourceModel );
+
+/**
+    This function replaces the points of a Model with the points of another Model from the
+    same Arena. The Chunks of the other Model are moved over, and it is freed.
 
-    @return A pointer to the duplicate Model.
+    @param m the Model whose points are replaced.
+    @param src the Model holding the new points, which is freed.
  */
-Model *copyModel( Model * const sourceModel );
+void replacePoints( Model *m, Model *src );
 
 #endif
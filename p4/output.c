@@ -0,0 +1,30 @@
+/**
+    @file output.c
+    @author Brian Morris (bcmorri3)
+
+    The output.c program contains the per-thread streams defined in output.h.
+ */
+
+#include "output.h"
+
+/** The calling thread's stream for results, or NULL for stdout. */
+static __thread FILE *threadOut = NULL;
+
+/** The calling thread's stream for error messages, or NULL for stderr. */
+static __thread FILE *threadErr = NULL;
+
+FILE *outStream()
+{
+    return threadOut ? threadOut : stdout;
+}
+
+FILE *errStream()
+{
+    return threadErr ? threadErr : stderr;
+}
+
+void setStreams( FILE *out, FILE *err )
+{
+    threadOut = out;
+    threadErr = err;
+}
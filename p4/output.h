@@ -0,0 +1,39 @@
+/**
+    @file output.h
+    @author Brian Morris (bcmorri3)
+
+    The output.h header file declares where commands print their results and error
+    messages. That is standard output and standard error unless the thread running the
+    command has been given streams of its own, which lets the server run the commands of
+    several clients at once, each printing to its own connection.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stdio.h>
+
+/**
+    This function returns the stream the calling thread prints results to.
+
+    @return The thread's output stream, or stdout if it hasn't been given one.
+ */
+FILE *outStream();
+
+/**
+    This function returns the stream the calling thread prints error messages to.
+
+    @return The thread's error stream, or stderr if it hasn't been given one.
+ */
+FILE *errStream();
+
+/**
+    This function gives the calling thread its own streams, or gives it back the standard
+    ones.
+
+    @param out the stream for results, or NULL for stdout.
+    @param err the stream for error messages, or NULL for stderr.
+ */
+void setStreams( FILE *out, FILE *err );
+
+#endif
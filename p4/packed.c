@@ -0,0 +1,532 @@
+/**
+    @file packed.c
+    @author Brian Morris (bcmorri3)
+
+    The packed.c program contains the functions defined in packed.h for reading and
+    writing the packed model format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "packed.h"
+#include "format.h"
+#include "pool.h"
+#include "spill.h"
+
+/** Number of bytes in the file header. */
+#define HEADER_LEN 32
+
+/** Number of bytes in a directory entry. */
+#define ENTRY_LEN 32
+
+/** Number of bytes reserved for a name in a directory entry. */
+#define ENTRY_NAME_LEN 24
+
+/** Offset of the version in the header. */
+#define VERSION_AT 4
+
+/** Offset of the model count in the header. */
+#define COUNT_AT 8
+
+/** Offset of the number of points per block in the header. */
+#define BLOCK_POINTS_AT 12
+
+/** Offset of the block count in the header. */
+#define BLOCKS_AT 16
+
+/** Offset of the file length in the header. */
+#define LENGTH_AT 24
+
+/** Offset of the point count in a directory entry. */
+#define POINTS_AT 24
+
+/** Number of bytes in each stream offset. */
+#define OFFSET_LEN 8
+
+/** Coordinates are stored in thousandths. */
+#define SCALE 1000.0
+
+/** Number of bits of a value in each byte of a varint. */
+#define VARINT_BITS 7
+
+/** Bit set on every byte of a varint but the last. */
+#define VARINT_MORE 0x80
+
+/** Mask for the value bits in a byte of a varint. */
+#define VARINT_MASK 0x7F
+
+/** Most bytes in the varint of a 64-bit value. */
+#define MAX_VARINT 10
+
+/** Number of bits in a byte. */
+#define BYTE_BITS 8
+
+/** Mask for the low byte of a value. */
+#define BYTE_MASK 0xFF
+
+/** The state shared by the threads decoding a packed file. */
+typedef struct {
+    /** The mapped file. */
+    unsigned char const *file;
+
+    /** The stream offsets, still in the file's byte order. */
+    unsigned char const *offsets;
+
+    /** The index of each block's first point in the Chunk, and the total after the last. */
+    int *blockPos;
+
+    /** The Chunk the points go in. */
+    Chunk *c;
+
+    /** Set if any block's streams don't hold the right number of points. */
+    int bad;
+} Unpacker;
+
+/** The state of a packed file being written. */
+typedef struct {
+    /** The output file. */
+    FILE *output;
+
+    /** The stream offsets, in the file's byte order. */
+    unsigned char *offsets;
+
+    /** Number of stream offsets filled in so far. */
+    int streams;
+
+    /** The offset in the file of the next byte written. */
+    uint64_t pos;
+
+    /** Number of points waiting in the block. */
+    int n;
+
+    /** The x-coordinates of the points in the block. */
+    double x[ PACK_BLOCK ];
+
+    /** The y-coordinates of the points in the block. */
+    double y[ PACK_BLOCK ];
+
+    /** Storage for one stream's varints. */
+    unsigned char bytes[ PACK_BLOCK * MAX_VARINT ];
+} Packer;
+
+/**
+    The getLE function reads a little-endian unsigned integer.
+
+    @param p the first byte of the integer.
+    @param len the number of bytes in the integer.
+
+    @return The value of the integer.
+ */
+static uint64_t getLE( unsigned char const *p, int len )
+{
+    uint64_t v = 0;
+    for ( int i = len - 1; i >= 0; i-- ) {
+        v = ( v << BYTE_BITS ) | p[ i ];
+    }
+    return v;
+}
+
+/**
+    The putLE function stores an unsigned integer in little-endian order.
+
+    @param p where to store the first byte.
+    @param v the value to store.
+    @param len the number of bytes to store.
+ */
+static void putLE( unsigned char *p, uint64_t v, int len )
+{
+    for ( int i = 0; i < len; i++ ) {
+        p[ i ] = v & BYTE_MASK;
+        v >>= BYTE_BITS;
+    }
+}
+
+bool isPacked( unsigned char const *head, int len )
+{
+    return len >= PACKED_MAGIC_LEN && memcmp( head, PACKED_MAGIC, PACKED_MAGIC_LEN ) == 0;
+}
+
+bool hasPackedExtension( char const *fname )
+{
+    size_t len = strlen( fname );
+    size_t extLen = strlen( PACKED_EXTENSION );
+    return len > extLen && strcmp( fname + len - extLen, PACKED_EXTENSION ) == 0;
+}
+
+/**
+    The decodeStream function decodes one stream of a block into coordinates. The varints
+    are read first, then the differences are added up, then the sums are scaled, so the
+    first step is the only one that goes a byte at a time and the last can be vectorized.
+
+    @param p the first byte of the stream.
+    @param end the byte after the last one in the stream.
+    @param out where to store the coordinates.
+    @param n the number of coordinates in the stream, at most PACK_BLOCK.
+
+    @return True if the stream held exactly n values.
+ */
+static bool decodeStream( unsigned char const *p, unsigned char const *end, Coord *out, int n )
+{
+    uint64_t q[ PACK_BLOCK ];
+
+    // Read the varints, undoing the zig-zag encoding as each one is finished.
+    for ( int i = 0; i < n; i++ ) {
+        uint64_t v = 0;
+        int shift = 0;
+        unsigned char b;
+        do {
+            if ( p == end || shift >= MAX_VARINT * VARINT_BITS ) {
+                return false;
+            }
+            b = *p++;
+            v |= (uint64_t)( b & VARINT_MASK ) << shift;
+            shift += VARINT_BITS;
+        } while ( b & VARINT_MORE );
+        q[ i ] = ( v >> 1 ) ^ -( v & 1 );
+    }
+    if ( p != end ) {
+        return false;
+    }
+
+    // Add up the differences. Unsigned sums wrap, so even a bad file can't overflow them.
+    for ( int i = 1; i < n; i++ ) {
+        q[ i ] += q[ i - 1 ];
+    }
+
+    // Scale back to the grid. Division, rather than multiplying by 0.001, gives the same
+    // double that reading the printed value would.
+    for ( int i = 0; i < n; i++ ) {
+        out[ i ] = (Coord)( (double)(int64_t)q[ i ] / SCALE );
+    }
+    return true;
+}
+
+/**
+    The unpackBlock function is run by parallelFor to decode one block of a packed file.
+
+    @param ctx the Unpacker.
+    @param i the index of the block.
+ */
+static void unpackBlock( void *ctx, int i )
+{
+    Unpacker *u = (Unpacker *)ctx;
+    int start = u->blockPos[ i ];
+    int n = u->blockPos[ i + 1 ] - start;
+    unsigned char const *x = u->file + getLE( u->offsets + 2 * i * OFFSET_LEN, OFFSET_LEN );
+    unsigned char const *y = u->file + getLE( u->offsets + ( 2 * i + 1 ) * OFFSET_LEN,
+                                              OFFSET_LEN );
+    unsigned char const *end = u->file + getLE( u->offsets + ( 2 * i + 2 ) * OFFSET_LEN,
+                                                OFFSET_LEN );
+    if ( !decodeStream( x, y, u->c->xList + start, n )
+         || !decodeStream( y, end, u->c->yList + start, n ) ) {
+        __atomic_store_n( &u->bad, 1, __ATOMIC_RELAXED );
+    }
+    releasePoints( u->c, start, n );
+}
+
+/**
+    The invalidPacked function records that a packed file is badly formatted and releases
+    what was set up for it.
+
+    @param status set to LOAD_INVALID.
+    @param map the mapping of the file.
+    @param len the length of the mapping.
+    @param blockPos the block positions, or NULL.
+
+    @return NULL, so callers can return the result.
+ */
+static Model *invalidPacked( int *status, void *map, size_t len, int *blockPos )
+{
+    *status = LOAD_INVALID;
+    free( blockPos );
+    munmap( map, len );
+    return NULL;
+}
+
+Model *loadPacked( char const *fname, Arena *arena, int *status )
+{
+    // Map the whole file. It's only read, then let go.
+    int fd = open( fname, O_RDONLY );
+    if ( fd < 0 ) {
+        *status = LOAD_CANT_OPEN;
+        return NULL;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size < HEADER_LEN + OFFSET_LEN ) {
+        close( fd );
+        *status = LOAD_INVALID;
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void *map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED ) {
+        *status = LOAD_CANT_OPEN;
+        return NULL;
+    }
+    unsigned char const *file = (unsigned char const *)map;
+
+    // Check the header, and that the directory and stream offsets fit in the file.
+    uint64_t count = getLE( file + COUNT_AT, sizeof( uint32_t ) );
+    uint64_t blockPoints = getLE( file + BLOCK_POINTS_AT, sizeof( uint32_t ) );
+    uint64_t blocks = getLE( file + BLOCKS_AT, sizeof( uint64_t ) );
+    if ( !isPacked( file, size ) || getLE( file + VERSION_AT, sizeof( uint16_t ) ) != PACKED_VERSION
+         || getLE( file + LENGTH_AT, sizeof( uint64_t ) ) != size || count == 0
+         || blockPoints == 0 || blockPoints > PACK_BLOCK
+         || count > ( size - HEADER_LEN - OFFSET_LEN ) / ENTRY_LEN
+         || blocks > ( size - HEADER_LEN - count * ENTRY_LEN - OFFSET_LEN ) / ( 2 * OFFSET_LEN ) ) {
+        return invalidPacked( status, map, size, NULL );
+    }
+    unsigned char const *offsets = file + HEADER_LEN + count * ENTRY_LEN;
+    uint64_t dataStart = HEADER_LEN + count * ENTRY_LEN + ( 2 * blocks + 1 ) * OFFSET_LEN;
+
+    // Every stream has to start where the last one ended, and the last end with the file.
+    uint64_t prev = dataStart;
+    for ( uint64_t i = 0; i <= 2 * blocks; i++ ) {
+        uint64_t off = getLE( offsets + i * OFFSET_LEN, OFFSET_LEN );
+        if ( off < prev || off > size ) {
+            return invalidPacked( status, map, size, NULL );
+        }
+        prev = off;
+    }
+    if ( prev != size ) {
+        return invalidPacked( status, map, size, NULL );
+    }
+
+    // Find where each block's points go, checking the blocks add up to the directory.
+    int *blockPos = (int *)malloc( ( blocks + 1 ) * sizeof( int ) );
+    if ( !blockPos ) {
+        munmap( map, size );
+        *status = LOAD_NO_MEMORY;
+        return NULL;
+    }
+    uint64_t total = 0;
+    uint64_t block = 0;
+    for ( uint64_t i = 0; i < count; i++ ) {
+        unsigned char const *entry = file + HEADER_LEN + i * ENTRY_LEN;
+        uint64_t points = getLE( entry + POINTS_AT, sizeof( uint64_t ) );
+        if ( points % 2 != 0 || points > INT32_MAX
+             || ( points + blockPoints - 1 ) / blockPoints > blocks - block ) {
+            return invalidPacked( status, map, size, blockPos );
+        }
+        for ( uint64_t p = 0; p < points; p += blockPoints ) {
+            blockPos[ block++ ] = (int)( total + p );
+        }
+        total += points;
+        if ( total > INT32_MAX ) {
+            return invalidPacked( status, map, size, blockPos );
+        }
+    }
+    if ( total == 0 || block != blocks ) {
+        return invalidPacked( status, map, size, blockPos );
+    }
+    blockPos[ blocks ] = (int)total;
+
+    Model *m = makeModel( (int)total, arena );
+    if ( !m ) {
+        *status = LOAD_NO_MEMORY;
+        free( blockPos );
+        munmap( map, size );
+        return NULL;
+    }
+
+    // Decode the blocks, spreading them across threads if there are enough points.
+    Unpacker u = { file, offsets, blockPos, m->head, 0 };
+    if ( total < PARALLEL_POINTS || poolThreads() == 1 ) {
+        for ( int i = 0; i < (int)blocks; i++ ) {
+            unpackBlock( &u, i );
+        }
+    } else {
+        parallelFor( (int)blocks, unpackBlock, &u );
+    }
+    free( blockPos );
+    munmap( map, size );
+    if ( u.bad ) {
+        freeModel( m );
+        *status = LOAD_INVALID;
+        return NULL;
+    }
+
+    measureModel( m );
+    *status = LOAD_OK;
+    return m;
+}
+
+/**
+    The writeStream function encodes one coordinate of the points in the block and writes
+    it, recording where the stream starts.
+
+    @param p the Packer.
+    @param v the coordinates to write.
+
+    @return False if a coordinate couldn't be put on the grid or the stream couldn't be
+            written.
+ */
+static bool writeStream( Packer *p, double const *v )
+{
+    putLE( p->offsets + p->streams++ * OFFSET_LEN, p->pos, OFFSET_LEN );
+
+    // Each block starts over from zero, so it can be decoded on its own.
+    int64_t prev = 0;
+    size_t len = 0;
+    for ( int i = 0; i < p->n; i++ ) {
+        int64_t q;
+        if ( !scaleCoord( v[ i ], &q ) ) {
+            return false;
+        }
+
+        // Zig-zag the difference, so small steps either way take few bytes.
+        int64_t d = q - prev;
+        uint64_t z = ( (uint64_t)d << 1 ) ^ ( d < 0 ? UINT64_MAX : 0 );
+        prev = q;
+        while ( z >= VARINT_MORE ) {
+            p->bytes[ len++ ] = ( z & VARINT_MASK ) | VARINT_MORE;
+            z >>= VARINT_BITS;
+        }
+        p->bytes[ len++ ] = z;
+    }
+    if ( fwrite( p->bytes, 1, len, p->output ) != len ) {
+        return false;
+    }
+    p->pos += len;
+    return true;
+}
+
+/**
+    The flushBlock function writes the points waiting in the block, if there are any.
+
+    @param p the Packer.
+
+    @return False if a coordinate couldn't be put on the grid or written.
+ */
+static bool flushBlock( Packer *p )
+{
+    if ( p->n == 0 ) {
+        return true;
+    }
+    bool ok = writeStream( p, p->x ) && writeStream( p, p->y );
+    p->n = 0;
+    return ok;
+}
+
+/**
+    The packModel function writes the points of a Model as blocks of PACK_BLOCK points,
+    with a shorter one at the end.
+
+    @param p the Packer.
+    @param m the Model.
+
+    @return False if a coordinate couldn't be put on the grid or written.
+ */
+static bool packModel( Packer *p, Model const *m )
+{
+    for ( Chunk const *c = m->head; c; c = c->next ) {
+        for ( int j = 0; j < c->count; j++ ) {
+            // Find where the point is stored, if its Chunk is indexed.
+            int v = c->idx ? c->idx[ j ] : j;
+            p->x[ p->n ] = c->xList[ v ];
+            p->y[ p->n ] = c->yList[ v ];
+            p->n++;
+            if ( p->n == PACK_BLOCK && !flushBlock( p ) ) {
+                return false;
+            }
+
+            // Spilled points are let go of a block at a time.
+            if ( !c->idx && ( j + 1 ) % SPILL_BLOCK == 0 ) {
+                releasePoints( c, j + 1 - SPILL_BLOCK, SPILL_BLOCK );
+            }
+        }
+    }
+    return flushBlock( p );
+}
+
+int savePacked( Model **list, int count, char const *fname )
+{
+    FILE *output = fopen( fname, "wb" );
+    if ( !output ) {
+        return PACK_CANT_OPEN;
+    }
+
+    // Fill in the directory, and count the blocks.
+    unsigned char *dir = (unsigned char *)calloc( count ? count : 1, ENTRY_LEN );
+    if ( !dir ) {
+        fclose( output );
+        remove( fname );
+        return PACK_NO_MEMORY;
+    }
+    uint64_t blocks = 0;
+    for ( int i = 0; i < count; i++ ) {
+        unsigned char *entry = dir + i * ENTRY_LEN;
+        strncpy( (char *)entry, list[ i ]->name, ENTRY_NAME_LEN - 1 );
+        putLE( entry + POINTS_AT, list[ i ]->pCount, sizeof( uint64_t ) );
+        blocks += ( list[ i ]->pCount + PACK_BLOCK - 1 ) / PACK_BLOCK;
+    }
+
+    // Leave room for the header and the stream offsets, then write the points.
+    Packer *p = (Packer *)malloc( sizeof( Packer ) );
+    size_t dirLen = (size_t)count * ENTRY_LEN;
+    size_t offsetsLen = ( 2 * blocks + 1 ) * OFFSET_LEN;
+    unsigned char *offsets = p ? (unsigned char *)calloc( 1, offsetsLen ) : NULL;
+    if ( !offsets ) {
+        free( p );
+        free( dir );
+        fclose( output );
+        remove( fname );
+        return PACK_NO_MEMORY;
+    }
+    p->output = output;
+    p->offsets = offsets;
+    p->streams = 0;
+    p->pos = HEADER_LEN + dirLen + offsetsLen;
+    p->n = 0;
+    unsigned char header[ HEADER_LEN ] = { 0 };
+    bool written = fwrite( header, 1, HEADER_LEN, output ) == HEADER_LEN
+                   && fwrite( dir, 1, dirLen, output ) == dirLen
+                   && fwrite( p->offsets, 1, offsetsLen, output ) == offsetsLen;
+    bool ok = written;
+    for ( int i = 0; ok && i < count; i++ ) {
+        ok = packModel( p, list[ i ] );
+    }
+
+    // Go back and fill in the header and the stream offsets, which end with the file.
+    if ( ok ) {
+        putLE( p->offsets + p->streams * OFFSET_LEN, p->pos, OFFSET_LEN );
+        memcpy( header, PACKED_MAGIC, PACKED_MAGIC_LEN );
+        putLE( header + VERSION_AT, PACKED_VERSION, sizeof( uint16_t ) );
+        putLE( header + COUNT_AT, count, sizeof( uint32_t ) );
+        putLE( header + BLOCK_POINTS_AT, PACK_BLOCK, sizeof( uint32_t ) );
+        putLE( header + BLOCKS_AT, blocks, sizeof( uint64_t ) );
+        putLE( header + LENGTH_AT, p->pos, sizeof( uint64_t ) );
+        written = fseek( output, 0, SEEK_SET ) == 0
+                  && fwrite( header, 1, HEADER_LEN, output ) == HEADER_LEN
+                  && fseek( output, (long)( HEADER_LEN + dirLen ), SEEK_SET ) == 0
+                  && fwrite( p->offsets, 1, offsetsLen, output ) == offsetsLen;
+    }
+
+    // A short write sets the stream's error flag, which tells it apart from a coordinate
+    // off the grid, and the last of the data may only fail to go out when the file is closed.
+    written = written && !ferror( output );
+    if ( fclose( output ) != 0 ) {
+        written = false;
+    }
+    free( p->offsets );
+    free( p );
+    free( dir );
+
+    // Don't leave a file behind that can't be loaded.
+    if ( !written ) {
+        remove( fname );
+        return PACK_CANT_WRITE;
+    }
+    if ( !ok ) {
+        remove( fname );
+        return PACK_OUT_OF_RANGE;
+    }
+    return PACK_SAVED;
+}
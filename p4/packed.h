@@ -0,0 +1,112 @@
+/**
+    @file packed.h
+    @author Brian Morris (bcmorri3)
+
+    The packed.h header file declares functions for reading and writing the packed model
+    format, a compact form of the text format for moving Models between hosts. Every
+    coordinate is put on the grid of thousandths the text format prints, the same way
+    formatCoord rounds it, and stored as the zig-zag encoded difference from the one before
+    it, in as few bytes as it needs. A walk that moves a little at each point takes a byte
+    or two per coordinate rather than the text's ten or so, and loading it gives exactly
+    the values that loading the saved text would.
+
+    The points of each Model are split into blocks of up to PACK_BLOCK points, and each
+    block starts over from zero, so the blocks can be decoded in any order, or all at once.
+    Decoding a block reads its varints into differences, adds those up, and scales the
+    sums back down, each as a simple loop of its own.
+
+    Layout, all integers little-endian:
+
+        header     magic "P4PK", uint16 version, uint16 reserved, uint32 model count,
+                   uint32 points per block, uint64 block count, uint64 file length
+                   (32 bytes)
+        directory  per model: char name[ 24 ], uint64 point count (32 bytes each)
+        streams    uint64 offset of each block's x-coordinates then its y-coordinates, in
+                   order, then the file length, where the last stream ends
+        points     each stream's values, each a varint of 7 bits per byte, low bits first,
+                   with the high bit set on every byte but the last
+ */
+
+#ifndef _PACKED_H_
+#define _PACKED_H_
+
+#include <stdbool.h>
+#include "model.h"
+
+/** The first bytes of every packed model file. */
+#define PACKED_MAGIC "P4PK"
+
+/** Number of bytes in PACKED_MAGIC. */
+#define PACKED_MAGIC_LEN 4
+
+/** Version of the packed format written by savePacked. */
+#define PACKED_VERSION 1
+
+/** saveScene writes the packed format for file names ending with this. */
+#define PACKED_EXTENSION ".pack"
+
+/** Most points in a block, and the number savePacked puts in each but the last. */
+#define PACK_BLOCK 4096
+
+/** Return value of savePacked when the file was written. */
+#define PACK_SAVED 0
+
+/** Return value of savePacked when the file couldn't be opened. */
+#define PACK_CANT_OPEN 1
+
+/** Return value of savePacked when a coordinate is too big to put on the grid. */
+#define PACK_OUT_OF_RANGE 2
+
+/** Return value of savePacked when writing the file failed. */
+#define PACK_CANT_WRITE 3
+
+/** Return value of savePacked when there wasn't enough memory to write the file. */
+#define PACK_NO_MEMORY 4
+
+/**
+    This function reports whether the given header bytes start with PACKED_MAGIC.
+
+    @param head the first bytes of a file.
+    @param len the number of bytes in head.
+
+    @return True if the bytes are the start of a packed model file.
+ */
+bool isPacked( unsigned char const *head, int len );
+
+/**
+    This function reports whether the given output file name should get the packed format.
+
+    @param fname the name of the output file.
+
+    @return True if the name ends with PACKED_EXTENSION.
+ */
+bool hasPackedExtension( char const *fname );
+
+/**
+    This function loads a packed model file. All the Models in the file are combined, in
+    order, into one Model, as loadBinary does. Large files have their blocks decoded in
+    parallel. Nothing is printed; errors are returned in status.
+
+    @param fname the name of the input file.
+    @param arena the Arena to allocate from, or NULL to use malloc.
+    @param status set to LOAD_OK, or to the reason the file couldn't be loaded.
+
+    @return A pointer to the loaded Model, or NULL if there is an error.
+ */
+Model *loadPacked( char const *fname, Arena *arena, int *status );
+
+/**
+    This function writes the given Models to a packed model file. If a coordinate can't be
+    put on the grid, writing the file fails, or there isn't enough memory to write it, the
+    partly written file is removed.
+
+    @param list the Models to write, in order.
+    @param count the number of Models in the list.
+    @param fname the name of the output file.
+
+    @return PACK_SAVED, PACK_CANT_OPEN, PACK_OUT_OF_RANGE, PACK_CANT_WRITE or
+            PACK_NO_MEMORY.
+ */
+int savePacked( Model **list, int count, char const *fname );
+
+#endif
@@ -0,0 +1,198 @@
+/**
+    @file pipeline.c
+    @author Brian Morris (bcmorri3)
+
+    The pipeline.c program contains the transform pipeline defined in pipeline.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pipeline.h"
+
+/** Initial capacity of the queue, and of each Model's list of transforms. */
+#define INITIAL_CAP 4
+
+/**
+    The findPending function returns the entry for a Model in a list of Pending entries.
+
+    @param list the entries.
+    @param count the number of entries.
+    @param m the Model to look for.
+
+    @return The Model's entry, or NULL if it doesn't have one.
+ */
+static Pending *findPending( Pending *list, int count, Model const *m )
+{
+    for ( int i = 0; i < count; i++ ) {
+        if ( list[ i ].model == m ) {
+            return list + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+    The addPending function adds an entry for a Model to the queue. Entries past the end of
+    the queue keep their lists from earlier batches, so they are reused.
+
+    @param p the Pipeline.
+    @param m the Model.
+
+    @return The new entry.
+ */
+static Pending *addPending( Pipeline *p, Model *m )
+{
+    // Grow the queue, with empty lists for the new entries.
+    if ( p->qCount == p->qCap ) {
+        int cap = p->qCap * 2;
+        p->queue = (Pending *)realloc( p->queue, cap * sizeof( Pending ) );
+        memset( p->queue + p->qCap, 0, ( cap - p->qCap ) * sizeof( Pending ) );
+        p->qCap = cap;
+    }
+
+    Pending *e = p->queue + p->qCount++;
+    e->model = m;
+    e->count = 0;
+    return e;
+}
+
+/**
+    The runPending function is the task that applies the transforms queued for one Model.
+
+    @param arg the Pending entry.
+ */
+static void runPending( void *arg )
+{
+    Pending *e = (Pending *)arg;
+    for ( int i = 0; i < e->count; i++ ) {
+        transformModel( e->model, e->list + i );
+    }
+}
+
+/**
+    The collect function waits for the running batch, if there is one. An idle Pipeline is
+    only read, so server commands that share the Scene can sync it at the same time.
+
+    @param p the Pipeline.
+ */
+static void collect( Pipeline *p )
+{
+    if ( p->running ) {
+        waitGroup( &p->group );
+        p->running = false;
+        p->bCount = 0;
+    }
+}
+
+/**
+    The dispatch function starts the queued transforms as the new batch. The queue and the
+    batch trade places, so the lists of the finished batch become the empty queue. There
+    must not be a batch running.
+
+    @param p the Pipeline.
+ */
+static void dispatch( Pipeline *p )
+{
+    Pending *list = p->batch;
+    int cap = p->bCap;
+    p->batch = p->queue;
+    p->bCap = p->qCap;
+    p->bCount = p->qCount;
+    p->queue = list;
+    p->qCap = cap;
+    p->qCount = 0;
+    p->queued = 0;
+
+    initGroup( &p->group );
+    for ( int i = 0; i < p->bCount; i++ ) {
+        submitTask( &p->group, runPending, p->batch + i );
+    }
+    p->running = true;
+}
+
+Pipeline *makePipeline()
+{
+    Pipeline *p = (Pipeline *)malloc( sizeof( Pipeline ) );
+    p->queue = (Pending *)calloc( INITIAL_CAP, sizeof( Pending ) );
+    p->qCount = 0;
+    p->qCap = INITIAL_CAP;
+    p->batch = (Pending *)calloc( INITIAL_CAP, sizeof( Pending ) );
+    p->bCount = 0;
+    p->bCap = INITIAL_CAP;
+    p->queued = 0;
+    p->running = false;
+    return p;
+}
+
+void freePipeline( Pipeline *p )
+{
+    syncPipeline( p );
+    for ( int i = 0; i < p->qCap; i++ ) {
+        free( p->queue[ i ].list );
+    }
+    for ( int i = 0; i < p->bCap; i++ ) {
+        free( p->batch[ i ].list );
+    }
+    free( p->queue );
+    free( p->batch );
+    free( p );
+}
+
+void queueTransform( Pipeline *p, Model *m, Transform const *t )
+{
+    // Pick up a batch that has finished, so its Models don't count as busy.
+    if ( p->running && groupDone( &p->group ) ) {
+        collect( p );
+    }
+
+    // A Model with nothing outstanding is transformed right here if that's cheaper.
+    Pending *e = findPending( p->queue, p->qCount, m );
+    if ( !e && ( m->pCount < PIPELINE_POINTS || poolThreads() == 1 )
+         && !findPending( p->batch, p->bCount, m ) ) {
+        transformModel( m, t );
+        return;
+    }
+
+    // Otherwise it goes on the end of the Model's list.
+    if ( !e ) {
+        e = addPending( p, m );
+    }
+    if ( e->count == e->cap ) {
+        e->cap = e->cap ? e->cap * 2 : INITIAL_CAP;
+        e->list = (Transform *)realloc( e->list, e->cap * sizeof( Transform ) );
+    }
+    e->list[ e->count++ ] = *t;
+    p->queued++;
+
+    // Start the queue now if the pool is free, or if it has gotten too long.
+    if ( !p->running ) {
+        dispatch( p );
+    } else if ( p->queued >= PIPELINE_DEPTH ) {
+        collect( p );
+        dispatch( p );
+    }
+}
+
+void syncModel( Pipeline *p, Model const *m )
+{
+    // The running batch has to finish, if the Model is part of it.
+    if ( findPending( p->batch, p->bCount, m ) ) {
+        collect( p );
+    }
+
+    // Then anything still queued for the Model.
+    if ( findPending( p->queue, p->qCount, m ) ) {
+        collect( p );
+        dispatch( p );
+        collect( p );
+    }
+}
+
+void syncPipeline( Pipeline *p )
+{
+    collect( p );
+    if ( p->qCount > 0 ) {
+        dispatch( p );
+        collect( p );
+    }
+}
@@ -0,0 +1,118 @@
+/**
+    @file pipeline.h
+    @author Brian Morris (bcmorri3)
+
+    The pipeline.h header file declares the pipeline that lets transform commands run in
+    the background while later commands are read. Transforms are queued per Model and
+    handed to the thread pool in batches, one task per Model, so transforms of different
+    Models run at the same time while those of one Model still run in the order given.
+    Anything that reads or replaces a Model's points waits for that Model's queued work
+    first; everything that only needs names and point counts, such as listing the Scene,
+    doesn't have to wait at all.
+ */
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stdbool.h>
+#include "model.h"
+#include "pool.h"
+
+/**
+    Models with fewer points than this are transformed right away when they have no queued
+    work, since a task would cost more than the transform.
+ */
+#define PIPELINE_POINTS 16384
+
+/**
+    Most transforms queued before the pipeline waits for the running batch, which bounds how
+    far ahead of the workers the commands can get.
+ */
+#define PIPELINE_DEPTH 4096
+
+/** The transforms waiting to be applied to one Model. */
+typedef struct {
+    /** The Model to transform. */
+    Model *model;
+
+    /** The transforms, in the order they are applied. */
+    Transform *list;
+
+    /** Number of transforms in the list. */
+    int count;
+
+    /** Capacity of the list. */
+    int cap;
+} Pending;
+
+/** The pipeline of a Scene. The fields are private to pipeline.c. */
+typedef struct {
+    /** Transforms waiting for the running batch to finish, one entry per Model. */
+    Pending *queue;
+
+    /** Number of Models in the queue. */
+    int qCount;
+
+    /** Capacity of the queue. */
+    int qCap;
+
+    /** The batch of transforms the pool is working on. */
+    Pending *batch;
+
+    /** Number of Models in the batch. */
+    int bCount;
+
+    /** Capacity of the batch. */
+    int bCap;
+
+    /** Number of transforms in the queue, over all of its Models. */
+    int queued;
+
+    /** True while the batch is running. */
+    bool running;
+
+    /** The tasks of the running batch. */
+    TaskGroup group;
+} Pipeline;
+
+/**
+    This function dynamically allocates an empty Pipeline.
+
+    @return A pointer to the new Pipeline.
+ */
+Pipeline *makePipeline();
+
+/**
+    This function waits for all of the work in a Pipeline, then frees it.
+
+    @param p the Pipeline to free.
+ */
+void freePipeline( Pipeline *p );
+
+/**
+    This function arranges for a Transform to be applied to a Model, after any transforms
+    already queued for it. The Transform may be applied before the function returns, or
+    later on another thread.
+
+    @param p the Pipeline.
+    @param m the Model to transform.
+    @param t the Transform to apply.
+ */
+void queueTransform( Pipeline *p, Model *m, Transform const *t );
+
+/**
+    This function waits until every transform queued for the given Model has been applied.
+
+    @param p the Pipeline.
+    @param m the Model whose points are about to be used.
+ */
+void syncModel( Pipeline *p, Model const *m );
+
+/**
+    This function waits until every queued transform has been applied.
+
+    @param p the Pipeline.
+ */
+void syncPipeline( Pipeline *p );
+
+#endif
@@ -0,0 +1,262 @@
+/**
+    @file pool.c
+    @author Brian Morris (bcmorri3)
+
+    The pool.c program contains the thread pool defined in pool.h. Queued tasks are kept
+    in a singly linked FIFO list shared by every worker.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+/** A task waiting in the queue. */
+typedef struct TaskTag {
+    /** The function to run. */
+    void (*fn)( void *arg );
+
+    /** The argument passed to fn. */
+    void *arg;
+
+    /** The group to notify when the task finishes. */
+    TaskGroup *group;
+
+    /** The next task in the queue. */
+    struct TaskTag *next;
+} Task;
+
+/** The queue of tasks shared by all of the workers. */
+static struct {
+    /** First task in the queue. */
+    Task *head;
+
+    /** Last task in the queue. */
+    Task *tail;
+
+    /** Number of threads, counting the calling thread. */
+    int threads;
+
+    /** Protects the queue. */
+    pthread_mutex_t lock;
+
+    /** Signaled when a task is added to the queue. */
+    pthread_cond_t ready;
+} queue = { NULL, NULL, 1, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/** Makes sure the workers are only started once. */
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+
+/**
+    The takeTask function removes the first task from the queue. The queue lock must be
+    held by the caller.
+
+    @return The first task, or NULL if the queue is empty.
+ */
+static Task *takeTask()
+{
+    Task *t = queue.head;
+    if ( t ) {
+        queue.head = t->next;
+        if ( !queue.head ) {
+            queue.tail = NULL;
+        }
+    }
+    return t;
+}
+
+/**
+    The runTask function runs a task, frees it, and notifies its group.
+
+    @param t the task to run.
+ */
+static void runTask( Task *t )
+{
+    TaskGroup *g = t->group;
+    t->fn( t->arg );
+    free( t );
+
+    pthread_mutex_lock( &g->lock );
+    if ( --g->pending == 0 ) {
+        pthread_cond_broadcast( &g->done );
+    }
+    pthread_mutex_unlock( &g->lock );
+}
+
+/**
+    The worker function is the body of every worker thread; it runs tasks from the queue
+    forever.
+
+    @param arg unused.
+
+    @return Never returns.
+ */
+static void *worker( void *arg )
+{
+    while ( 1 ) {
+        pthread_mutex_lock( &queue.lock );
+        while ( !queue.head ) {
+            pthread_cond_wait( &queue.ready, &queue.lock );
+        }
+        Task *t = takeTask();
+        pthread_mutex_unlock( &queue.lock );
+        runTask( t );
+    }
+    return NULL;
+}
+
+/**
+    The startPool function decides how many threads to use and starts the workers.
+ */
+static void startPool()
+{
+    // Use the override if there is one, otherwise one thread per processor.
+    char const *env = getenv( THREADS_ENV );
+    int threads = env ? atoi( env ) : (int)sysconf( _SC_NPROCESSORS_ONLN );
+    if ( threads < 1 ) {
+        threads = 1;
+    }
+    queue.threads = threads;
+
+    // The calling thread counts as one of them.
+    for ( int i = 1; i < threads; i++ ) {
+        pthread_t id;
+        if ( pthread_create( &id, NULL, worker, NULL ) != 0 ) {
+            queue.threads = i;
+            break;
+        }
+        pthread_detach( id );
+    }
+}
+
+void initGroup( TaskGroup *g )
+{
+    g->pending = 0;
+    pthread_mutex_init( &g->lock, NULL );
+    pthread_cond_init( &g->done, NULL );
+}
+
+void waitGroup( TaskGroup *g )
+{
+    pthread_mutex_lock( &g->lock );
+    while ( g->pending > 0 ) {
+        pthread_mutex_unlock( &g->lock );
+
+        // Help with queued work rather than sleeping, so nested waits can't deadlock.
+        pthread_mutex_lock( &queue.lock );
+        Task *t = takeTask();
+        pthread_mutex_unlock( &queue.lock );
+
+        pthread_mutex_lock( &g->lock );
+        if ( t ) {
+            pthread_mutex_unlock( &g->lock );
+            runTask( t );
+            pthread_mutex_lock( &g->lock );
+        } else if ( g->pending > 0 ) {
+            // Everything left in the group is already running on another thread.
+            pthread_cond_wait( &g->done, &g->lock );
+        }
+    }
+    pthread_mutex_unlock( &g->lock );
+
+    pthread_mutex_destroy( &g->lock );
+    pthread_cond_destroy( &g->done );
+}
+
+bool groupDone( TaskGroup *g )
+{
+    pthread_mutex_lock( &g->lock );
+    bool done = g->pending == 0;
+    pthread_mutex_unlock( &g->lock );
+    return done;
+}
+
+void submitTask( TaskGroup *g, void (*fn)( void *arg ), void *arg )
+{
+    pthread_once( &started, startPool );
+
+    // Without room to queue the task, it's run now, on this thread.
+    Task *t = (Task *)malloc( sizeof( Task ) );
+    if ( !t ) {
+        fn( arg );
+        return;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->group = g;
+    t->next = NULL;
+
+    pthread_mutex_lock( &g->lock );
+    g->pending++;
+    pthread_mutex_unlock( &g->lock );
+
+    // Add it to the end of the queue and wake a worker.
+    pthread_mutex_lock( &queue.lock );
+    if ( queue.tail ) {
+        queue.tail->next = t;
+    } else {
+        queue.head = t;
+    }
+    queue.tail = t;
+    pthread_cond_signal( &queue.ready );
+    pthread_mutex_unlock( &queue.lock );
+}
+
+/** The state shared by the tasks of one parallelFor call. */
+typedef struct {
+    /** The function to call. */
+    void (*fn)( void *ctx, int i );
+
+    /** The context passed to every call. */
+    void *ctx;
+
+    /** Index of the next call to make. */
+    int next;
+
+    /** Number of calls to make. */
+    int count;
+} ForLoop;
+
+/**
+    The forTask function makes calls for a parallelFor loop, claiming one index at a time
+    until they have all been claimed.
+
+    @param arg the ForLoop.
+ */
+static void forTask( void *arg )
+{
+    ForLoop *loop = (ForLoop *)arg;
+    int i;
+    while ( ( i = __atomic_fetch_add( &loop->next, 1, __ATOMIC_RELAXED ) ) < loop->count ) {
+        loop->fn( loop->ctx, i );
+    }
+}
+
+void parallelFor( int count, void (*fn)( void *ctx, int i ), void *ctx )
+{
+    ForLoop loop = { fn, ctx, 0, count };
+
+    // One call doesn't need any help.
+    if ( count <= 1 || poolThreads() == 1 ) {
+        forTask( &loop );
+        return;
+    }
+
+    // Start a task per helper thread, then make calls on this thread too.
+    TaskGroup g;
+    initGroup( &g );
+    int helpers = poolThreads() - 1;
+    if ( helpers > count - 1 ) {
+        helpers = count - 1;
+    }
+    for ( int i = 0; i < helpers; i++ ) {
+        submitTask( &g, forTask, &loop );
+    }
+    forTask( &loop );
+    waitGroup( &g );
+}
+
+int poolThreads()
+{
+    pthread_once( &started, startPool );
+    return queue.threads;
+}
@@ -0,0 +1,86 @@
+/**
+    @file pool.h
+    @author Brian Morris (bcmorri3)
+
+    The pool.h header file declares a small pthread-based thread pool. Work is submitted as
+    tasks that belong to a TaskGroup, and a thread waiting on a group helps run queued
+    tasks instead of sleeping, so tasks may themselves submit and wait on more tasks.
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/** Environment variable that overrides the number of threads used, including the caller. */
+#define THREADS_ENV "DRAWING_THREADS"
+
+/** A set of submitted tasks that can be waited on together. */
+typedef struct {
+    /** Number of tasks submitted to the group that haven't finished. */
+    int pending;
+
+    /** Protects pending. */
+    pthread_mutex_t lock;
+
+    /** Signaled when pending drops to zero. */
+    pthread_cond_t done;
+} TaskGroup;
+
+/**
+    This function initializes an empty TaskGroup.
+
+    @param g the TaskGroup to initialize.
+ */
+void initGroup( TaskGroup *g );
+
+/**
+    This function waits until every task submitted to the given group has finished, running
+    queued tasks on the calling thread while it waits. It then releases the group's
+    resources; the group must be initialized again before reuse.
+
+    @param g the TaskGroup to wait for.
+ */
+void waitGroup( TaskGroup *g );
+
+/**
+    This function reports whether every task submitted to the given group has finished,
+    without waiting. The group still has to be passed to waitGroup afterward.
+
+    @param g the TaskGroup to check.
+
+    @return True if none of the group's tasks are queued or running.
+ */
+bool groupDone( TaskGroup *g );
+
+/**
+    This function queues a task on the shared pool. The pool is started the first time it is
+    needed, with one worker per online processor, less one for the calling thread. If there
+    isn't room to queue the task, it is run before this returns.
+
+    @param g the TaskGroup the task belongs to.
+    @param fn the function to run.
+    @param arg the argument passed to fn.
+ */
+void submitTask( TaskGroup *g, void (*fn)( void *arg ), void *arg );
+
+/**
+    This function calls fn( ctx, i ) for every i from 0 up to count, spreading the calls
+    across the pool, and returns when all of them have finished.
+
+    @param count the number of calls to make.
+    @param fn the function to call.
+    @param ctx the context passed to every call.
+ */
+void parallelFor( int count, void (*fn)( void *ctx, int i ), void *ctx );
+
+/**
+    This function returns the number of threads that can run tasks at once, counting the
+    calling thread.
+
+    @return The number of threads.
+ */
+int poolThreads();
+
+#endif
@@ -0,0 +1,120 @@
+/**
+    @file prefetch.c
+    @author Brian Morris (bcmorri3)
+
+    The prefetch.c program contains the load read-ahead defined in prefetch.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+
+/** Initial capacity of the list of loads. */
+#define INITIAL_CAP 16
+
+/**
+    The readTask function is the task that reads one Model file.
+
+    @param arg the Prefetch to read.
+ */
+static void readTask( void *arg )
+{
+    Prefetch *f = (Prefetch *)arg;
+    f->model = readModel( f->fname, f->arena, &f->status );
+}
+
+/**
+    The fill function starts reads until PREFETCH_DEPTH of them are ahead of the next load
+    to be taken, or they have all been started.
+
+    @param p the Prefetcher.
+ */
+static void fill( Prefetcher *p )
+{
+    while ( p->started < p->count && p->started - p->next < PREFETCH_DEPTH ) {
+        Prefetch *f = p->list + p->started++;
+        initGroup( &f->group );
+        submitTask( &f->group, readTask, f );
+    }
+}
+
+/**
+    The discard function waits for a read nobody is going to take, and frees its Model.
+
+    @param f the Prefetch to discard.
+ */
+static void discard( Prefetch *f )
+{
+    waitGroup( &f->group );
+    if ( f->model ) {
+        freeModel( f->model );
+    }
+}
+
+Prefetcher *makePrefetcher( Arena *arena )
+{
+    Prefetcher *p = (Prefetcher *)malloc( sizeof( Prefetcher ) );
+    p->cap = INITIAL_CAP;
+    p->list = (Prefetch *)malloc( p->cap * sizeof( Prefetch ) );
+    p->count = 0;
+    p->started = 0;
+    p->next = 0;
+    p->arena = arena;
+    return p;
+}
+
+void freePrefetcher( Prefetcher *p )
+{
+    // Reads that were started but never taken still have to finish.
+    for ( int i = p->next; i < p->started; i++ ) {
+        discard( p->list + i );
+    }
+    free( p->list );
+    free( p );
+}
+
+void addPrefetch( Prefetcher *p, int commandNum, char const *fname )
+{
+    // The list only grows before any reads start, so the tasks' pointers stay valid.
+    if ( p->count == p->cap ) {
+        p->cap *= 2;
+        p->list = (Prefetch *)realloc( p->list, p->cap * sizeof( Prefetch ) );
+    }
+
+    Prefetch *f = p->list + p->count++;
+    f->commandNum = commandNum;
+    strcpy( f->fname, fname );
+    f->arena = p->arena;
+    f->model = NULL;
+    f->status = LOAD_OK;
+}
+
+void startPrefetch( Prefetcher *p )
+{
+    fill( p );
+}
+
+bool takePrefetch( Prefetcher *p, int commandNum, char const *fname, Model **model, int *status )
+{
+    // Loads for earlier commands weren't used, those commands must have been invalid.
+    while ( p->next < p->count && p->list[ p->next ].commandNum < commandNum ) {
+        if ( p->next < p->started ) {
+            discard( p->list + p->next );
+        }
+        p->next++;
+    }
+    fill( p );
+
+    // See if this command's file was read ahead.
+    if ( p->next == p->count || p->list[ p->next ].commandNum != commandNum
+         || strcmp( p->list[ p->next ].fname, fname ) != 0 ) {
+        return false;
+    }
+
+    Prefetch *f = p->list + p->next++;
+    waitGroup( &f->group );
+    *model = f->model;
+    *status = f->status;
+    fill( p );
+    return true;
+}
@@ -0,0 +1,113 @@
+/**
+    @file prefetch.h
+    @author Brian Morris (bcmorri3)
+
+    The prefetch.h header file declares the read-ahead used for load commands in scripts.
+    The load commands of a script are registered before it runs, and their files are read
+    and parsed by the thread pool, a window of PREFETCH_DEPTH loads at a time. When a load
+    command runs, it takes the Model prepared for it, along with any error, so messages are
+    still printed when the command runs.
+ */
+
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+#include <stdbool.h>
+#include "model.h"
+#include "pool.h"
+
+/** Most loads being read ahead of the command that is running. */
+#define PREFETCH_DEPTH 32
+
+/** A Model file being read ahead for one load command. */
+typedef struct {
+    /** Number of the load command. */
+    int commandNum;
+
+    /** Name of the file to read. */
+    char fname[ NAME_LIMIT + 1 ];
+
+    /** Arena to allocate the Model from. */
+    Arena *arena;
+
+    /** The Model read from the file, or NULL if it couldn't be read. */
+    Model *model;
+
+    /** Status of the read, as given by readModel(). */
+    int status;
+
+    /** The task reading the file. */
+    TaskGroup group;
+} Prefetch;
+
+/** The loads being read ahead for a script. */
+typedef struct {
+    /** The loads, in command order. */
+    Prefetch *list;
+
+    /** Number of loads in the list. */
+    int count;
+
+    /** Capacity of the list. */
+    int cap;
+
+    /** Number of loads that have been started. */
+    int started;
+
+    /** Index of the first load that hasn't been taken or passed by. */
+    int next;
+
+    /** Arena the Models are allocated from. */
+    Arena *arena;
+} Prefetcher;
+
+/**
+    This function dynamically allocates an empty Prefetcher.
+
+    @param arena the Arena to allocate Models from.
+
+    @return A pointer to the new Prefetcher.
+ */
+Prefetcher *makePrefetcher( Arena *arena );
+
+/**
+    This function waits for any reads still running, frees the Models nobody took, and frees
+    the Prefetcher.
+
+    @param p the Prefetcher to free.
+ */
+void freePrefetcher( Prefetcher *p );
+
+/**
+    This function registers a load command to be read ahead. Commands must be added in
+    increasing order.
+
+    @param p the Prefetcher.
+    @param commandNum the number of the load command.
+    @param fname the name of the file it loads.
+ */
+void addPrefetch( Prefetcher *p, int commandNum, char const *fname );
+
+/**
+    This function starts reading the first window of registered loads.
+
+    @param p the Prefetcher.
+ */
+void startPrefetch( Prefetcher *p );
+
+/**
+    This function takes the Model read ahead for a load command, waiting for the read to
+    finish if it has to. Loads registered for earlier commands that never took their Models
+    are discarded, and more loads are started to keep the window full.
+
+    @param p the Prefetcher.
+    @param commandNum the number of the load command.
+    @param fname the name of the file the command loads.
+    @param model set to the Model, or NULL if it couldn't be read.
+    @param status set to the status of the read.
+
+    @return True if the load was read ahead, false if the caller has to read it.
+ */
+bool takePrefetch( Prefetcher *p, int commandNum, char const *fname, Model **model, int *status );
+
+#endif
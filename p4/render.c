@@ -0,0 +1,442 @@
+/**
+    @file render.c
+    @author Brian Morris (bcmorri3)
+
+    The render.c program contains the rasterizer defined in render.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "render.h"
+#include "pool.h"
+
+/** Size of the stdio buffer used for the image file. */
+#define IMAGE_BUFFER ( 1 << 20 )
+
+/** Brightest value of a color channel. */
+#define MAX_CHANNEL 255
+
+/** Number of color channels in a pixel. */
+#define CHANNELS 3
+
+/** An image being drawn, and the segments binned to its tiles. */
+typedef struct {
+    /** Width of the image. */
+    int width;
+
+    /** Height of the image. */
+    int height;
+
+    /** Number of tiles across the image. */
+    int tilesX;
+
+    /** Number of tiles down the image. */
+    int tilesY;
+
+    /** The x-coordinates of the segments' ends in pixels, two per segment. */
+    double *sx;
+
+    /** The y-coordinates of the segments' ends in pixels, counting down from the top. */
+    double *sy;
+
+    /** Where each tile's segments start in bins; the last entry is the end of the list. */
+    int *binStart;
+
+    /** The segments of every tile, tile by tile. */
+    int *bins;
+
+    /** Brightness of each pixel, row by row from the top. */
+    unsigned char *pixels;
+} Render;
+
+/** A segment ready to be drawn. */
+typedef struct {
+    /** The start of the segment, in pixels. */
+    double a[ 2 ];
+
+    /** The end of the segment, in pixels. */
+    double b[ 2 ];
+
+    /** The end minus the start. */
+    double d[ 2 ];
+
+    /** One over the squared length of the segment, or zero if it is a point. */
+    double invLen;
+
+    /** The axis the segment goes farthest along, 0 for x or 1 for y. */
+    int major;
+
+    /** How far the segment goes along the other axis per pixel along the major one. */
+    double slope;
+
+    /**
+        How far from the segment's line a pixel center can be, along the other axis, and
+        still be within one pixel of the segment.
+     */
+    double reach;
+} Stroke;
+
+/**
+    The gatherSegments function copies the segments of the Models with finite coordinates
+    into one pair of lists, and finds their bounds.
+
+    @param list the Models.
+    @param count the number of Models.
+    @param r the Render to store the segments in.
+    @param bounds set to the least x, least y, greatest x and greatest y.
+
+    @return The number of segments.
+ */
+static int gatherSegments( Model **list, int count, Render *r, double bounds[ 4 ] )
+{
+    long total = 0;
+    for ( int i = 0; i < count; i++ ) {
+        total += list[ i ]->pCount;
+    }
+    r->sx = (double *)malloc( ( total ? total : 1 ) * sizeof( double ) );
+    r->sy = (double *)malloc( ( total ? total : 1 ) * sizeof( double ) );
+
+    bounds[ 0 ] = bounds[ 1 ] = INFINITY;
+    bounds[ 2 ] = bounds[ 3 ] = -INFINITY;
+    int n = 0;
+    for ( int i = 0; i < count; i++ ) {
+        // Copy the Model's points after the ones already kept.
+        long base = 2L * n;
+        long pos = base;
+        for ( Chunk *c = list[ i ]->head; c; c = c->next ) {
+            expandPoints( c, c->xList, r->sx + pos );
+            expandPoints( c, c->yList, r->sy + pos );
+            pos += c->count;
+        }
+
+        // Then keep just the segments that can be drawn.
+        int segs = list[ i ]->pCount / 2;
+        for ( int j = 0; j < segs; j++ ) {
+            long from = base + 2L * j;
+            double ax = r->sx[ from ], ay = r->sy[ from ];
+            double bx = r->sx[ from + 1 ], by = r->sy[ from + 1 ];
+            if ( !isfinite( ax ) || !isfinite( ay ) || !isfinite( bx ) || !isfinite( by ) ) {
+                continue;
+            }
+            r->sx[ 2 * n ] = ax;
+            r->sy[ 2 * n ] = ay;
+            r->sx[ 2 * n + 1 ] = bx;
+            r->sy[ 2 * n + 1 ] = by;
+            n++;
+            bounds[ 0 ] = fmin( bounds[ 0 ], fmin( ax, bx ) );
+            bounds[ 1 ] = fmin( bounds[ 1 ], fmin( ay, by ) );
+            bounds[ 2 ] = fmax( bounds[ 2 ], fmax( ax, bx ) );
+            bounds[ 3 ] = fmax( bounds[ 3 ], fmax( ay, by ) );
+        }
+    }
+    return n;
+}
+
+/**
+    The mapSegments function scales the segments to fit the image, centered, and flips them
+    so y counts down from the top.
+
+    @param r the Render holding the segments.
+    @param n the number of segments.
+    @param bounds the bounds of the segments, as found by gatherSegments.
+ */
+static void mapSegments( Render *r, int n, double const bounds[ 4 ] )
+{
+    if ( n == 0 ) {
+        return;
+    }
+
+    // Leave a margin, unless the image is too small for one.
+    double availW = r->width > 2 * RENDER_MARGIN ? r->width - 2 * RENDER_MARGIN : r->width;
+    double availH = r->height > 2 * RENDER_MARGIN ? r->height - 2 * RENDER_MARGIN : r->height;
+
+    // Use the same scale both ways, so the drawing isn't stretched.
+    double spanX = bounds[ 2 ] - bounds[ 0 ];
+    double spanY = bounds[ 3 ] - bounds[ 1 ];
+    double k = INFINITY;
+    if ( spanX > 0 ) {
+        k = availW / spanX;
+    }
+    if ( spanY > 0 ) {
+        k = fmin( k, availH / spanY );
+    }
+    if ( isinf( k ) ) {
+        k = 1;
+    }
+
+    double cx = bounds[ 0 ] / 2 + bounds[ 2 ] / 2;
+    double cy = bounds[ 1 ] / 2 + bounds[ 3 ] / 2;
+    for ( long i = 0; i < 2L * n; i++ ) {
+        r->sx[ i ] = r->width / 2.0 + ( r->sx[ i ] - cx ) * k;
+        r->sy[ i ] = r->height / 2.0 - ( r->sy[ i ] - cy ) * k;
+    }
+}
+
+/**
+    The makeStroke function prepares a segment for drawing, working out what is used for
+    every pixel near it.
+
+    @param r the Render holding the segment.
+    @param s the segment.
+    @param st the Stroke to fill in.
+ */
+static void makeStroke( Render const *r, int s, Stroke *st )
+{
+    st->a[ 0 ] = r->sx[ 2 * s ];
+    st->a[ 1 ] = r->sy[ 2 * s ];
+    st->b[ 0 ] = r->sx[ 2 * s + 1 ];
+    st->b[ 1 ] = r->sy[ 2 * s + 1 ];
+    st->d[ 0 ] = st->b[ 0 ] - st->a[ 0 ];
+    st->d[ 1 ] = st->b[ 1 ] - st->a[ 1 ];
+
+    double len = st->d[ 0 ] * st->d[ 0 ] + st->d[ 1 ] * st->d[ 1 ];
+    st->invLen = len > 0 ? 1 / len : 0;
+
+    st->major = fabs( st->d[ 1 ] ) > fabs( st->d[ 0 ] ) ? 1 : 0;
+    st->slope = st->d[ st->major ] != 0 ? st->d[ 1 - st->major ] / st->d[ st->major ] : 0;
+    st->reach = sqrt( 1 + st->slope * st->slope );
+}
+
+/**
+    The minorAt function finds where a segment's line crosses a line across its major axis.
+
+    @param st the segment.
+    @param c the coordinate along the major axis.
+
+    @return The coordinate along the minor axis.
+ */
+static double minorAt( Stroke const *st, double c )
+{
+    return st->a[ 1 - st->major ] + ( c - st->a[ st->major ] ) * st->slope;
+}
+
+/**
+    The binSegment function finds the tiles a segment can draw into, and either counts the
+    segment in each one, or adds it to each one's bin. It follows the segment one column of
+    tiles at a time along its major axis, so long segments only visit tiles near them.
+
+    @param r the Render.
+    @param s the segment.
+    @param cursor for each tile, the count of segments, or the next free place in its bin.
+    @param fill true to add the segment to the bins, false to count it.
+ */
+static void binSegment( Render *r, int s, int *cursor, bool fill )
+{
+    Stroke st;
+    makeStroke( r, s, &st );
+    int major = st.major;
+    int minor = 1 - major;
+    int size[ 2 ] = { r->width, r->height };
+
+    // The pixels along the major axis the segment can reach.
+    int first = (int)floor( fmin( st.a[ major ], st.b[ major ] ) - 1 );
+    int last = (int)floor( fmax( st.a[ major ], st.b[ major ] ) + 1 );
+    first = first < 0 ? 0 : first;
+    last = last >= size[ major ] ? size[ major ] - 1 : last;
+
+    for ( int t = first / TILE_SIZE; first <= last && t <= last / TILE_SIZE; t++ ) {
+        // The pixels of this column of tiles the segment reaches, and how far it goes
+        // across them.
+        int lo = t * TILE_SIZE > first ? t * TILE_SIZE : first;
+        int hi = ( t + 1 ) * TILE_SIZE - 1 < last ? ( t + 1 ) * TILE_SIZE - 1 : last;
+        double v1 = minorAt( &st, lo + 0.5 );
+        double v2 = minorAt( &st, hi + 0.5 );
+        int from = (int)floor( fmin( v1, v2 ) - st.reach - 0.5 );
+        int to = (int)floor( fmax( v1, v2 ) + st.reach - 0.5 );
+        from = from < 0 ? 0 : from;
+        to = to >= size[ minor ] ? size[ minor ] - 1 : to;
+
+        for ( int u = from / TILE_SIZE; from <= to && u <= to / TILE_SIZE; u++ ) {
+            int tile = major == 0 ? u * r->tilesX + t : t * r->tilesX + u;
+            if ( fill ) {
+                r->bins[ cursor[ tile ]++ ] = s;
+            } else {
+                cursor[ tile ]++;
+            }
+        }
+    }
+}
+
+/**
+    The binSegments function sorts the segments into the bins of the tiles they reach.
+
+    @param r the Render.
+    @param n the number of segments.
+ */
+static void binSegments( Render *r, int n )
+{
+    int tiles = r->tilesX * r->tilesY;
+    int *cursor = (int *)calloc( tiles, sizeof( int ) );
+
+    // Count the segments of each tile, then lay out the bins one after another.
+    for ( int s = 0; s < n; s++ ) {
+        binSegment( r, s, cursor, false );
+    }
+    r->binStart = (int *)malloc( ( tiles + 1 ) * sizeof( int ) );
+    r->binStart[ 0 ] = 0;
+    for ( int t = 0; t < tiles; t++ ) {
+        r->binStart[ t + 1 ] = r->binStart[ t ] + cursor[ t ];
+        cursor[ t ] = r->binStart[ t ];
+    }
+
+    // Then fill them.
+    r->bins = (int *)malloc( ( r->binStart[ tiles ] ? r->binStart[ tiles ] : 1 ) * sizeof( int ) );
+    for ( int s = 0; s < n; s++ ) {
+        binSegment( r, s, cursor, true );
+    }
+    free( cursor );
+}
+
+/**
+    The segmentDistance function returns the squared distance from a point to a segment.
+
+    @param st the segment.
+    @param x the x-coordinate of the point.
+    @param y the y-coordinate of the point.
+
+    @return The squared distance.
+ */
+static double segmentDistance( Stroke const *st, double x, double y )
+{
+    // Project the point onto the segment, clamped to its ends.
+    double t = ( ( x - st->a[ 0 ] ) * st->d[ 0 ] + ( y - st->a[ 1 ] ) * st->d[ 1 ] ) * st->invLen;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+
+    double ex = st->a[ 0 ] + t * st->d[ 0 ] - x;
+    double ey = st->a[ 1 ] + t * st->d[ 1 ] - y;
+    return ex * ex + ey * ey;
+}
+
+/**
+    The drawSegment function draws a segment into a tile. Each pixel whose center is within
+    a pixel of the segment is covered by one minus that distance.
+
+    @param st the segment.
+    @param lo the first pixel of the tile along x and y.
+    @param hi one past the last pixel of the tile along x and y.
+    @param cover the coverage of the tile's pixels, row by row.
+ */
+static void drawSegment( Stroke const *st, int const lo[ 2 ], int const hi[ 2 ], float *cover )
+{
+    int major = st->major;
+    int minor = 1 - major;
+
+    // Step along the major axis, one pixel at a time.
+    int first = (int)floor( fmin( st->a[ major ], st->b[ major ] ) - 1 );
+    int last = (int)floor( fmax( st->a[ major ], st->b[ major ] ) + 1 );
+    first = first < lo[ major ] ? lo[ major ] : first;
+    last = last >= hi[ major ] ? hi[ major ] - 1 : last;
+
+    for ( int i = first; i <= last; i++ ) {
+        // The pixels across the line near this step.
+        double v = minorAt( st, i + 0.5 );
+        int from = (int)floor( v - st->reach - 0.5 );
+        int to = (int)floor( v + st->reach - 0.5 );
+        from = from < lo[ minor ] ? lo[ minor ] : from;
+        to = to >= hi[ minor ] ? hi[ minor ] - 1 : to;
+
+        for ( int j = from; j <= to; j++ ) {
+            int px = major == 0 ? i : j;
+            int py = major == 0 ? j : i;
+            double d = segmentDistance( st, px + 0.5, py + 0.5 );
+            if ( d >= 1 ) {
+                continue;
+            }
+            float c = (float)( 1 - sqrt( d ) );
+            float *dest = cover + ( py - lo[ 1 ] ) * TILE_SIZE + ( px - lo[ 0 ] );
+            if ( c > *dest ) {
+                *dest = c;
+            }
+        }
+    }
+}
+
+/**
+    The renderTile function is run by parallelFor to draw one tile of the image.
+
+    @param ctx the Render.
+    @param t the index of the tile, counting across each row of tiles.
+ */
+static void renderTile( void *ctx, int t )
+{
+    Render *r = (Render *)ctx;
+    int lo[ 2 ] = { t % r->tilesX * TILE_SIZE, t / r->tilesX * TILE_SIZE };
+    int hi[ 2 ] = { lo[ 0 ] + TILE_SIZE < r->width ? lo[ 0 ] + TILE_SIZE : r->width,
+                    lo[ 1 ] + TILE_SIZE < r->height ? lo[ 1 ] + TILE_SIZE : r->height };
+
+    // Draw the tile's segments.
+    float cover[ TILE_SIZE * TILE_SIZE ] = { 0 };
+    for ( int i = r->binStart[ t ]; i < r->binStart[ t + 1 ]; i++ ) {
+        Stroke st;
+        makeStroke( r, r->bins[ i ], &st );
+        drawSegment( &st, lo, hi, cover );
+    }
+
+    // Then store its pixels, dark where they are covered.
+    for ( int y = lo[ 1 ]; y < hi[ 1 ]; y++ ) {
+        for ( int x = lo[ 0 ]; x < hi[ 0 ]; x++ ) {
+            float c = cover[ ( y - lo[ 1 ] ) * TILE_SIZE + ( x - lo[ 0 ] ) ];
+            r->pixels[ (long)y * r->width + x ] = MAX_CHANNEL - (int)( c * MAX_CHANNEL + 0.5f );
+        }
+    }
+}
+
+/**
+    The writeImage function writes the pixels of an image as a binary PPM file.
+
+    @param r the Render holding the pixels.
+    @param output the file to write to.
+ */
+static void writeImage( Render const *r, FILE *output )
+{
+    fprintf( output, "P6\n%d %d\n%d\n", r->width, r->height, MAX_CHANNEL );
+
+    // Every channel of a pixel gets the same value.
+    unsigned char *row = (unsigned char *)malloc( (long)r->width * CHANNELS );
+    for ( int y = 0; y < r->height; y++ ) {
+        unsigned char const *src = r->pixels + (long)y * r->width;
+        for ( int x = 0; x < r->width; x++ ) {
+            memset( row + x * CHANNELS, src[ x ], CHANNELS );
+        }
+        fwrite( row, CHANNELS, r->width, output );
+    }
+    free( row );
+}
+
+bool renderModels( Model **list, int count, char const *fname, int width, int height )
+{
+    // Open the image file first, so nothing is drawn if it can't be written.
+    FILE *output = fopen( fname, "wb" );
+    if ( !output ) {
+        return false;
+    }
+    setvbuf( output, NULL, _IOFBF, IMAGE_BUFFER );
+
+    Render r;
+    r.width = width;
+    r.height = height;
+    r.tilesX = ( width + TILE_SIZE - 1 ) / TILE_SIZE;
+    r.tilesY = ( height + TILE_SIZE - 1 ) / TILE_SIZE;
+
+    // Put the segments in pixel coordinates, and find the tiles each one reaches.
+    double bounds[ 4 ];
+    int n = gatherSegments( list, count, &r, bounds );
+    mapSegments( &r, n, bounds );
+    binSegments( &r, n );
+
+    // Draw the tiles in parallel.
+    r.pixels = (unsigned char *)malloc( (long)width * height );
+    parallelFor( r.tilesX * r.tilesY, renderTile, &r );
+
+    writeImage( &r, output );
+    fclose( output );
+
+    free( r.pixels );
+    free( r.bins );
+    free( r.binStart );
+    free( r.sx );
+    free( r.sy );
+    return true;
+}
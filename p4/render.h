@@ -0,0 +1,45 @@
+/**
+    @file render.h
+    @author Brian Morris (bcmorri3)
+
+    The render.h header file declares the rasterizer that draws the segments of a list of
+    Models into a binary PPM image. The Models are scaled uniformly to fit the image, with
+    a small margin, and drawn as anti-aliased black lines one pixel wide on white.
+
+    The image is split into square tiles. The segments are binned to the tiles they reach
+    before any drawing starts, then the tiles are drawn in parallel, each looking only at
+    its own segments and writing only its own pixels. A pixel's darkness is the largest
+    coverage of any segment near it, so the image is the same however the tiles are spread
+    across threads.
+ */
+
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include <stdbool.h>
+#include "model.h"
+
+/** Width and height of a tile, in pixels. */
+#define TILE_SIZE 64
+
+/** Largest width or height of an image. */
+#define MAX_IMAGE_SIZE 8192
+
+/** Pixels left blank around the drawing on each side, when the image is big enough. */
+#define RENDER_MARGIN 2
+
+/**
+    This function draws the segments of a list of Models into a PPM file. Segments with
+    coordinates that aren't finite are skipped.
+
+    @param list the Models to draw.
+    @param count the number of Models.
+    @param fname the name of the file to write.
+    @param width the width of the image, from 1 to MAX_IMAGE_SIZE.
+    @param height the height of the image, from 1 to MAX_IMAGE_SIZE.
+
+    @return True if the file was written, false if it couldn't be opened.
+ */
+bool renderModels( Model **list, int count, char const *fname, int width, int height );
+
+#endif
@@ -9,8 +9,97 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+#include <fnmatch.h>
 #include "scene.h"
 #include "model.h"
+#include "format.h"
+#include "pool.h"
+#include "binary.h"
+#include "packed.h"
+#include "spatial.h"
+#include "render.h"
+#include "intersect.h"
+#include "spill.h"
+#include "output.h"
+
+/** saveScene formats Models in batches of about this many points, to bound memory use. */
+#define SAVE_BATCH_POINTS ( 1 << 20 )
+
+/** Size of the stdio buffer used for the output file. */
+#define WRITE_BUFFER ( 1 << 20 )
+
+/** The characters that make a name an fnmatch pattern. */
+#define PATTERN_CHARS "*?["
+
+/**
+    A batch of Models being saved by saveScene. The ones changed since they were last
+    saved are formatted in parallel, the rest reuse their saved text.
+ */
+typedef struct {
+    /** The Models in the batch. */
+    Model **models;
+
+    /** The text of each Model, in the same order. */
+    TextBuffer *texts;
+
+    /** True for each Model that had no saved text when the batch was made. */
+    bool *dirty;
+
+    /** Set if there wasn't room for the text of some Model. */
+    int failed;
+} SaveBatch;
+
+/**
+    The formatBatchModel function is run by parallelFor to format one Model of a batch.
+
+    @param ctx the SaveBatch.
+    @param i the index of the Model in the batch.
+ */
+static void formatBatchModel( void *ctx, int i )
+{
+    SaveBatch *batch = (SaveBatch *)ctx;
+    if ( batch->dirty[ i ] && !formatModel( batch->models[ i ], batch->texts + i ) ) {
+        __atomic_store_n( &batch->failed, 1, __ATOMIC_RELAXED );
+    }
+}
+
+/**
+    The streamModel function writes the text of a Model whose points are spilled, a block
+    of points at a time, letting go of each block once it's written. The Model's text is
+    never all in memory at once, and isn't kept for the next save.
+
+    @param m the Model.
+    @param output the output file.
+
+    @return True, or false if there wasn't room to format a block.
+ */
+static bool streamModel( Model const *m, FILE *output )
+{
+    TextBuffer text;
+    initText( &text );
+    for ( Chunk const *c = m->head; c; c = c->next ) {
+        for ( int start = 0; start < c->count; start += SPILL_BLOCK ) {
+            int end = c->count - start < SPILL_BLOCK ? c->count : start + SPILL_BLOCK;
+            if ( !formatPoints( c, start, end, &text ) ) {
+                freeText( &text );
+                return false;
+            }
+            fwrite( text.data, 1, text.len, output );
+            text.len = 0;
+
+            // An indexed Chunk's points are used out of order, so they go when it's done.
+            if ( !c->idx ) {
+                releasePoints( c, start, end - start );
+            }
+        }
+        if ( c->idx ) {
+            releasePoints( c, 0, c->vCount );
+        }
+    }
+    freeText( &text );
+    return true;
+}
 
 Scene *makeScene()
 {
@@ -19,34 +108,336 @@ Scene *makeScene()
     s->mCount = 0;
     s->mCap = RESIZE;
     s->mList = (Model **)malloc( s->mCap * sizeof( Model * ) );
+    s->listRefs = NULL;
+    s->arena = makeArena();
+    s->pipeline = makePipeline();
+    s->prefetch = NULL;
+    s->stats = makeStats();
+    s->gCount = 0;
+    s->gCap = 0;
+    s->gList = NULL;
+    s->cCount = 0;
+    s->cCap = 0;
+    s->cList = NULL;
+    s->box = emptyBox();
+    s->boxValid = true;
+    pthread_mutex_init( &s->cacheLock, NULL );
     return s;
 }
 
-void freeScene( Scene *s )
+/**
+    The findGroup function returns the group with the given name.
+
+    @param s the Scene.
+    @param gname the name of the group.
+
+    @return The group, or NULL if there isn't one with the name.
+ */
+static Group *findGroup( Scene *s, char const *gname )
+{
+    for ( int i = 0; i < s->gCount; i++ ) {
+        if ( strcmp( gname, s->gList[ i ].name ) == 0 ) {
+            return s->gList + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+    The selectModels function finds every Model a name stands for: the Model with that
+    name, or else the members of the group with that name, or else, if the name is an
+    fnmatch pattern, the Models whose names match it. Each Model is listed once, in the
+    order of the Scene's list.
+
+    @param s the Scene.
+    @param name the name of a Model or group, or a pattern.
+    @param list set to a dynamically allocated list of the Models, or NULL if there are
+                none.
+
+    @return The number of Models found.
+ */
+static int selectModels( Scene *s, char const *name, Model ***list )
 {
-    // Free any dynamically allocated Models.
+    *list = NULL;
+    Group *g = NULL;
+    bool exact = containsModel( s, name );
+    if ( !exact ) {
+        g = findGroup( s, name );
+        if ( !g && !strpbrk( name, PATTERN_CHARS ) ) {
+            return 0;
+        }
+    }
+
+    // Test every Model once, so ones a group matches more than once are still listed once.
+    int count = 0;
     for ( int i = 0; i < s->mCount; i++ ) {
-        freeModel( s->mList[i] );
+        char const *mname = s->mList[ i ]->name;
+        bool match;
+        if ( exact ) {
+            match = strcmp( name, mname ) == 0;
+        } else if ( g ) {
+            match = false;
+            for ( int j = 0; j < g->count && !match; j++ ) {
+                match = fnmatch( g->members[ j ], mname, 0 ) == 0;
+            }
+        } else {
+            match = fnmatch( name, mname, 0 ) == 0;
+        }
+
+        if ( match ) {
+            if ( !*list ) {
+                *list = (Model **)malloc( ( exact ? 1 : s->mCount - i ) * sizeof( Model * ) );
+            }
+            ( *list )[ count++ ] = s->mList[ i ];
+
+            // Names are unique, so nothing else can match exactly.
+            if ( exact ) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+    The ownList function gives the Scene a Model list of its own, if it shares one with
+    checkpoints, so the list can be changed. The Models in it are then held by one more
+    list.
+
+    @param s the Scene.
+ */
+static void ownList( Scene *s )
+{
+    if ( !s->listRefs ) {
+        return;
+    }
+
+    // The checkpoints that shared the list may be gone, leaving it to the Scene.
+    if ( --*s->listRefs == 0 ) {
+        free( s->listRefs );
+    } else {
+        Model **list = (Model **)malloc( s->mCap * sizeof( Model * ) );
+        memcpy( list, s->mList, s->mCount * sizeof( Model * ) );
+        for ( int i = 0; i < s->mCount; i++ ) {
+            list[ i ]->refs++;
+        }
+        s->mList = list;
+    }
+    s->listRefs = NULL;
+}
+
+/**
+    The ownModel function makes the Model at the given position in the Scene's list safe to
+    change, replacing it with a clone if a checkpoint holds it too.
+
+    @param s the Scene.
+    @param i the position of the Model.
+
+    @return The Model now at that position, or NULL if there was no room for the clone, in
+            which case the Model is left where it was.
+ */
+static Model *ownModel( Scene *s, int i )
+{
+    ownList( s );
+    Model *m = s->mList[ i ];
+    if ( m->refs > 1 ) {
+        syncModel( s->pipeline, m );
+        Model *clone = cloneModel( m );
+        if ( !clone ) {
+            return NULL;
+        }
+        s->mList[ i ] = clone;
+        m->refs--;
     }
-    // Free the Model list.
-    free( s->mList );
+    return s->mList[ i ];
+}
+
+/**
+    The ownModels function makes each Model in a list from selectModels() safe to
+    transform. Each is made safe to change, as ownModel() does, updating the list with any
+    clones, and then gets its own copy of any points it shares, once its queued transforms
+    are done.
+
+    @param s the Scene.
+    @param list the Models, in the order of the Scene's list.
+    @param count the number of Models.
+
+    @return True, or false if there was no room for a clone or a copy. The Scene still has
+            the same points either way.
+ */
+static bool ownModels( Scene *s, Model **list, int count )
+{
+    // Both lists are in the same order, so one pass finds every Model.
+    int j = 0;
+    for ( int i = 0; i < s->mCount && j < count; i++ ) {
+        if ( s->mList[ i ] == list[ j ] ) {
+            Model *m = ownModel( s, i );
+            if ( !m ) {
+                return false;
+            }
+            list[ j++ ] = m;
+
+            // Shared points are copied here, where running out of room can be reported,
+            // rather than on a thread running the transform.
+            if ( sharesPoints( m ) ) {
+                syncModel( s->pipeline, m );
+                if ( !ownPoints( m ) ) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+    The dropList function lets go of a Model list held by the Scene or a checkpoint. Once
+    nothing holds the list, it is freed, along with each Model nothing else holds.
+
+    @param s the Scene.
+    @param list the Models.
+    @param count the number of Models.
+    @param listRefs the holders of the list, or NULL if there is only one.
+    @param teardown true if the Scene's Arena is about to be freed, so Models from it only
+                    need what the Arena doesn't hold released.
+ */
+static void dropList( Scene *s, Model **list, int count, int *listRefs, bool teardown )
+{
+    if ( listRefs && --*listRefs > 0 ) {
+        return;
+    }
+    free( listRefs );
+
+    for ( int i = 0; i < count; i++ ) {
+        Model *m = list[ i ];
+        if ( --m->refs > 0 ) {
+            continue;
+        }
+        if ( teardown && m->arena == s->arena ) {
+            releaseMappings( m );
+            dropIndex( m );
+            dropSaved( m );
+        } else {
+            freeModel( m );
+        }
+    }
+    free( list );
+}
+
+/**
+    The findCheckpoint function returns the checkpoint with the given name.
+
+    @param s the Scene.
+    @param name the name of the checkpoint.
+
+    @return The checkpoint, or NULL if there isn't one with the name.
+ */
+static Checkpoint *findCheckpoint( Scene *s, char const *name )
+{
+    for ( int i = 0; i < s->cCount; i++ ) {
+        if ( strcmp( name, s->cList[ i ].name ) == 0 ) {
+            return s->cList + i;
+        }
+    }
+    return NULL;
+}
+
+void freeScene( Scene *s )
+{
+    // Let any transforms and reads still running finish.
+    freePipeline( s->pipeline );
+    if ( s->prefetch ) {
+        freePrefetcher( s->prefetch );
+    }
+
+    // Write out the statistics while the Arena can still report on itself.
+    dumpStats( s->stats, s->arena );
+    freeStats( s->stats );
+
+    // Models from the arena only need their file mappings, indexes and saved text released
+    // one at a time, the arena frees everything else in bulk. Each Model is released once,
+    // by the last list holding it.
+    for ( int i = 0; i < s->cCount; i++ ) {
+        Checkpoint *cp = s->cList + i;
+        dropList( s, cp->mList, cp->mCount, cp->listRefs, true );
+    }
+    dropList( s, s->mList, s->mCount, s->listRefs, true );
+    freeArena( s->arena );
+
+    // Free the checkpoints and the groups.
+    pthread_mutex_destroy( &s->cacheLock );
+    free( s->cList );
+    for ( int i = 0; i < s->gCount; i++ ) {
+        free( s->gList[ i ].members );
+    }
+    free( s->gList );
     // Free the Scene.
     free( s );
 }
 
-bool applyToScene(Scene *s, char const *name, void (*f)(double pt[NUM_COORDS], double a, double b),
-                  double a, double b)
+bool transformScene( Scene *s, char const *name, Transform const *t )
 {
-    // Find the Model with the given name and apply the function to it.
-    for ( int i = 0; i < s->mCount; i++ ) {
-        if ( strcmp( name, s->mList[ i ]->name ) == 0 ) {
-            applyToModel( s->mList[ i ], f, a, b );
-            // If applied, return true.
-            return true;
+    Model **list;
+    int count = selectModels( s, name, &list );
+    if ( count == 0 ) {
+        return false;
+    }
+
+    // Models a checkpoint holds are cloned, so it keeps the originals. If that runs out of
+    // room, nothing has moved yet.
+    if ( !ownModels( s, list, count ) ) {
+        reportNoMemory( name );
+        free( list );
+        return true;
+    }
+
+    // The boxes move now, so they can be read without waiting for the points.
+    for ( int i = 0; i < count; i++ ) {
+        transformBox( &list[ i ]->box, t );
+    }
+    s->boxValid = false;
+
+    // A single Model gets the transform queued. There's no need to wait for the Model's
+    // earlier transforms, this one goes after them.
+    if ( count == 1 ) {
+        queueTransform( s->pipeline, list[ 0 ], t );
+        countPoints( s->stats, list[ 0 ]->pCount );
+        free( list );
+        return true;
+    }
+
+    // Several Models are transformed in one pass, once their earlier transforms are done.
+    for ( int i = 0; i < count; i++ ) {
+        syncModel( s->pipeline, list[ i ] );
+        countPoints( s->stats, list[ i ]->pCount );
+    }
+    transformModels( list, count, t );
+    free( list );
+    return true;
+}
+
+void addToGroup( Scene *s, char const *gname, char const *member )
+{
+    // Define the group if it's new, doubling the capacity of the list when it's full.
+    Group *g = findGroup( s, gname );
+    if ( !g ) {
+        if ( s->gCount == s->gCap ) {
+            s->gCap = s->gCap ? s->gCap * RESIZE : RESIZE;
+            s->gList = (Group *)realloc( s->gList, s->gCap * sizeof( Group ) );
         }
+        g = s->gList + s->gCount++;
+        strcpy( g->name, gname );
+        g->count = 0;
+        g->cap = RESIZE;
+        g->members = malloc( g->cap * sizeof( *g->members ) );
     }
-    // No match, return false.
-    return false;
+
+    // Add the member.
+    if ( g->count == g->cap ) {
+        g->cap *= RESIZE;
+        g->members = realloc( g->members, g->cap * sizeof( *g->members ) );
+    }
+    strcpy( g->members[ g->count++ ], member );
 }
 
 bool containsModel( Scene *s, char const *mname )
@@ -61,54 +452,219 @@ bool containsModel( Scene *s, char const *mname )
     return false;
 }
 
-void addModel( Scene *s, char const *fname, char const *mname )
+void addModel( Scene *s, char const *fname, char const *mname, int commandNum )
 {
+    // A list shared with checkpoints is copied first.
+    ownList( s );
+
     // If the Model array is full, reallocate the memory to an array that's 2 times bigger.
     if ( s->mCount == s->mCap ) {
         s->mCap *= RESIZE;
         s->mList = (Model **)realloc( s->mList, s->mCap * sizeof( Model * ) );
     }
 
-    // Load the Model.
-    Model *m = loadModel( fname );
+    // Load the Model, unless it was read ahead.
+    Model *m;
+    int status;
+    if ( !s->prefetch || !takePrefetch( s->prefetch, commandNum, fname, &m, &status ) ) {
+        m = readModel( fname, s->arena, &status );
+    }
     // If it's not NULL, add it to the list.
-    if ( m ) {
+    if ( !m ) {
+        reportLoadError( fname, status );
+    } else {
         strcpy( m->name, mname );
         s->mList[ s->mCount ] = m;
         s->mCount++;
+        addBox( &s->box, &m->box );
+        countPoints( s->stats, m->pCount );
+        countFile( s->stats, fname );
     }
 }
 
 void saveScene( Scene *s, char const *fname )
 {
+    // Every Model has to be up to date.
+    syncPipeline( s->pipeline );
+
+    // Binary files are written by their own module.
+    if ( hasBinaryExtension( fname ) ) {
+        sortModels( s );
+        int result = saveBinary( s->mList, s->mCount, fname );
+        if ( result == BINARY_CANT_OPEN ) {
+            fprintf( errStream(), "Can't open file: %s\n", fname );
+            return;
+        }
+        if ( result == BINARY_CANT_WRITE ) {
+            fprintf( errStream(), "Can't write file: %s\n", fname );
+            return;
+        }
+        if ( result == BINARY_NO_MEMORY ) {
+            fprintf( errStream(), "Not enough memory for file: %s\n", fname );
+            return;
+        }
+        for ( int i = 0; i < s->mCount; i++ ) {
+            countPoints( s->stats, s->mList[ i ]->pCount );
+        }
+        countFile( s->stats, fname );
+        return;
+    }
+
+    // So are packed files.
+    if ( hasPackedExtension( fname ) ) {
+        sortModels( s );
+        int result = savePacked( s->mList, s->mCount, fname );
+        if ( result == PACK_CANT_OPEN ) {
+            fprintf( errStream(), "Can't open file: %s\n", fname );
+            return;
+        }
+        if ( result == PACK_CANT_WRITE ) {
+            fprintf( errStream(), "Can't write file: %s\n", fname );
+            return;
+        }
+        if ( result == PACK_NO_MEMORY ) {
+            fprintf( errStream(), "Not enough memory for file: %s\n", fname );
+            return;
+        }
+        if ( result == PACK_OUT_OF_RANGE ) {
+            fprintf( errStream(), "Coordinates too large to pack: %s\n", fname );
+            return;
+        }
+        for ( int i = 0; i < s->mCount; i++ ) {
+            countPoints( s->stats, s->mList[ i ]->pCount );
+        }
+        countFile( s->stats, fname );
+        return;
+    }
+
     // Open the output file.
     FILE *output = fopen( fname, "w" );
     if ( !output ) {
-        fprintf( stderr, "Can't open file: %s\n", fname );
+        fprintf( errStream(), "Can't open file: %s\n", fname );
         return;
     }
 
+    // Write in large blocks.
+    setvbuf( output, NULL, _IOFBF, WRITE_BUFFER );
+
     // Sort the models.
     sortModels( s );
 
-    // Print the line segments of each Model.
-    for ( int i = 0; i < s->mCount; i++ ) {
-        Model *m = s->mList[ i ];
-        for (int j = 0; j < m->pCount; j++ ) {
-            fprintf( output, "%.3lf %.3lf\n", m->pList[ j ][ 0 ], m->pList[ j ][ 1 ] );
-            if ( j % 2 == 1 ) {
-                fprintf( output, "\n" );
+    // Format the line segments of each Model, a batch at a time. The Models of a batch are
+    // formatted in parallel, then written in order. Models that haven't changed since the
+    // last save write the text they saved then, and don't count toward the batch. Running
+    // out of room for the text stops the save.
+    bool room = true;
+    int start = 0;
+    while ( room && start < s->mCount ) {
+        // Spilled Models are written on their own, a block at a time.
+        if ( modelSpilled( s->mList[ start ] ) ) {
+            countPoints( s->stats, s->mList[ start ]->pCount );
+            room = streamModel( s->mList[ start ], output );
+            start++;
+            continue;
+        }
+
+        // Add Models to the batch until it has enough to format. Another save may be
+        // storing text at the same time, so which ones need it is settled under the lock.
+        pthread_mutex_lock( &s->cacheLock );
+        int end = start;
+        long points = 0;
+        while ( end < s->mCount && points < SAVE_BATCH_POINTS
+                && !modelSpilled( s->mList[ end ] ) ) {
+            if ( !s->mList[ end ]->saved ) {
+                points += s->mList[ end ]->pCount;
+                countPoints( s->stats, s->mList[ end ]->pCount );
+            }
+            end++;
+        }
+        bool *dirty = (bool *)malloc( ( end - start ) * sizeof( bool ) );
+        for ( int i = 0; dirty && i < end - start; i++ ) {
+            dirty[ i ] = !s->mList[ start + i ]->saved;
+        }
+        pthread_mutex_unlock( &s->cacheLock );
+
+        TextBuffer *texts = dirty ? (TextBuffer *)malloc( ( end - start ) * sizeof( TextBuffer ) )
+                                  : NULL;
+        if ( !texts ) {
+            free( dirty );
+            room = false;
+            break;
+        }
+        for ( int i = 0; i < end - start; i++ ) {
+            initText( texts + i );
+        }
+
+        SaveBatch batch = { s->mList + start, texts, dirty, 0 };
+        if ( points < PARALLEL_POINTS ) {
+            for ( int i = 0; i < end - start; i++ ) {
+                formatBatchModel( &batch, i );
             }
+        } else {
+            parallelFor( end - start, formatBatchModel, &batch );
         }
+
+        // None of the text is kept if some of it couldn't be made.
+        if ( batch.failed ) {
+            for ( int i = 0; i < end - start; i++ ) {
+                freeText( texts + i );
+            }
+            free( dirty );
+            free( texts );
+            room = false;
+            break;
+        }
+
+        // Keep the new text for the next save, unless another save got there first with the
+        // same text, then write each Model's text.
+        pthread_mutex_lock( &s->cacheLock );
+        for ( int i = 0; i < end - start; i++ ) {
+            Model *m = s->mList[ start + i ];
+            if ( dirty[ i ] && !m->saved ) {
+                m->saved = texts[ i ].data;
+                m->savedLen = texts[ i ].len;
+            } else {
+                freeText( texts + i );
+            }
+        }
+        pthread_mutex_unlock( &s->cacheLock );
+        for ( int i = start; i < end; i++ ) {
+            fwrite( s->mList[ i ]->saved, 1, s->mList[ i ]->savedLen, output );
+        }
+        free( dirty );
+        free( texts );
+        start = end;
     }
-    // Close output file.
+
+    // Close output file. Without room to format all of it, the partial file is removed.
     fclose( output );
+    if ( !room ) {
+        remove( fname );
+        fprintf( errStream(), "Not enough memory for file: %s\n", fname );
+        return;
+    }
+    countFile( s->stats, fname );
+}
+
+void renderScene( Scene *s, char const *fname, int width, int height )
+{
+    // Every Model has to be up to date.
+    syncPipeline( s->pipeline );
+
+    if ( !renderModels( s->mList, s->mCount, fname, width, height ) ) {
+        fprintf( errStream(), "Can't open file: %s\n", fname );
+        return;
+    }
+    for ( int i = 0; i < s->mCount; i++ ) {
+        countPoints( s->stats, s->mList[ i ]->pCount );
+    }
+    countFile( s->stats, fname );
 }
 
 void removeModel( Scene *s, char const *mname )
 {
     // Find the matching Model.
-    int modelIndex;
+    int modelIndex = -1;
     for ( int i = 0; i < s->mCount; i++ ) {
         if ( strcmp( mname, s->mList[ i ]->name ) == 0 ) {
             modelIndex = i;
@@ -116,14 +672,59 @@ void removeModel( Scene *s, char const *mname )
         }
     }
 
-    // Free the matching Model.
-    freeModel( s->mList[ modelIndex ] );
+    // Nothing to remove, this happens when a Model is merged with itself.
+    if ( modelIndex < 0 ) {
+        return;
+    }
+
+    // Free the matching Model, once nothing is transforming it, unless a checkpoint still
+    // holds it.
+    ownList( s );
+    Model *m = s->mList[ modelIndex ];
+    syncModel( s->pipeline, m );
+    if ( --m->refs == 0 ) {
+        freeModel( m );
+    }
     for ( int i = modelIndex; i < s->mCount - 1; i++ ){
         s->mList[ i ] = s->mList[ i + 1 ];
     }
 
-    // Decrease the number of Models.
+    // Decrease the number of Models, which may shrink the Scene's box.
     s->mCount--;
+    s->boxValid = false;
+}
+
+bool boundsScene( Scene *s, char const *name )
+{
+    Box b;
+    if ( name ) {
+        // Cover each Model the name stands for.
+        Model **list;
+        int count = selectModels( s, name, &list );
+        b = emptyBox();
+        for ( int i = 0; i < count; i++ ) {
+            addBox( &b, &list[ i ]->box );
+        }
+        free( list );
+    } else {
+        // The Scene's box only needs rebuilding after something could have shrunk it.
+        pthread_mutex_lock( &s->cacheLock );
+        if ( !s->boxValid ) {
+            s->box = emptyBox();
+            for ( int i = 0; i < s->mCount; i++ ) {
+                addBox( &s->box, &s->mList[ i ]->box );
+            }
+            s->boxValid = true;
+        }
+        b = s->box;
+        pthread_mutex_unlock( &s->cacheLock );
+    }
+
+    if ( b.minX > b.maxX ) {
+        return false;
+    }
+    fprintf( outStream(), "%.3f %.3f %.3f %.3f\n", b.minX, b.minY, b.maxX, b.maxY );
+    return true;
 }
 
 void list( Scene *s )
@@ -134,44 +735,207 @@ void list( Scene *s )
     // List the information.
     for ( int i = 0; i < s->mCount; i++ ) {
         Model *m = s->mList[ i ];
-        printf( "%s %s (%d)\n", m->name, m->fname, m->pCount / 2 );
+        fprintf( outStream(), "%s %s (%d)\n", m->name, m->fname, m->pCount / 2 );
     }
 }
 
-void sortModels( Scene *s )
+/**
+    The compareHits function orders the hits of a query by segment number, for qsort.
+
+    @param a the first SegmentHit.
+    @param b the second SegmentHit.
+
+    @return Negative, zero or positive as a comes before, with or after b.
+ */
+static int compareHits( void const *a, void const *b )
+{
+    return ( (SegmentHit const *)a )->id - ( (SegmentHit const *)b )->id;
+}
+
+/**
+    The modelIndex function returns a Model's spatial index, building it if it has to.
+
+    @param s the Scene, to count the points of an index that is built.
+    @param m the Model, which must have at least one segment.
+
+    @return The index.
+ */
+static SpatialIndex *modelIndex( Scene *s, Model *m )
+{
+    // Server commands running at the same time may both need it.
+    pthread_mutex_lock( &s->cacheLock );
+    if ( !m->index ) {
+        m->index = buildIndex( m );
+        countPoints( s->stats, m->pCount );
+    }
+    SpatialIndex *ix = m->index;
+    pthread_mutex_unlock( &s->cacheLock );
+    return ix;
+}
+
+/**
+    The printSegment function prints a segment found by a query, as the name of its Model,
+    its number within the Model counting from one, and the coordinates of its ends.
+
+    @param m the Model.
+    @param ix the Model's index.
+    @param pos the position of the segment in the index.
+ */
+static void printSegment( Model const *m, SpatialIndex const *ix, int pos )
+{
+    // formatCoord doesn't terminate the text, so terminate each coordinate here.
+    char coord[ 4 ][ COORD_LEN + 1 ];
+    coord[ 0 ][ formatCoord( ix->px[ 2 * pos ], coord[ 0 ] ) ] = '\0';
+    coord[ 1 ][ formatCoord( ix->py[ 2 * pos ], coord[ 1 ] ) ] = '\0';
+    coord[ 2 ][ formatCoord( ix->px[ 2 * pos + 1 ], coord[ 2 ] ) ] = '\0';
+    coord[ 3 ][ formatCoord( ix->py[ 2 * pos + 1 ], coord[ 3 ] ) ] = '\0';
+    fprintf( outStream(), "%s %d %s %s %s %s\n", m->name, ix->id[ pos ] + 1, coord[ 0 ],
+             coord[ 1 ], coord[ 2 ], coord[ 3 ] );
+}
+
+void queryScene( Scene *s, double x1, double y1, double x2, double y2 )
+{
+    // The points have to be up to date.
+    syncPipeline( s->pipeline );
+    sortModels( s );
+
+    // The corners can be given in any order.
+    double minX = x1 < x2 ? x1 : x2;
+    double maxX = x1 < x2 ? x2 : x1;
+    double minY = y1 < y2 ? y1 : y2;
+    double maxY = y1 < y2 ? y2 : y1;
+
+    // Print the hits of each Model in order.
+    SegmentHit *hits = NULL;
+    int cap = 0;
+    for ( int i = 0; i < s->mCount; i++ ) {
+        Model *m = s->mList[ i ];
+        if ( m->pCount == 0 ) {
+            continue;
+        }
+        SpatialIndex *ix = modelIndex( s, m );
+        int found = queryIndex( ix, minX, minY, maxX, maxY, &hits, &cap );
+        if ( found > 0 ) {
+            qsort( hits, found, sizeof( SegmentHit ), compareHits );
+        }
+        for ( int j = 0; j < found; j++ ) {
+            printSegment( m, ix, hits[ j ].pos );
+        }
+    }
+    free( hits );
+}
+
+bool nearestScene( Scene *s, double x, double y )
 {
-    // Temporary model pointer.
-    Model *temp;
-    // Temporary name array.
-    char tempName[ NAME_LIMIT + 1];
-    // The names of all of the Models.
-    char names[ s->mCount ][ NAME_LIMIT + 1 ];
-    // Store the names of all of the Models.
-    for (int i = 0; i < s->mCount; i++ ) {
-        strcpy( names[ i ], s->mList[ i ]->name );
+    // The points have to be up to date.
+    syncPipeline( s->pipeline );
+    sortModels( s );
+
+    // Models later in order have to be strictly closer to win.
+    double best = INFINITY;
+    Model *bestModel = NULL;
+    int bestPos = 0;
+    for ( int i = 0; i < s->mCount; i++ ) {
+        Model *m = s->mList[ i ];
+        if ( m->pCount > 0 && nearestIndex( modelIndex( s, m ), x, y, &best, &bestPos ) ) {
+            bestModel = m;
+        }
+    }
+
+    if ( !bestModel ) {
+        return false;
     }
+    printSegment( bestModel, bestModel->index, bestPos );
+    return true;
+}
 
-    // If name at i is greater than name at j, swap their positions.
+bool intersectScene( Scene *s, char const names[][ NAME_LIMIT + 1 ], int count )
+{
+    // Every named Model has to be there.
+    for ( int i = 0; i < count; i++ ) {
+        if ( !containsModel( s, names[ i ] ) ) {
+            return false;
+        }
+    }
+
+    // The points have to be up to date.
+    syncPipeline( s->pipeline );
+    sortModels( s );
+
+    // Pick out the Models to search, in order, and their indexes.
+    Model **models = (Model **)malloc( ( s->mCount ? s->mCount : 1 ) * sizeof( Model * ) );
+    SpatialIndex **indexes = (SpatialIndex **)malloc( ( s->mCount ? s->mCount : 1 )
+                                                      * sizeof( SpatialIndex * ) );
+    int n = 0;
     for ( int i = 0; i < s->mCount; i++ ) {
-        for ( int j = i + 1; j < s->mCount; j++ ) {
-            if ( strcmp( names[ i ], names[ j ] ) > 0 ) {
-               temp = s->mList[ i ];
-               strcpy( tempName, names[ i ]);
-               s->mList[ i ] = s->mList[ j ];
-               strcpy( names[ i ], names[ j ]);
-               s->mList[ j ] = temp;
-               strcpy( names[ j ], tempName );
-            }
+        bool chosen = count == 0;
+        for ( int j = 0; j < count && !chosen; j++ ) {
+            chosen = strcmp( names[ j ], s->mList[ i ]->name ) == 0;
         }
+        if ( chosen && s->mList[ i ]->pCount > 0 ) {
+            countPoints( s->stats, s->mList[ i ]->pCount );
+            models[ n ] = s->mList[ i ];
+            indexes[ n++ ] = modelIndex( s, s->mList[ i ] );
+        }
+    }
+
+    // Print the pairs that meet.
+    static char const *kinds[] = { "none", "cross", "touch", "overlap" };
+    Crossing *crossings;
+    int found = findCrossings( indexes, n, &crossings );
+    for ( int i = 0; i < found; i++ ) {
+        Crossing const *c = crossings + i;
+        fprintf( outStream(), "%s %d %s %d %s\n", models[ c->first ]->name, c->id1 + 1,
+                 models[ c->second ]->name, c->id2 + 1, kinds[ c->kind ] );
+    }
+
+    free( crossings );
+    free( indexes );
+    free( models );
+    return true;
+}
+
+/**
+    The compareNames function orders Models by name, for qsort.
+
+    @param a a pointer to the first Model pointer.
+    @param b a pointer to the second Model pointer.
+
+    @return Negative, zero or positive as a comes before, with or after b.
+ */
+static int compareNames( void const *a, void const *b )
+{
+    return strcmp( ( *(Model * const *)a )->name, ( *(Model * const *)b )->name );
+}
+
+void sortModels( Scene *s )
+{
+    // A list that's already in order is left alone, so server commands sharing the Scene
+    // can all check it at once.
+    int i = 1;
+    while ( i < s->mCount && compareNames( s->mList + i - 1, s->mList + i ) < 0 ) {
+        i++;
+    }
+
+    // Names are unique within a Scene, so the order doesn't depend on the sort being stable.
+    if ( i < s->mCount ) {
+        qsort( s->mList, s->mCount, sizeof( Model * ), compareNames );
     }
 }
 
+void settleScene( Scene *s )
+{
+    syncPipeline( s->pipeline );
+    sortModels( s );
+}
+
 Model *getModel( Scene *s, char const *mname )
 {
     // See if there's a matching Model.
     for ( int i = 0; i < s->mCount; i++ ) {
         if ( strcmp( mname, s->mList[ i ]->name ) == 0 ) {
-            // Return the match.
+            // Return the match, once its transforms are done.
+            syncModel( s->pipeline, s->mList[ i ] );
             return s->mList[ i ];
         }
     }
@@ -179,8 +943,82 @@ Model *getModel( Scene *s, char const *mname )
     return NULL;
 }
 
+Model *editModel( Scene *s, char const *mname )
+{
+    for ( int i = 0; i < s->mCount; i++ ) {
+        if ( strcmp( mname, s->mList[ i ]->name ) == 0 ) {
+            // Return the match, or its clone, once its transforms are done.
+            Model *m = ownModel( s, i );
+            if ( m ) {
+                syncModel( s->pipeline, m );
+            }
+            return m;
+        }
+    }
+    // No match.
+    return NULL;
+}
+
+void checkpointScene( Scene *s, char const *name )
+{
+    // Shared Models can't change, so the transforms queued for them have to be done.
+    syncPipeline( s->pipeline );
+
+    // Let go of the list a checkpoint with the name already has, or make a new one.
+    Checkpoint *cp = findCheckpoint( s, name );
+    if ( cp ) {
+        dropList( s, cp->mList, cp->mCount, cp->listRefs, false );
+    } else {
+        if ( s->cCount == s->cCap ) {
+            s->cCap = s->cCap ? s->cCap * RESIZE : RESIZE;
+            s->cList = (Checkpoint *)realloc( s->cList, s->cCap * sizeof( Checkpoint ) );
+        }
+        cp = s->cList + s->cCount++;
+        strcpy( cp->name, name );
+    }
+
+    // Share the Scene's list.
+    if ( !s->listRefs ) {
+        s->listRefs = (int *)malloc( sizeof( int ) );
+        *s->listRefs = 1;
+    }
+    ++*s->listRefs;
+    cp->mCount = s->mCount;
+    cp->mCap = s->mCap;
+    cp->mList = s->mList;
+    cp->listRefs = s->listRefs;
+}
+
+bool restoreScene( Scene *s, char const *name )
+{
+    Checkpoint *cp = findCheckpoint( s, name );
+    if ( !cp ) {
+        return false;
+    }
+
+    // A Scene still sharing the checkpoint's list hasn't changed since it was taken.
+    if ( s->mList == cp->mList ) {
+        return true;
+    }
+
+    // Let go of the current Models, once nothing is transforming them, and share the
+    // checkpoint's list.
+    syncPipeline( s->pipeline );
+    dropList( s, s->mList, s->mCount, s->listRefs, false );
+    s->mCount = cp->mCount;
+    s->mCap = cp->mCap;
+    s->mList = cp->mList;
+    s->listRefs = cp->listRefs;
+    ++*s->listRefs;
+    s->boxValid = false;
+    return true;
+}
+
 void addModelPointer( Scene *s, Model * const m )
 {
+    // A list shared with checkpoints is copied first.
+    ownList( s );
+
     // If the Model array is full, reallocate the memory to an array that's 2 times bigger.
     if ( s->mCount == s->mCap ) {
         s->mCap *= RESIZE;
@@ -191,5 +1029,6 @@ void addModelPointer( Scene *s, Model * const m )
     if ( m ) {
         s->mList[ s->mCount ] = m;
         s->mCount++;
+        addBox( &s->box, &m->box );
     }
 }
@@ -10,11 +10,56 @@
 #define _SCENE_H_
 
 #include "model.h"
+#include "pipeline.h"
+#include "prefetch.h"
+#include "stats.h"
 #include <stdbool.h>
+#include <pthread.h>
 
 /** Value used to initialize and resize an array of model pointers. */
 #define RESIZE 2
 
+/**
+    A named group of Models. Its members are given by names and fnmatch patterns, which are
+    matched against the Models in the Scene each time the group is used, so Models loaded
+    or deleted later join or leave it.
+ */
+typedef struct {
+    /** Name of the group. */
+    char name[ NAME_LIMIT + 1 ];
+
+    /** Number of member names and patterns. */
+    int count;
+
+    /** Capacity of the member list. */
+    int cap;
+
+    /** The member names and patterns. */
+    char (*members)[ NAME_LIMIT + 1 ];
+} Group;
+
+/**
+    A saved state of a Scene's Models, to restore later. It shares the Scene's Model list
+    rather than copying it; the list, and each Model in it, is copied only when something
+    is about to change it.
+ */
+typedef struct {
+    /** Name of the checkpoint. */
+    char name[ NAME_LIMIT + 1 ];
+
+    /** Number of Models. */
+    int mCount;
+
+    /** Capacity of the Model list. */
+    int mCap;
+
+    /** The Models, in a list that may be shared with the Scene and other checkpoints. */
+    Model **mList;
+
+    /** Number of holders of mList, shared by all of them. */
+    int *listRefs;
+} Checkpoint;
+
 /** Representation for a whole scene, a collection of models. */
 typedef struct {
     /** Number of models in the scene. */
@@ -25,6 +70,56 @@ typedef struct {
 
     /** List of pointers to models. */
     Model **mList;
+
+    /**
+        Number of holders of mList, shared with the checkpoints holding it, or NULL if the
+        Scene is the only one. A shared list is copied before it, or any Model in it, is
+        changed.
+     */
+    int *listRefs;
+
+    /** Arena holding the Models of the scene and their points. */
+    Arena *arena;
+
+    /** Transforms of the Models that haven't been applied yet. */
+    Pipeline *pipeline;
+
+    /** Model files being read ahead for load commands, or NULL if there aren't any. */
+    Prefetcher *prefetch;
+
+    /** Statistics of the commands run on the Scene, or NULL if they are off. */
+    Stats *stats;
+
+    /** Number of groups defined. */
+    int gCount;
+
+    /** Capacity of the group list. */
+    int gCap;
+
+    /** List of the groups defined. */
+    Group *gList;
+
+    /** Number of checkpoints. */
+    int cCount;
+
+    /** Capacity of the checkpoint list. */
+    int cCap;
+
+    /** List of the checkpoints. */
+    Checkpoint *cList;
+
+    /** Bounding box of every Model in the Scene, if boxValid is true. */
+    Box box;
+
+    /** True if box is up to date. Anything that could shrink it sets this to false. */
+    bool boxValid;
+
+    /**
+        Lock for the caches that commands which only read the Scene fill in: the spatial
+        indexes and saved text of the Models, and box. The server runs those commands at
+        the same time.
+     */
+    pthread_mutex_t cacheLock;
 } Scene;
 
 /**
@@ -36,36 +131,42 @@ Scene *makeScene();
 
 /**
     This function frees all of the dynamically allocated memory used by a scene, including the
-    Scene object itself, its array of Model pointers, and the Model instances themselves.
+    Scene object itself, its array of Model pointers, and the Model instances themselves. The
+    Models are released all at once along with the Scene's Arena.
 
     @param s the Scene to be freed.
  */
 void freeScene( Scene *s );
 
 /**
-    This function finds the Model with the given name and applies the provided transformation
-    function to the Model.
-
-    @param s the Scene containing the Model to be transformed.
-    @param name the name of the Model to be transformed.
-    @param f the transformation function to be applied to the Model.
-    @param a the first required value for transformation.
-    @param b the second required value for transformation.
-
-    @return True if the transformation was applied, false if the given name is not used by
-            an existing Model.
+    This function finds the Models the given name stands for and applies the given Transform
+    to them with the vectorized kernels. The name is a Model's name, or failing that a
+    group's, or failing that an fnmatch pattern matched against every Model's name. A
+    single Model goes through the Scene's Pipeline, so its Transform may still be running
+    on another thread when this returns; the other Scene functions wait for it before they
+    use the Model's points. Several Models are transformed together before this returns,
+    in one pass over all of their points.
+
+    @param s the Scene containing the Models to be transformed.
+    @param name the name of a Model or group, or a pattern.
+    @param t the Transform to apply.
+
+    @return True if the transformation was applied, false if the name doesn't stand for any
+            existing Model.
  */
-bool applyToScene(Scene *s, char const *name, void (*f)(double pt[NUM_COORDS], double a, double b),
-                  double a, double b);
+bool transformScene( Scene *s, char const *name, Transform const *t );
 
 /**
-    The addModel function loads a Model into the given Scene.
+    The addModel function loads a Model into the given Scene, allocating it from the Scene's
+    Arena. If the Scene has a Prefetcher that read the file ahead for this command, that
+    Model is used instead of reading the file again.
 
     @param s the Scene to load the Model into.
     @param fname the name of the file to load the Model from.
     @param mname the name of the Model.
+    @param commandNum the number of the load command.
  */
-void addModel( Scene *s, char const *fname, char const *mname );
+void addModel( Scene *s, char const *fname, char const *mname, int commandNum );
 
 /**
     The containsModel function returns true if the given Scene contains a Model with
@@ -80,14 +181,30 @@ bool containsModel( Scene *s, char const *mname );
 
 /**
     The saveScene function saves the the line segments of the Models found within the
-    given Scene to an output file with the given file name. If the output file can't  be
-    opened, an error message is output and no output file is saved.
+    given Scene to an output file with the given file name. File names ending with
+    BINARY_EXTENSION get the binary model format, ones ending with PACKED_EXTENSION the
+    packed model format, and anything else gets text. If the output file can't  be opened,
+    a binary or packed file can't be written in full, there isn't enough memory to format
+    the file, or a coordinate is too large for the packed format, an error message is
+    output and no output file is saved.
 
     @param s the Scene to save.
     @param fname the name of the output file.
  */
 void saveScene( Scene *s, char const *fname );
 
+/**
+    The renderScene function draws the line segments of the Models found within the given
+    Scene into a PPM image file with the given name and size. If the output file can't be
+    opened, an error message is output and no image is drawn.
+
+    @param s the Scene to draw.
+    @param fname the name of the image file.
+    @param width the width of the image, from 1 to MAX_IMAGE_SIZE.
+    @param height the height of the image, from 1 to MAX_IMAGE_SIZE.
+ */
+void renderScene( Scene *s, char const *fname, int width, int height );
+
 /**
     The removeModel function removes a Model with the give name from the given Scene.
 
@@ -104,6 +221,88 @@ void removeModel( Scene *s, char const *mname );
  */
 void list( Scene *s );
 
+/**
+    The queryScene function prints every segment that touches the rectangle with the given
+    corners, boundary included. Segments are grouped by Model, in order of Model name, and
+    listed in their order within the Model. Each is printed as the Model name, the number
+    of the segment counting from one, and the coordinates of its ends.
+
+    @param s the Scene to search.
+    @param x1 the x-coordinate of one corner.
+    @param y1 the y-coordinate of one corner.
+    @param x2 the x-coordinate of the opposite corner.
+    @param y2 the y-coordinate of the opposite corner.
+ */
+void queryScene( Scene *s, double x1, double y1, double x2, double y2 );
+
+/**
+    The nearestScene function prints the segment nearest the given point, the same way
+    queryScene prints segments. Of segments at the same distance, the one in the Model
+    with the first name wins, then the one with the lowest number.
+
+    @param s the Scene to search.
+    @param x the x-coordinate of the point.
+    @param y the y-coordinate of the point.
+
+    @return True if a segment was found, false if the Scene has no segments.
+ */
+bool nearestScene( Scene *s, double x, double y );
+
+/**
+    This function prints the bounding box of the Models the given name stands for, or of the
+    whole Scene, as its left, bottom, right and top sides. The boxes are kept up to date as
+    Models change, so no points are read and no transforms are waited for. A box that has
+    been rotated can be larger than the tightest one.
+
+    @param s the Scene.
+    @param name the name of a Model or group, or a pattern, as for transformScene(), or
+                NULL for every Model.
+
+    @return True if the box was printed, false if there aren't any Models to bound.
+ */
+bool boundsScene( Scene *s, char const *name );
+
+/**
+    This function adds a member to a group, defining the group if it doesn't exist yet.
+
+    @param s the Scene.
+    @param gname the name of the group.
+    @param member the name of a Model, or an fnmatch pattern for the names of Models.
+ */
+void addToGroup( Scene *s, char const *gname, char const *member );
+
+/**
+    This function saves the current Models of a Scene as a checkpoint with the given name,
+    replacing any checkpoint that already has it. Nothing is copied: the checkpoint shares
+    the Scene's Model list, and later commands copy only the list and the Models they
+    change, and a Model's points only once they change. Groups aren't part of a
+    checkpoint, since they stand for Models by name.
+
+    @param s the Scene.
+    @param name the name of the checkpoint.
+ */
+void checkpointScene( Scene *s, char const *name );
+
+/**
+    This function puts back the Models of the checkpoint with the given name, which is kept
+    so it can be restored again. Nothing is copied; the Scene shares the checkpoint's list.
+
+    @param s the Scene.
+    @param name the name of the checkpoint.
+
+    @return True if the checkpoint was restored, false if there isn't one with the name.
+ */
+bool restoreScene( Scene *s, char const *name );
+
+/**
+    This function finishes every queued transform and puts the Models in order, so that
+    commands which only read the Scene won't change anything but its caches. The server
+    calls it after each command that changes the Scene.
+
+    @param s the Scene.
+ */
+void settleScene( Scene *s );
+
 /**
     The sortModels function sorts all of the Models found within the given Scene
     by Model name, storing them in alphabetical order.
@@ -114,7 +313,8 @@ void sortModels( Scene *s );
 
 /**
     The getModel function returns a Model pointer to the Model with the given name from
-    the given Scene, or NULL if it can't be found.
+    the given Scene, or NULL if it can't be found. Any transforms still queued for the Model
+    are finished first, so its points are ready to use.
 
     @param s the Scene to retrieve a Model from.
     @mname the name of the Model to retrieve.
@@ -123,6 +323,20 @@ void sortModels( Scene *s );
  */
 Model *getModel( Scene *s, char const *mname );
 
+/**
+    The editModel function returns the Model with the given name, ready to be changed. It
+    is the Model getModel() would return, or a clone of it taking its place in the Scene if
+    a checkpoint holds it too. Check containsModel() first to tell a missing Model from a
+    clone there was no room for.
+
+    @param s the Scene to retrieve a Model from.
+    @param mname the name of the Model to retrieve.
+
+    @return A Model pointer to the Model with the given name, or NULL if it can't be found
+            or there was no room to clone it.
+ */
+Model *editModel( Scene *s, char const *mname );
+
 /**
     The addModelPointer function adds a Model pointer to the given Scene, resizing the Model
     array as needed.
@@ -132,4 +346,19 @@ Model *getModel( Scene *s, char const *mname );
  */
 void addModelPointer( Scene *s, Model * const m );
 
+/**
+    The intersectScene function prints every pair of segments from different Models that
+    meet, with the Models given, or all the Models in the Scene if none are given. A pair is
+    printed as the name of the first Model and the number of its segment, then the same for
+    the second Model, then how they meet: cross, touch or overlap. The Models of a pair are
+    in order of name, and pairs are in order of Model names, then segment numbers.
+
+    @param s the Scene to search.
+    @param names the names of the Models to search.
+    @param count the number of names, or zero for all the Models.
+
+    @return False if a named Model isn't in the Scene, and nothing is printed.
+ */
+bool intersectScene( Scene *s, char const names[][ NAME_LIMIT + 1 ], int count );
+
 #endif
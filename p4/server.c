@@ -0,0 +1,491 @@
+/**
+    @file server.c
+    @author Brian Morris (bcmorri3)
+
+    The server.c program contains the server and client defined in server.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "command.h"
+#include "output.h"
+
+/** Size of the buffer used to copy data in the client. */
+#define COPY_BUFFER 4096
+
+/** Nanoseconds to wait before accepting again, when a connection can't be taken at all. */
+#define ACCEPT_BACKOFF 100000000
+
+/** File opened to hold a descriptor in reserve. */
+#define SPARE_FILE "/dev/null"
+
+/** One client's connection. */
+typedef struct ConnectionTag {
+    /** The shared state. */
+    struct ServerTag *server;
+
+    /** The connected socket. */
+    int fd;
+
+    /** The connection before this one in the server's list. */
+    struct ConnectionTag *prev;
+
+    /** The connection after this one in the server's list. */
+    struct ConnectionTag *next;
+} Connection;
+
+/** The state every connection shares. */
+typedef struct ServerTag {
+    /** The Scene being served. */
+    Scene *s;
+
+    /** The function that runs each command line. */
+    RunLine run;
+
+    /** Readers hold this to run commands that only read the Scene, writers to change it. */
+    pthread_rwlock_t lock;
+
+    /** Set, under the lock for writing, once the server is stopping. No more commands run. */
+    bool closed;
+
+    /** Guards the list of connections. */
+    pthread_mutex_t clientLock;
+
+    /** Signalled when the last connection is removed from the list. */
+    pthread_cond_t noClients;
+
+    /** The connections whose threads are still running. */
+    Connection *clients;
+} Server;
+
+/** Set when the server has been asked to stop. */
+static volatile sig_atomic_t stopping = 0;
+
+/**
+    The requestStop function is the handler for the signals that stop the server.
+
+    @param sig the signal.
+ */
+static void requestStop( int sig )
+{
+    stopping = 1;
+}
+
+/**
+    The backOff function waits a little while, for resources to be freed, before the server
+    tries to accept another connection.
+ */
+static void backOff()
+{
+    struct timespec pause = { 0, ACCEPT_BACKOFF };
+    nanosleep( &pause, NULL );
+}
+
+/**
+    The quits function reports whether a line is a quit command that would be valid.
+
+    @param cl the tokens of the line.
+    @param commandIndex the index of the line's command.
+
+    @return True if the line ends the connection.
+ */
+static bool quits( CommandLine const *cl, int commandIndex )
+{
+    return commandIndex == QUIT_COMMAND && cl->count <= 1 && cl->cleanEnd;
+}
+
+/**
+    The addClient function puts a connection on the server's list.
+
+    @param server the server.
+    @param c the connection.
+ */
+static void addClient( Server *server, Connection *c )
+{
+    pthread_mutex_lock( &server->clientLock );
+    c->prev = NULL;
+    c->next = server->clients;
+    if ( c->next ) {
+        c->next->prev = c;
+    }
+    server->clients = c;
+    pthread_mutex_unlock( &server->clientLock );
+}
+
+/**
+    The removeClient function takes a connection off the server's list. The caller closes
+    the socket afterwards, so the server can't shut down a descriptor that has been reused.
+
+    @param c the connection.
+ */
+static void removeClient( Connection *c )
+{
+    Server *server = c->server;
+    pthread_mutex_lock( &server->clientLock );
+    if ( c->prev ) {
+        c->prev->next = c->next;
+    } else {
+        server->clients = c->next;
+    }
+    if ( c->next ) {
+        c->next->prev = c->prev;
+    }
+    if ( !server->clients ) {
+        pthread_cond_signal( &server->noClients );
+    }
+    pthread_mutex_unlock( &server->clientLock );
+}
+
+/**
+    The serveClient function runs the commands of one connection on its own thread, each
+    under the lock for reading or writing as the command needs.
+
+    @param arg the Connection, which this removes from the server's list and frees.
+
+    @return NULL.
+ */
+static void *serveClient( void *arg )
+{
+    Connection *c = (Connection *)arg;
+    Server *server = c->server;
+
+    // The client needs a stream each way. Without them, as when the process is out of file
+    // descriptors, hang up rather than let the output go anywhere else.
+    FILE *in = fdopen( c->fd, "r" );
+    int outFd = in ? dup( c->fd ) : -1;
+    FILE *out = outFd >= 0 ? fdopen( outFd, "w" ) : NULL;
+    if ( !out ) {
+        if ( outFd >= 0 ) {
+            close( outFd );
+        }
+        removeClient( c );
+        if ( in ) {
+            fclose( in );
+        } else {
+            close( c->fd );
+        }
+        free( c );
+        return NULL;
+    }
+
+    // Everything the commands print goes back over the connection, in order.
+    setStreams( out, out );
+
+    int commandNum = 1;
+    int commandIndex = INVALID_COMMAND;
+    char params[ PARAM_LEN + 1 ];
+    while ( fgets( params, sizeof( params ), in ) ) {
+        // Drop the rest of a line that's too long, as the interactive mode does.
+        if ( params[ strlen( params ) - 1 ] != '\n' ) {
+            int ch;
+            while ( ( ch = getc( in ) ) != '\n' && ch != EOF ) {
+            }
+        }
+
+        // Find the command the line runs, a blank line repeating the last one.
+        CommandLine cl;
+        tokenizeLine( params, &cl );
+        int index = cl.count > 0 ? lookupVerb( cl.start[ 0 ], cl.len[ 0 ] ) : commandIndex;
+        if ( quits( &cl, index ) ) {
+            break;
+        }
+
+        // Readers share the Scene. A writer has it alone, and leaves it settled. Once the
+        // server is stopping, the Scene is left alone.
+        bool reads = readsOnly( index );
+        if ( reads ) {
+            pthread_rwlock_rdlock( &server->lock );
+        } else {
+            pthread_rwlock_wrlock( &server->lock );
+        }
+        bool closed = server->closed;
+        if ( !closed ) {
+            server->run( server->s, commandNum++, &commandIndex, params );
+            if ( !reads ) {
+                settleScene( server->s );
+            }
+        }
+        pthread_rwlock_unlock( &server->lock );
+        if ( closed ) {
+            break;
+        }
+        fflush( out );
+    }
+
+    // The output is flushed while the server can still shut the socket down, in case the
+    // client has stopped reading.
+    setStreams( NULL, NULL );
+    fclose( out );
+    removeClient( c );
+    fclose( in );
+    free( c );
+    return NULL;
+}
+
+/**
+    The openSocket function makes a socket listening at the given path, replacing a stale
+    socket left there.
+
+    @param path the path of the socket.
+
+    @return The socket, or -1 if it couldn't be made.
+ */
+static int openSocket( char const *path )
+{
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if ( strlen( path ) >= sizeof( addr.sun_path ) ) {
+        return -1;
+    }
+    strcpy( addr.sun_path, path );
+
+    // Only a socket is removed, never any other kind of file.
+    struct stat st;
+    if ( lstat( path, &st ) == 0 && S_ISSOCK( st.st_mode ) ) {
+        unlink( path );
+    }
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 ) {
+        return -1;
+    }
+    if ( bind( fd, (struct sockaddr *)&addr, sizeof( addr ) ) != 0
+         || listen( fd, SERVER_BACKLOG ) != 0 ) {
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+/**
+    The dropConnection function deals with a connection that couldn't be accepted because
+    the process or the system is out of file descriptors. The spare descriptor is closed
+    to make room to accept the connection, only to hang up on it, so the client isn't left
+    waiting and the listening socket stops reporting it. If even that fails, the server
+    waits a while before trying again, rather than spinning.
+
+    @param fd the listening socket.
+    @param spare the spare descriptor, or -1 if there isn't one. It is opened again.
+ */
+static void dropConnection( int fd, int *spare )
+{
+    int client = -1;
+    if ( *spare >= 0 ) {
+        close( *spare );
+        client = accept( fd, NULL, NULL );
+        if ( client >= 0 ) {
+            close( client );
+        }
+        *spare = open( SPARE_FILE, O_RDONLY );
+    }
+    if ( client < 0 ) {
+        backOff();
+    }
+}
+
+int serveScene( Scene *s, char const *path, RunLine run )
+{
+    int fd = openSocket( path );
+    if ( fd < 0 ) {
+        fprintf( stderr, "Can't open socket: %s\n", path );
+        return EXIT_FAILURE;
+    }
+
+    // Writers go first, so a steady stream of readers can't hold them off.
+    Server server = { s, run };
+    server.closed = false;
+    server.clients = NULL;
+    pthread_mutex_init( &server.clientLock, NULL );
+    pthread_cond_init( &server.noClients, NULL );
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init( &attr );
+    pthread_rwlockattr_setkind_np( &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+    pthread_rwlock_init( &server.lock, &attr );
+    pthread_rwlockattr_destroy( &attr );
+
+    // A client that goes away shouldn't take the server with it.
+    signal( SIGPIPE, SIG_IGN );
+
+    // The stop signals are only taken while waiting for a connection, so none is missed
+    // between checking for one and starting to wait. Client threads inherit the mask.
+    struct sigaction sa;
+    memset( &sa, 0, sizeof( sa ) );
+    sa.sa_handler = requestStop;
+    sigemptyset( &sa.sa_mask );
+    sigaction( SIGINT, &sa, NULL );
+    sigaction( SIGTERM, &sa, NULL );
+    sigset_t stopSignals, waitMask;
+    sigemptyset( &stopSignals );
+    sigaddset( &stopSignals, SIGINT );
+    sigaddset( &stopSignals, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &stopSignals, &waitMask );
+
+    // Keep a descriptor in reserve for when the others run out.
+    int spare = open( SPARE_FILE, O_RDONLY );
+
+    // Give each connection a thread of its own.
+    while ( !stopping ) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if ( ppoll( &pfd, 1, NULL, &waitMask ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            break;
+        }
+        int client = accept( fd, NULL, NULL );
+        if ( client < 0 ) {
+            // A connection the client gave up on, or a signal, just means trying again.
+            // Running out of descriptors or memory doesn't go away on its own.
+            if ( errno == EMFILE || errno == ENFILE ) {
+                dropConnection( fd, &spare );
+            } else if ( errno != EINTR && errno != ECONNABORTED ) {
+                backOff();
+            }
+            continue;
+        }
+        Connection *c = (Connection *)malloc( sizeof( Connection ) );
+        if ( !c ) {
+            close( client );
+            continue;
+        }
+        c->server = &server;
+        c->fd = client;
+        addClient( &server, c );
+        pthread_t thread;
+        if ( pthread_create( &thread, NULL, serveClient, c ) != 0 ) {
+            removeClient( c );
+            close( client );
+            free( c );
+            continue;
+        }
+        pthread_detach( thread );
+    }
+
+    // Stop taking connections, and wait out the commands that are running. After that, the
+    // clients still connected can't run any more.
+    close( fd );
+    if ( spare >= 0 ) {
+        close( spare );
+    }
+    unlink( path );
+    pthread_rwlock_wrlock( &server.lock );
+    server.closed = true;
+    pthread_rwlock_unlock( &server.lock );
+
+    // Hang up on every client, which wakes the threads waiting for input or for the client
+    // to read, and wait for them all to finish with the Scene before it's freed.
+    pthread_mutex_lock( &server.clientLock );
+    for ( Connection *c = server.clients; c; c = c->next ) {
+        shutdown( c->fd, SHUT_RDWR );
+    }
+    while ( server.clients ) {
+        pthread_cond_wait( &server.noClients, &server.clientLock );
+    }
+    pthread_mutex_unlock( &server.clientLock );
+
+    pthread_cond_destroy( &server.noClients );
+    pthread_mutex_destroy( &server.clientLock );
+    pthread_rwlock_destroy( &server.lock );
+    return EXIT_SUCCESS;
+}
+
+/**
+    The writeAll function writes a whole buffer to a file descriptor.
+
+    @param fd the file descriptor.
+    @param buf the data.
+    @param len the number of bytes.
+
+    @return True if all of it was written.
+ */
+static bool writeAll( int fd, char const *buf, size_t len )
+{
+    while ( len > 0 ) {
+        ssize_t n = write( fd, buf, len );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+    The sendInput function copies standard input to the server on its own thread, so the
+    replies are read even while the server is still reading commands. When the input runs
+    out, the server is told there are no more.
+
+    @param arg a pointer to the socket.
+
+    @return NULL.
+ */
+static void *sendInput( void *arg )
+{
+    int fd = *(int *)arg;
+    char buf[ COPY_BUFFER ];
+    ssize_t n;
+    while ( ( n = read( STDIN_FILENO, buf, sizeof( buf ) ) ) != 0 ) {
+        if ( n < 0 ? errno != EINTR : !writeAll( fd, buf, n ) ) {
+            break;
+        }
+    }
+    shutdown( fd, SHUT_WR );
+    return NULL;
+}
+
+int runClient( char const *path )
+{
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    int fd = strlen( path ) < sizeof( addr.sun_path ) ? socket( AF_UNIX, SOCK_STREAM, 0 ) : -1;
+    if ( fd >= 0 ) {
+        strcpy( addr.sun_path, path );
+    }
+    if ( fd < 0 || connect( fd, (struct sockaddr *)&addr, sizeof( addr ) ) != 0 ) {
+        fprintf( stderr, "Can't connect to socket: %s\n", path );
+        if ( fd >= 0 ) {
+            close( fd );
+        }
+        return EXIT_FAILURE;
+    }
+
+    // A server that stops reading shouldn't kill the client.
+    signal( SIGPIPE, SIG_IGN );
+
+    pthread_t sender;
+    pthread_create( &sender, NULL, sendInput, &fd );
+
+    // Print the replies until the server hangs up.
+    char buf[ COPY_BUFFER ];
+    ssize_t n;
+    while ( ( n = read( fd, buf, sizeof( buf ) ) ) != 0 ) {
+        if ( n < 0 ? errno != EINTR : !writeAll( STDOUT_FILENO, buf, n ) ) {
+            break;
+        }
+    }
+
+    // The server may hang up before the input runs out, after a quit.
+    pthread_cancel( sender );
+    pthread_join( sender, NULL );
+    close( fd );
+    return EXIT_SUCCESS;
+}
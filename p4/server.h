@@ -0,0 +1,60 @@
+/**
+    @file server.h
+    @author Brian Morris (bcmorri3)
+
+    The server.h header file declares the server mode of the drawing program, which hosts
+    one Scene behind a Unix-domain socket so several clients can share it. Each client
+    sends command lines, just as they would be typed, and gets back what the commands
+    print, errors included, with no prompts. Commands that only read the Scene run at the
+    same time as each other under a reader/writer lock; commands that change it run one at
+    a time, and the Scene is settled after each so the readers find nothing left to do.
+    A quit command ends the client's connection. The server runs until it gets SIGINT or
+    SIGTERM.
+
+    The client side connects to a server and passes standard input to it, printing
+    whatever comes back, so a script can be run against a shared Scene from the shell.
+ */
+
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "scene.h"
+
+/** Most connections waiting to be accepted. */
+#define SERVER_BACKLOG 16
+
+/**
+    A function that runs one command line against a Scene.
+
+    @param s the Scene.
+    @param commandNum the number of the command, counted per client.
+    @param commandIndex the index of the client's last command, updated to this one.
+    @param line the command line, null terminated.
+ */
+typedef void (*RunLine)( Scene *s, int commandNum, int *commandIndex, char const *line );
+
+/**
+    This function serves a Scene on a Unix-domain socket until SIGINT or SIGTERM, then
+    waits for the commands running at the time, hangs up on every client and removes the
+    socket. No client thread is left using the Scene when it returns. A stale socket
+    left at the path is replaced, but any other file there is an error.
+
+    @param s the Scene to serve.
+    @param path the path of the socket.
+    @param run the function that runs each command line.
+
+    @return EXIT_SUCCESS, or EXIT_FAILURE if the socket couldn't be set up.
+ */
+int serveScene( Scene *s, char const *path, RunLine run );
+
+/**
+    This function connects to a server, sends it standard input and copies what it sends
+    back to standard output, until the server closes the connection.
+
+    @param path the path of the server's socket.
+
+    @return EXIT_SUCCESS, or EXIT_FAILURE if the server couldn't be reached.
+ */
+int runClient( char const *path );
+
+#endif
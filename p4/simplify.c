@@ -0,0 +1,272 @@
+/**
+    @file simplify.c
+    @author Brian Morris (bcmorri3)
+
+    The simplify.c program contains the polyline simplification defined in simplify.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "simplify.h"
+#include "pool.h"
+
+/** Initial capacity of the lists of runs and of ranges to reduce. */
+#define INITIAL_CAP 16
+
+/** A run of connected segments. */
+typedef struct {
+    /** The first segment of the run. */
+    int start;
+
+    /** Number of segments in the run. */
+    int len;
+
+    /** Number of the run's points kept, counting both ends. */
+    int kept;
+} Run;
+
+/** The state shared by the tasks simplifying a Model. */
+typedef struct {
+    /** The x-coordinates of the Model's points. */
+    Coord const *x;
+
+    /** The y-coordinates of the Model's points. */
+    Coord const *y;
+
+    /** The runs of the Model. */
+    Run *runs;
+
+    /** For each point of the Model, nonzero if it is kept as a point of a polyline. */
+    unsigned char *keep;
+
+    /** The tolerance, squared. */
+    double tol2;
+
+    /** Set if a run couldn't be reduced for lack of memory. */
+    int failed;
+} Simplify;
+
+/**
+    The vertexPos function finds where a point of a run's polyline is stored. The first
+    point is the start of the first segment; each one after that is the end of a segment.
+
+    @param run the run.
+    @param t the number of the point along the polyline, from zero to the run's length.
+
+    @return The index of the point in the Model.
+ */
+static int vertexPos( Run const *run, int t )
+{
+    return t == 0 ? 2 * run->start : 2 * ( run->start + t ) - 1;
+}
+
+/**
+    The segmentDistance function returns the squared distance from a point to a segment.
+
+    @param s the Simplify holding the points.
+    @param a the index of the start of the segment.
+    @param b the index of the end of the segment.
+    @param p the index of the point.
+
+    @return The squared distance.
+ */
+static double segmentDistance( Simplify const *s, int a, int b, int p )
+{
+    double dx = s->x[ b ] - s->x[ a ];
+    double dy = s->y[ b ] - s->y[ a ];
+    double px = s->x[ p ] - s->x[ a ];
+    double py = s->y[ p ] - s->y[ a ];
+
+    // Project the point onto the segment, clamped to its ends.
+    double len = dx * dx + dy * dy;
+    double t = len > 0 ? ( px * dx + py * dy ) / len : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+
+    double ex = px - t * dx;
+    double ey = py - t * dy;
+    return ex * ex + ey * ey;
+}
+
+/**
+    The reduceRun function is run by parallelFor to reduce one run with Douglas-Peucker,
+    marking the points it keeps. Ranges still to be reduced are kept on a stack rather than
+    by recursion, since a polyline can have millions of points.
+
+    @param ctx the Simplify.
+    @param r the index of the run.
+ */
+static void reduceRun( void *ctx, int r )
+{
+    Simplify *s = (Simplify *)ctx;
+    Run *run = s->runs + r;
+
+    // The ends are always kept.
+    s->keep[ vertexPos( run, 0 ) ] = 1;
+    s->keep[ vertexPos( run, run->len ) ] = 1;
+    run->kept = 2;
+    if ( run->len < 2 ) {
+        return;
+    }
+
+    // Ranges of the polyline, by the numbers of their end points.
+    int cap = INITIAL_CAP;
+    int *stack = (int *)malloc( 2 * cap * sizeof( int ) );
+    if ( !stack ) {
+        __atomic_store_n( &s->failed, 1, __ATOMIC_RELAXED );
+        return;
+    }
+    int top = 0;
+    stack[ top++ ] = 0;
+    stack[ top++ ] = run->len;
+
+    while ( top > 0 ) {
+        int hi = stack[ --top ];
+        int lo = stack[ --top ];
+        int a = vertexPos( run, lo );
+        int b = vertexPos( run, hi );
+
+        // Find the point between the ends that is farthest from the segment joining them.
+        double worst = -1;
+        int far = lo;
+        for ( int t = lo + 1; t < hi; t++ ) {
+            double d = segmentDistance( s, a, b, vertexPos( run, t ) );
+            if ( d > worst ) {
+                worst = d;
+                far = t;
+            }
+        }
+
+        // Keep it if it is out of tolerance, and reduce each side of it.
+        if ( worst > s->tol2 ) {
+            s->keep[ vertexPos( run, far ) ] = 1;
+            run->kept++;
+            if ( top + 4 > 2 * cap ) {
+                cap *= 2;
+                int *bigger = (int *)realloc( stack, 2 * cap * sizeof( int ) );
+                if ( !bigger ) {
+                    free( stack );
+                    __atomic_store_n( &s->failed, 1, __ATOMIC_RELAXED );
+                    return;
+                }
+                stack = bigger;
+            }
+            if ( far - lo > 1 ) {
+                stack[ top++ ] = lo;
+                stack[ top++ ] = far;
+            }
+            if ( hi - far > 1 ) {
+                stack[ top++ ] = far;
+                stack[ top++ ] = hi;
+            }
+        }
+    }
+    free( stack );
+}
+
+/**
+    The findRuns function splits the segments of a Model into runs of connected segments.
+
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param segs the number of segments.
+    @param count set to the number of runs.
+
+    @return The dynamically allocated list of runs, or NULL if there was no room for it.
+ */
+static Run *findRuns( Coord const *x, Coord const *y, int segs, int *count )
+{
+    int cap = INITIAL_CAP;
+    Run *runs = (Run *)malloc( cap * sizeof( Run ) );
+    if ( !runs ) {
+        return NULL;
+    }
+    int n = 0;
+    for ( int i = 0; i < segs; i++ ) {
+        // A segment continues the run if it starts exactly where the last one ends.
+        if ( n > 0 && x[ 2 * i ] == x[ 2 * i - 1 ] && y[ 2 * i ] == y[ 2 * i - 1 ] ) {
+            runs[ n - 1 ].len++;
+            continue;
+        }
+        if ( n == cap ) {
+            cap *= 2;
+            Run *bigger = (Run *)realloc( runs, cap * sizeof( Run ) );
+            if ( !bigger ) {
+                free( runs );
+                return NULL;
+            }
+            runs = bigger;
+        }
+        runs[ n ].start = i;
+        runs[ n ].len = 1;
+        runs[ n ].kept = 0;
+        n++;
+    }
+    *count = n;
+    return runs;
+}
+
+bool simplifyModel( Model *m, double tolerance )
+{
+    if ( m->pCount == 0 ) {
+        return true;
+    }
+
+    // Work on the points in one pair of arrays.
+    if ( !flattenModel( m ) ) {
+        return false;
+    }
+    Simplify s;
+    s.x = m->head->xList;
+    s.y = m->head->yList;
+    s.tol2 = tolerance * tolerance;
+    s.failed = 0;
+    s.keep = (unsigned char *)calloc( m->pCount, 1 );
+    int count;
+    s.runs = s.keep ? findRuns( s.x, s.y, m->pCount / 2, &count ) : NULL;
+    if ( !s.runs ) {
+        free( s.keep );
+        return false;
+    }
+
+    // Reduce each run.
+    if ( m->pCount < PARALLEL_POINTS ) {
+        for ( int r = 0; r < count; r++ ) {
+            reduceRun( &s, r );
+        }
+    } else {
+        parallelFor( count, reduceRun, &s );
+    }
+
+    // Build the new segments from the points kept, each polyline a segment per pair of
+    // points in a row.
+    int total = 0;
+    for ( int r = 0; r < count; r++ ) {
+        total += 2 * ( s.runs[ r ].kept - 1 );
+    }
+    Model *out = s.failed ? NULL : makeModel( total, m->arena );
+    if ( !out ) {
+        free( s.keep );
+        free( s.runs );
+        return false;
+    }
+    int pos = 0;
+    for ( int r = 0; r < count; r++ ) {
+        Run const *run = s.runs + r;
+        int prev = vertexPos( run, 0 );
+        for ( int t = 1; t <= run->len; t++ ) {
+            int v = vertexPos( run, t );
+            if ( s.keep[ v ] ) {
+                out->head->xList[ pos ] = s.x[ prev ];
+                out->head->yList[ pos++ ] = s.y[ prev ];
+                out->head->xList[ pos ] = s.x[ v ];
+                out->head->yList[ pos++ ] = s.y[ v ];
+                prev = v;
+            }
+        }
+    }
+
+    free( s.keep );
+    free( s.runs );
+    replacePoints( m, out );
+    return true;
+}
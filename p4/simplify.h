@@ -0,0 +1,31 @@
+/**
+    @file simplify.h
+    @author Brian Morris (bcmorri3)
+
+    The simplify.h header file declares polyline simplification for Models. Runs of
+    segments where each one starts exactly where the one before it ends are treated as
+    polylines, and each is reduced with the Douglas-Peucker algorithm: its ends are kept,
+    and the point farthest from the segment joining them is kept if it is farther than the
+    tolerance, splitting the polyline in two to reduce the same way. Every point dropped is
+    within the tolerance of the simplified polyline, and segments that aren't connected to
+    their neighbors are left alone.
+ */
+
+#ifndef _SIMPLIFY_H_
+#define _SIMPLIFY_H_
+
+#include "model.h"
+
+/**
+    This function simplifies the polylines of a Model within the given tolerance. Models
+    with at least PARALLEL_POINTS points have their polylines reduced in parallel.
+
+    @param m the Model to simplify.
+    @param tolerance the farthest a dropped point can be from the simplified polyline.
+
+    @return True, or false if there wasn't enough memory, leaving the Model's points as they
+            were.
+ */
+bool simplifyModel( Model *m, double tolerance );
+
+#endif
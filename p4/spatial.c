@@ -0,0 +1,470 @@
+/**
+    @file spatial.c
+    @author Brian Morris (bcmorri3)
+
+    The spatial.c program contains the bounding volume hierarchy defined in spatial.h.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "spatial.h"
+
+/** Number of bits of each coordinate in a Morton code. */
+#define MORTON_BITS 16
+
+/** Largest coordinate value in a Morton code. */
+#define MORTON_MAX ( ( 1 << MORTON_BITS ) - 1 )
+
+/** Bits sorted by each pass of the radix sort. */
+#define RADIX_BITS 8
+
+/** Number of buckets in each pass of the radix sort. */
+#define RADIX_SIZE ( 1 << RADIX_BITS )
+
+/** Number of radix sort passes for a 32-bit key. */
+#define RADIX_PASSES 4
+
+/**
+    The spreadBits function spreads the low 16 bits of a value out to the even bits, so two
+    of them can be interleaved into a Morton code.
+
+    @param v the value.
+
+    @return The value with a zero between each of its bits.
+ */
+static uint32_t spreadBits( uint32_t v )
+{
+    v &= 0xFFFF;
+    v = ( v | ( v << 8 ) ) & 0x00FF00FF;
+    v = ( v | ( v << 4 ) ) & 0x0F0F0F0F;
+    v = ( v | ( v << 2 ) ) & 0x33333333;
+    v = ( v | ( v << 1 ) ) & 0x55555555;
+    return v;
+}
+
+/**
+    The quantize function maps a coordinate onto the grid used for Morton codes. Values
+    that aren't numbers go to zero.
+
+    @param v the coordinate.
+    @param lo the smallest coordinate.
+    @param scale grid steps per unit.
+
+    @return The grid coordinate, from 0 to MORTON_MAX.
+ */
+static uint32_t quantize( double v, double lo, double scale )
+{
+    double q = ( v - lo ) * scale;
+    if ( !( q >= 0 ) ) {
+        return 0;
+    }
+    if ( q > MORTON_MAX ) {
+        return MORTON_MAX;
+    }
+    return (uint32_t)q;
+}
+
+/**
+    The sortCodes function sorts segment numbers by their Morton codes with an LSD radix
+    sort, which keeps segments with equal codes in order.
+
+    @param codes the code of each segment, reordered along with order.
+    @param order the segment numbers, sorted by code.
+    @param n the number of segments.
+ */
+static void sortCodes( uint32_t *codes, int *order, int n )
+{
+    uint32_t *codeTmp = (uint32_t *)malloc( n * sizeof( uint32_t ) );
+    int *orderTmp = (int *)malloc( n * sizeof( int ) );
+
+    for ( int pass = 0; pass < RADIX_PASSES; pass++ ) {
+        int shift = pass * RADIX_BITS;
+
+        // Count each digit, then turn the counts into starting positions.
+        int start[ RADIX_SIZE ] = { 0 };
+        for ( int i = 0; i < n; i++ ) {
+            start[ ( codes[ i ] >> shift ) & ( RADIX_SIZE - 1 ) ]++;
+        }
+        int sum = 0;
+        for ( int d = 0; d < RADIX_SIZE; d++ ) {
+            int c = start[ d ];
+            start[ d ] = sum;
+            sum += c;
+        }
+
+        // Distribute, then swap the buffers.
+        for ( int i = 0; i < n; i++ ) {
+            int d = ( codes[ i ] >> shift ) & ( RADIX_SIZE - 1 );
+            codeTmp[ start[ d ] ] = codes[ i ];
+            orderTmp[ start[ d ] ] = order[ i ];
+            start[ d ]++;
+        }
+        memcpy( codes, codeTmp, n * sizeof( uint32_t ) );
+        memcpy( order, orderTmp, n * sizeof( int ) );
+    }
+
+    free( codeTmp );
+    free( orderTmp );
+}
+
+/**
+    The buildNode function fills in a node of the tree for a run of segments, splitting it
+    in half until the halves fit in a leaf.
+
+    @param ix the index being built.
+    @param node the node to fill in.
+    @param first tree position of the first segment.
+    @param count number of segments.
+ */
+static void buildNode( SpatialIndex *ix, int node, int first, int count )
+{
+    double loX = INFINITY, loY = INFINITY, hiX = -INFINITY, hiY = -INFINITY;
+
+    if ( count <= LEAF_SEGMENTS ) {
+        // A leaf bounds its own segments.
+        ix->first[ node ] = first;
+        ix->leafLen[ node ] = count;
+        for ( int i = 2 * first; i < 2 * ( first + count ); i++ ) {
+            loX = ix->px[ i ] < loX ? ix->px[ i ] : loX;
+            hiX = ix->px[ i ] > hiX ? ix->px[ i ] : hiX;
+            loY = ix->py[ i ] < loY ? ix->py[ i ] : loY;
+            hiY = ix->py[ i ] > hiY ? ix->py[ i ] : hiY;
+        }
+    } else {
+        // Other nodes bound their two children.
+        int left = ix->nodeCount;
+        ix->nodeCount += 2;
+        ix->first[ node ] = left;
+        ix->leafLen[ node ] = 0;
+        buildNode( ix, left, first, count / 2 );
+        buildNode( ix, left + 1, first + count / 2, count - count / 2 );
+        for ( int c = left; c <= left + 1; c++ ) {
+            loX = ix->loX[ c ] < loX ? ix->loX[ c ] : loX;
+            hiX = ix->hiX[ c ] > hiX ? ix->hiX[ c ] : hiX;
+            loY = ix->loY[ c ] < loY ? ix->loY[ c ] : loY;
+            hiY = ix->hiY[ c ] > hiY ? ix->hiY[ c ] : hiY;
+        }
+    }
+
+    ix->loX[ node ] = loX;
+    ix->loY[ node ] = loY;
+    ix->hiX[ node ] = hiX;
+    ix->hiY[ node ] = hiY;
+}
+
+SpatialIndex *buildIndex( Model const *m )
+{
+    int n = m->pCount / 2;
+
+    // Gather the segments in Model order, and find the range of their midpoints.
+    double *sx = (double *)malloc( 2 * n * sizeof( double ) );
+    double *sy = (double *)malloc( 2 * n * sizeof( double ) );
+    int pos = 0;
+    for ( Chunk *c = m->head; c; c = c->next ) {
+        expandPoints( c, c->xList, sx + pos );
+        expandPoints( c, c->yList, sy + pos );
+        pos += c->count;
+    }
+    double minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    for ( int i = 0; i < n; i++ ) {
+        double mx = ( sx[ 2 * i ] + sx[ 2 * i + 1 ] ) / 2;
+        double my = ( sy[ 2 * i ] + sy[ 2 * i + 1 ] ) / 2;
+        minX = mx < minX ? mx : minX;
+        maxX = mx > maxX ? mx : maxX;
+        minY = my < minY ? my : minY;
+        maxY = my > maxY ? my : maxY;
+    }
+
+    // Order the segments along a Morton curve through their midpoints.
+    double scaleX = maxX > minX && isfinite( maxX - minX ) ? MORTON_MAX / ( maxX - minX ) : 0;
+    double scaleY = maxY > minY && isfinite( maxY - minY ) ? MORTON_MAX / ( maxY - minY ) : 0;
+    uint32_t *codes = (uint32_t *)malloc( n * sizeof( uint32_t ) );
+    int *order = (int *)malloc( n * sizeof( int ) );
+    for ( int i = 0; i < n; i++ ) {
+        double mx = ( sx[ 2 * i ] + sx[ 2 * i + 1 ] ) / 2;
+        double my = ( sy[ 2 * i ] + sy[ 2 * i + 1 ] ) / 2;
+        codes[ i ] = spreadBits( quantize( mx, minX, scaleX ) )
+                     | spreadBits( quantize( my, minY, scaleY ) ) << 1;
+        order[ i ] = i;
+    }
+    sortCodes( codes, order, n );
+    free( codes );
+
+    // Copy the segments into tree order.
+    SpatialIndex *ix = (SpatialIndex *)malloc( sizeof( SpatialIndex ) );
+    ix->count = n;
+    ix->px = (double *)malloc( 2 * n * sizeof( double ) );
+    ix->py = (double *)malloc( 2 * n * sizeof( double ) );
+    ix->id = order;
+    for ( int i = 0; i < n; i++ ) {
+        int s = order[ i ];
+        ix->px[ 2 * i ] = sx[ 2 * s ];
+        ix->px[ 2 * i + 1 ] = sx[ 2 * s + 1 ];
+        ix->py[ 2 * i ] = sy[ 2 * s ];
+        ix->py[ 2 * i + 1 ] = sy[ 2 * s + 1 ];
+    }
+    free( sx );
+    free( sy );
+
+    // Every leaf but a lone root has at least two segments, so there are fewer nodes
+    // than segments.
+    int cap = n > 1 ? n : 1;
+    ix->loX = (double *)malloc( cap * sizeof( double ) );
+    ix->loY = (double *)malloc( cap * sizeof( double ) );
+    ix->hiX = (double *)malloc( cap * sizeof( double ) );
+    ix->hiY = (double *)malloc( cap * sizeof( double ) );
+    ix->first = (int *)malloc( cap * sizeof( int ) );
+    ix->leafLen = (int *)malloc( cap * sizeof( int ) );
+    ix->nodeCount = 1;
+    buildNode( ix, 0, 0, n );
+    return ix;
+}
+
+void freeIndex( SpatialIndex *ix )
+{
+    if ( !ix ) {
+        return;
+    }
+    free( ix->px );
+    free( ix->py );
+    free( ix->id );
+    free( ix->loX );
+    free( ix->loY );
+    free( ix->hiX );
+    free( ix->hiY );
+    free( ix->first );
+    free( ix->leafLen );
+    free( ix );
+}
+
+bool updateIndex( SpatialIndex *ix, Transform const *t )
+{
+    // Only translations and scalings keep the order of the coordinates.
+    if ( t->kind == TRANSLATE_KIND ) {
+        if ( !isfinite( t->tx ) || !isfinite( t->ty ) ) {
+            return false;
+        }
+    } else if ( t->kind == SCALE_KIND ) {
+        if ( !isfinite( t->xx ) ) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    // The same kernel gives the same values the Model's points got.
+    transformPoints( t, ix->px, ix->py, 2 * ix->count );
+    transformPoints( t, ix->loX, ix->loY, ix->nodeCount );
+    transformPoints( t, ix->hiX, ix->hiY, ix->nodeCount );
+
+    // A negative scale turns the boxes inside out.
+    if ( t->kind == SCALE_KIND && t->xx < 0 ) {
+        double *tmp = ix->loX;
+        ix->loX = ix->hiX;
+        ix->hiX = tmp;
+        tmp = ix->loY;
+        ix->loY = ix->hiY;
+        ix->hiY = tmp;
+    }
+    return true;
+}
+
+/**
+    The touchesRect function reports whether a segment touches a rectangle. They touch if
+    their bounding boxes overlap and the corners of the rectangle aren't all strictly on
+    one side of the segment's line.
+
+    @param ax the x-coordinate of the start of the segment.
+    @param ay the y-coordinate of the start of the segment.
+    @param bx the x-coordinate of the end of the segment.
+    @param by the y-coordinate of the end of the segment.
+    @param minX the left side of the rectangle.
+    @param minY the bottom of the rectangle.
+    @param maxX the right side of the rectangle.
+    @param maxY the top of the rectangle.
+
+    @return True if the segment touches the rectangle.
+ */
+static bool touchesRect( double ax, double ay, double bx, double by, double minX, double minY,
+                         double maxX, double maxY )
+{
+    // The bounding boxes have to overlap.
+    if ( !( ( ax >= minX || bx >= minX ) && ( ax <= maxX || bx <= maxX )
+            && ( ay >= minY || by >= minY ) && ( ay <= maxY || by <= maxY ) ) ) {
+        return false;
+    }
+
+    // Then the rectangle has to reach both sides of the line, or lie on it.
+    double dx = bx - ax;
+    double dy = by - ay;
+    double cx[ 4 ] = { minX, maxX, maxX, minX };
+    double cy[ 4 ] = { minY, minY, maxY, maxY };
+    bool below = false;
+    bool above = false;
+    for ( int i = 0; i < 4; i++ ) {
+        double side = dx * ( cy[ i ] - ay ) - dy * ( cx[ i ] - ax );
+        below |= side <= 0;
+        above |= side >= 0;
+    }
+    return below && above;
+}
+
+int queryIndex( SpatialIndex const *ix, double minX, double minY, double maxX, double maxY,
+                SegmentHit **hits, int *cap )
+{
+    int found = 0;
+    int stack[ MAX_DEPTH ];
+    int top = 0;
+    stack[ top++ ] = 0;
+
+    while ( top > 0 ) {
+        int node = stack[ --top ];
+
+        // Skip nodes that miss the rectangle.
+        if ( ix->hiX[ node ] < minX || ix->loX[ node ] > maxX || ix->hiY[ node ] < minY
+             || ix->loY[ node ] > maxY || ix->loX[ node ] > ix->hiX[ node ] ) {
+            continue;
+        }
+
+        if ( ix->leafLen[ node ] == 0 ) {
+            stack[ top++ ] = ix->first[ node ] + 1;
+            stack[ top++ ] = ix->first[ node ];
+            continue;
+        }
+
+        // Test each segment of a leaf.
+        int end = ix->first[ node ] + ix->leafLen[ node ];
+        for ( int s = ix->first[ node ]; s < end; s++ ) {
+            if ( touchesRect( ix->px[ 2 * s ], ix->py[ 2 * s ], ix->px[ 2 * s + 1 ],
+                              ix->py[ 2 * s + 1 ], minX, minY, maxX, maxY ) ) {
+                if ( found == *cap ) {
+                    *cap = *cap ? *cap * 2 : LEAF_SEGMENTS;
+                    *hits = (SegmentHit *)realloc( *hits, *cap * sizeof( SegmentHit ) );
+                }
+                ( *hits )[ found ].id = ix->id[ s ];
+                ( *hits )[ found ].pos = s;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+    The boxDistance function returns the squared distance from a point to a node's box.
+
+    @param ix the index.
+    @param node the node.
+    @param x the x-coordinate of the point.
+    @param y the y-coordinate of the point.
+
+    @return The squared distance, zero if the point is inside the box.
+ */
+static double boxDistance( SpatialIndex const *ix, int node, double x, double y )
+{
+    double dx = x < ix->loX[ node ] ? ix->loX[ node ] - x : x > ix->hiX[ node ] ? x - ix->hiX[ node ] : 0;
+    double dy = y < ix->loY[ node ] ? ix->loY[ node ] - y : y > ix->hiY[ node ] ? y - ix->hiY[ node ] : 0;
+    return dx * dx + dy * dy;
+}
+
+/**
+    The clamp function limits a value to the range between two others, in either order.
+
+    @param v the value.
+    @param a one end of the range.
+    @param b the other end of the range.
+
+    @return The value, moved into the range if it was outside.
+ */
+static double clamp( double v, double a, double b )
+{
+    double lo = a < b ? a : b;
+    double hi = a < b ? b : a;
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/**
+    The segmentDistance function returns the squared distance from a point to a segment.
+    The nearest point on the segment is kept inside the segment's box despite rounding, so
+    the distance is never less than the distance to any node box that holds the segment.
+
+    @param ix the index.
+    @param s the tree position of the segment.
+    @param x the x-coordinate of the point.
+    @param y the y-coordinate of the point.
+
+    @return The squared distance.
+ */
+static double segmentDistance( SpatialIndex const *ix, int s, double x, double y )
+{
+    double ax = ix->px[ 2 * s ];
+    double ay = ix->py[ 2 * s ];
+    double bx = ix->px[ 2 * s + 1 ];
+    double by = ix->py[ 2 * s + 1 ];
+    double dx = bx - ax;
+    double dy = by - ay;
+
+    // Project the point onto the segment, using the ends themselves past either end.
+    double len = dx * dx + dy * dy;
+    double t = len > 0 ? ( ( x - ax ) * dx + ( y - ay ) * dy ) / len : 0;
+    double cx = ax;
+    double cy = ay;
+    if ( t >= 1 ) {
+        cx = bx;
+        cy = by;
+    } else if ( t > 0 ) {
+        cx = clamp( ax + t * dx, ax, bx );
+        cy = clamp( ay + t * dy, ay, by );
+    }
+
+    double ex = cx - x;
+    double ey = cy - y;
+    return ex * ex + ey * ey;
+}
+
+bool nearestIndex( SpatialIndex const *ix, double x, double y, double *best, int *pos )
+{
+    int found = -1;
+    int stack[ MAX_DEPTH ];
+    int top = 0;
+    stack[ top++ ] = 0;
+
+    while ( top > 0 ) {
+        int node = stack[ --top ];
+
+        // Nodes farther away than the best so far can't hold anything better.
+        if ( ix->loX[ node ] > ix->hiX[ node ] || boxDistance( ix, node, x, y ) > *best ) {
+            continue;
+        }
+
+        // Visit the nearer child first.
+        if ( ix->leafLen[ node ] == 0 ) {
+            int left = ix->first[ node ];
+            if ( boxDistance( ix, left, x, y ) <= boxDistance( ix, left + 1, x, y ) ) {
+                stack[ top++ ] = left + 1;
+                stack[ top++ ] = left;
+            } else {
+                stack[ top++ ] = left;
+                stack[ top++ ] = left + 1;
+            }
+            continue;
+        }
+
+        int end = ix->first[ node ] + ix->leafLen[ node ];
+        for ( int s = ix->first[ node ]; s < end; s++ ) {
+            double d = segmentDistance( ix, s, x, y );
+            if ( d < *best || ( d == *best && found >= 0 && ix->id[ s ] < ix->id[ found ] ) ) {
+                *best = d;
+                found = s;
+            }
+        }
+    }
+
+    if ( found < 0 ) {
+        return false;
+    }
+    *pos = found;
+    return true;
+}
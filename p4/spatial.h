@@ -0,0 +1,136 @@
+/**
+    @file spatial.h
+    @author Brian Morris (bcmorri3)
+
+    The spatial.h header file declares a bounding volume hierarchy over the line segments of
+    a Model, used to find the segments in a region or the segment nearest a point without
+    looking at every segment. The segments are ordered along a Morton curve through their
+    midpoints and split evenly down the tree, so building it takes one radix sort.
+
+    The index keeps its own copy of the segments, so it doesn't depend on how the Model's
+    points are split into Chunks. After a translate or scale, the index is updated in place
+    by applying the same transform to its copy and to the node boxes; those transforms keep
+    the order of every coordinate, so the boxes still bound their segments exactly. Any
+    other change to the points means the index has to be built again.
+ */
+
+#ifndef _SPATIAL_H_
+#define _SPATIAL_H_
+
+#include <stdbool.h>
+#include "model.h"
+
+/** Most segments in a leaf of the tree. */
+#define LEAF_SEGMENTS 4
+
+/** Most levels the tree can have, which is far more than a Model can need. */
+#define MAX_DEPTH 64
+
+/** A bounding volume hierarchy over the segments of one Model. */
+typedef struct SpatialTag {
+    /** Number of segments. */
+    int count;
+
+    /** The x-coordinates of the segments' endpoints, two per segment, in tree order. */
+    double *px;
+
+    /** The y-coordinates of the segments' endpoints, parallel to px. */
+    double *py;
+
+    /** The number of each segment within the Model, in tree order. */
+    int *id;
+
+    /** Number of nodes in the tree; the root is node 0. */
+    int nodeCount;
+
+    /** Lower x bound of each node. */
+    double *loX;
+
+    /** Lower y bound of each node. */
+    double *loY;
+
+    /** Upper x bound of each node. */
+    double *hiX;
+
+    /** Upper y bound of each node. */
+    double *hiY;
+
+    /**
+        For a leaf, the tree position of its first segment. For other nodes, the index of
+        the left child; the right child follows it.
+     */
+    int *first;
+
+    /** Number of segments in a leaf, or zero for other nodes. */
+    int *leafLen;
+} SpatialIndex;
+
+/** A segment found by a region query. */
+typedef struct {
+    /** Number of the segment within the Model. */
+    int id;
+
+    /** Position of the segment in the index. */
+    int pos;
+} SegmentHit;
+
+/**
+    This function builds the spatial index for the segments of a Model.
+
+    @param m the Model, which must have at least one segment.
+
+    @return A pointer to the new index.
+ */
+SpatialIndex *buildIndex( Model const *m );
+
+/**
+    This function frees a spatial index.
+
+    @param ix the index to free, or NULL to do nothing.
+ */
+void freeIndex( SpatialIndex *ix );
+
+/**
+    This function updates a spatial index for a Transform that was just applied to its
+    Model, if the index can be kept. Only translations and scalings by finite amounts can.
+
+    @param ix the index.
+    @param t the Transform.
+
+    @return True if the index was updated, false if it has to be built again.
+ */
+bool updateIndex( SpatialIndex *ix, Transform const *t );
+
+/**
+    This function finds every segment that touches the given rectangle, including its
+    boundary. The hits are added to a list that grows as needed, in no particular order.
+
+    @param ix the index to search.
+    @param minX the left side of the rectangle.
+    @param minY the bottom of the rectangle.
+    @param maxX the right side of the rectangle.
+    @param maxY the top of the rectangle.
+    @param hits the list of hits, which may be reallocated.
+    @param cap the capacity of the list, updated if it grows.
+
+    @return The number of hits.
+ */
+int queryIndex( SpatialIndex const *ix, double minX, double minY, double maxX, double maxY,
+                SegmentHit **hits, int *cap );
+
+/**
+    This function finds the segment nearest a point that is closer than a given squared
+    distance. Of segments at the same distance, the one with the lowest number is chosen.
+
+    @param ix the index to search.
+    @param x the x-coordinate of the point.
+    @param y the y-coordinate of the point.
+    @param best the squared distance to beat, set to the squared distance of the segment
+                found.
+    @param pos set to the position of the segment found in the index.
+
+    @return True if a segment closer than best was found.
+ */
+bool nearestIndex( SpatialIndex const *ix, double x, double y, double *best, int *pos );
+
+#endif
@@ -0,0 +1,125 @@
+/**
+    @file spill.c
+    @author Brian Morris (bcmorri3)
+
+    The spill.c program contains the spill files defined in spill.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "spill.h"
+
+/** The name of each spill file, after the directory. The X's are replaced by mkstemp. */
+#define SPILL_TEMPLATE "/drawing-spill-XXXXXX"
+
+/** The directory for spill files, or NULL if out-of-core mode is off. */
+static char const *spillDir = NULL;
+
+/** Size of a page, for releasing whole pages. */
+static size_t pageSize;
+
+/** Makes sure SPILL_ENV is only read once. */
+static pthread_once_t checked = PTHREAD_ONCE_INIT;
+
+/**
+    The checkSpill function reads SPILL_ENV and the page size.
+ */
+static void checkSpill()
+{
+    char const *dir = getenv( SPILL_ENV );
+    spillDir = dir && *dir ? dir : NULL;
+    pageSize = sysconf( _SC_PAGESIZE );
+}
+
+bool spillOn()
+{
+    pthread_once( &checked, checkSpill );
+    return spillDir != NULL;
+}
+
+Mapping *spillMapping( size_t len )
+{
+    if ( !spillOn() ) {
+        return NULL;
+    }
+
+    // Make a file no one else can open, then size and map it.
+    char *path = (char *)malloc( strlen( spillDir ) + sizeof( SPILL_TEMPLATE ) );
+    if ( !path ) {
+        return NULL;
+    }
+    strcpy( path, spillDir );
+    strcat( path, SPILL_TEMPLATE );
+    int fd = mkstemp( path );
+    if ( fd < 0 ) {
+        free( path );
+        return NULL;
+    }
+    unlink( path );
+    free( path );
+
+    void *base = MAP_FAILED;
+    if ( ftruncate( fd, len ) == 0 ) {
+        base = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+    close( fd );
+    if ( base == MAP_FAILED ) {
+        return NULL;
+    }
+
+    // The points are mostly used in order, so the kernel can read ahead.
+    madvise( base, len, MADV_SEQUENTIAL );
+    Mapping *map = makeMapping( base, len );
+    if ( !map ) {
+        munmap( base, len );
+        return NULL;
+    }
+    map->spill = true;
+    return map;
+}
+
+bool chunkSpilled( Chunk const *c )
+{
+    Mapping const *map = ( c->owner ? c->owner : c )->map;
+    return map && map->spill;
+}
+
+bool modelSpilled( Model const *m )
+{
+    for ( Chunk const *c = m->head; c; c = c->next ) {
+        if ( chunkSpilled( c ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+    The releaseRange function lets go of the whole pages inside a range of a spill file's
+    mapping. Partial pages at the ends are kept, since neighboring points share them.
+
+    @param p the start of the range.
+    @param len the length of the range, in bytes.
+ */
+static void releaseRange( void const *p, size_t len )
+{
+    uintptr_t start = ( (uintptr_t)p + pageSize - 1 ) / pageSize * pageSize;
+    uintptr_t end = ( (uintptr_t)p + len ) / pageSize * pageSize;
+    if ( start < end ) {
+        madvise( (void *)start, end - start, MADV_DONTNEED );
+    }
+}
+
+void releasePoints( Chunk const *c, int start, int count )
+{
+    // Dropping the pages of a shared file mapping keeps their contents in the file.
+    if ( chunkSpilled( c ) ) {
+        releaseRange( c->xList + start, count * sizeof( Coord ) );
+        releaseRange( c->yList + start, count * sizeof( Coord ) );
+    }
+}
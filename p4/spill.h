@@ -0,0 +1,81 @@
+/**
+    @file spill.h
+    @author Brian Morris (bcmorri3)
+
+    The spill.h header file declares the out-of-core mode of the drawing program. When
+    SPILL_ENV names a directory, the points of large Chunks live in spill files there
+    rather than in memory: each is a file that is unlinked as soon as it is made and mapped
+    shared, so the kernel can write its pages back to the file and drop them whenever
+    memory is short, instead of swapping or failing. Only the Models, Chunk headers and
+    other bookkeeping stay in the Arena. Code that makes a pass over spilled points lets go
+    of each block of pages once it is done with them, so a pass over a Model bigger than
+    memory doesn't push everything else out first.
+ */
+
+#ifndef _SPILL_H_
+#define _SPILL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "model.h"
+
+/** Environment variable naming the directory for spill files, which turns the mode on. */
+#define SPILL_ENV "DRAWING_SPILL"
+
+/** Chunks storing at least this many points keep them in a spill file. */
+#define SPILL_POINTS 65536
+
+/**
+    Number of points a pass over spilled points handles at a time, 256 KB of each array
+    for doubles, so a block of both arrays stays in the cache while it is worked on.
+ */
+#define SPILL_BLOCK 32768
+
+/**
+    This function reports whether out-of-core mode is on. SPILL_ENV is read the first time
+    this is called.
+
+    @return True if large Chunks should be spilled.
+ */
+bool spillOn();
+
+/**
+    This function makes a Mapping of a new spill file of the given size, filled with zeros.
+    The caller holds the first reference, and releasing the last one frees the file.
+
+    @param len the number of bytes needed.
+
+    @return The Mapping, or NULL if the file couldn't be made.
+ */
+Mapping *spillMapping( size_t len );
+
+/**
+    This function reports whether a Chunk's points are in a spill file.
+
+    @param c the Chunk.
+
+    @return True if the Chunk, or the Chunk whose arrays it uses, is spilled.
+ */
+bool chunkSpilled( Chunk const *c );
+
+/**
+    This function reports whether any of a Model's points are in a spill file.
+
+    @param m the Model.
+
+    @return True if one of its Chunks is spilled.
+ */
+bool modelSpilled( Model const *m );
+
+/**
+    This function lets go of the memory holding a range of a spilled Chunk's points. The
+    points stay in the spill file and are read back if they are used again. Chunks that
+    aren't spilled are left alone.
+
+    @param c the Chunk.
+    @param start the index of the first stored point in the range.
+    @param count the number of stored points in the range.
+ */
+void releasePoints( Chunk const *c, int start, int count );
+
+#endif
@@ -0,0 +1,244 @@
+/**
+    @file stats.c
+    @author Brian Morris (bcmorri3)
+
+    The stats.c program contains the command instrumentation defined in stats.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "stats.h"
+#include "output.h"
+
+/** Nanoseconds in a second. */
+#define NS_PER_SEC 1000000000LL
+
+/** Nanoseconds in a microsecond. */
+#define NS_PER_US 1000LL
+
+/** Nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000LL
+
+/** Bytes in a kilobyte, for the table. */
+#define KB 1024
+
+/** Percent of the commands at or under the median. */
+#define MEDIAN 50
+
+/** Percent of the commands at or under the tail latency reported. */
+#define TAIL 99
+
+/** The counts for the command a thread is running. */
+typedef struct {
+    /** When the command started. */
+    struct timespec start;
+
+    /** The Arena's allocation count when the command started. */
+    size_t allocStart;
+
+    /** Points the command has worked on so far. */
+    long long points;
+
+    /** Bytes of files the command has read or written so far. */
+    long long ioBytes;
+} Current;
+
+/** The command the calling thread is running. */
+static __thread Current current;
+
+/**
+    The kindName function returns the name of a kind of command.
+
+    @param kind the index of the kind, a command index or NUM_VALID_COMMANDS for invalid
+                commands.
+
+    @return The name.
+ */
+static char const *kindName( int kind )
+{
+    return kind < NUM_VALID_COMMANDS ? commandName( kind ) : "invalid";
+}
+
+/**
+    The bucketOf function finds the histogram bucket for a latency.
+
+    @param ns the latency, in nanoseconds.
+
+    @return The index of the bucket.
+ */
+static int bucketOf( long long ns )
+{
+    // Bucket i holds latencies under 2^i microseconds.
+    long long us = ns / NS_PER_US;
+    int b = 0;
+    while ( us > 0 && b < STATS_BUCKETS - 1 ) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/**
+    The percentile function estimates a percentile of the latencies of a kind of command
+    from its histogram, as the upper bound of the bucket it falls in.
+
+    @param k the totals for the kind.
+    @param percent the percentile.
+
+    @return The upper bound, in microseconds.
+ */
+static long long percentile( CommandStats const *k, int percent )
+{
+    // Find the first bucket that reaches the wanted share of the commands.
+    long need = ( k->count * percent + 99 ) / 100;
+    long seen = 0;
+    int b = 0;
+    while ( b < STATS_BUCKETS - 1 && ( seen += k->buckets[ b ] ) < need ) {
+        b++;
+    }
+    return 1LL << b;
+}
+
+Stats *makeStats()
+{
+    char const *fname = getenv( STATS_ENV );
+    if ( !fname ) {
+        return NULL;
+    }
+
+    Stats *st = (Stats *)calloc( 1, sizeof( Stats ) );
+    st->fname = strdup( fname );
+    pthread_mutex_init( &st->lock, NULL );
+    return st;
+}
+
+void freeStats( Stats *st )
+{
+    if ( st ) {
+        pthread_mutex_destroy( &st->lock );
+        free( st->fname );
+        free( st );
+    }
+}
+
+void beginCommand( Stats *st, Arena *arena )
+{
+    if ( !st ) {
+        return;
+    }
+    size_t inUse;
+    arenaUsage( arena, &inUse, &current.allocStart );
+    current.points = 0;
+    current.ioBytes = 0;
+    clock_gettime( CLOCK_MONOTONIC, &current.start );
+}
+
+void endCommand( Stats *st, Arena *arena, int commandIndex )
+{
+    if ( !st ) {
+        return;
+    }
+    struct timespec end;
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    long long ns = ( end.tv_sec - current.start.tv_sec ) * NS_PER_SEC
+                   + ( end.tv_nsec - current.start.tv_nsec );
+    size_t inUse, allocated;
+    arenaUsage( arena, &inUse, &allocated );
+
+    // Add it all to the totals for the kind of command.
+    CommandStats *k = st->kinds + ( commandIndex == INVALID_COMMAND ? NUM_VALID_COMMANDS
+                                                                    : commandIndex );
+    pthread_mutex_lock( &st->lock );
+    k->count++;
+    k->totalNs += ns;
+    k->maxNs = ns > k->maxNs ? ns : k->maxNs;
+    k->points += current.points;
+    k->allocated += allocated - current.allocStart;
+    k->ioBytes += current.ioBytes;
+    k->buckets[ bucketOf( ns ) ]++;
+    pthread_mutex_unlock( &st->lock );
+}
+
+void countPoints( Stats *st, long points )
+{
+    if ( st ) {
+        current.points += points;
+    }
+}
+
+void countFile( Stats *st, char const *fname )
+{
+    struct stat info;
+    if ( st && stat( fname, &info ) == 0 ) {
+        current.ioBytes += info.st_size;
+    }
+}
+
+void printStats( Stats *st, Arena *arena )
+{
+    FILE *out = outStream();
+    fprintf( out, "%-10s %8s %12s %10s %10s %10s %12s %10s %10s\n", "command", "count", "total ms",
+             "p50<=us", "p99<=us", "max us", "points", "alloc KB", "io KB" );
+    for ( int i = 0; i < STATS_KINDS; i++ ) {
+        // Copy the totals, so other threads can go on adding to them.
+        pthread_mutex_lock( &st->lock );
+        CommandStats copy = st->kinds[ i ];
+        pthread_mutex_unlock( &st->lock );
+        CommandStats const *k = &copy;
+        if ( k->count == 0 ) {
+            continue;
+        }
+        fprintf( out, "%-10s %8ld %12.3f %10lld %10lld %10lld %12lld %10lld %10lld\n",
+                 kindName( i ), k->count, (double)k->totalNs / NS_PER_MS, percentile( k, MEDIAN ),
+                 percentile( k, TAIL ), k->maxNs / NS_PER_US, k->points, k->allocated / KB,
+                 k->ioBytes / KB );
+    }
+
+    size_t inUse, allocated;
+    arenaUsage( arena, &inUse, &allocated );
+    fprintf( out, "arena %zu KB in use, %zu KB allocated\n", inUse / KB, allocated / KB );
+}
+
+void dumpStats( Stats const *st, Arena *arena )
+{
+    if ( !st ) {
+        return;
+    }
+    FILE *output = fopen( st->fname, "w" );
+    if ( !output ) {
+        fprintf( stderr, "Can't open file: %s\n", st->fname );
+        return;
+    }
+
+    // One object per kind of command that ran, with the histogram cut after its last
+    // bucket that has anything in it.
+    fprintf( output, "{\n  \"commands\": {" );
+    bool first = true;
+    for ( int i = 0; i < STATS_KINDS; i++ ) {
+        CommandStats const *k = st->kinds + i;
+        if ( k->count == 0 ) {
+            continue;
+        }
+        fprintf( output, "%s\n    \"%s\": {\"count\": %ld, \"total_ns\": %lld, \"max_ns\": %lld, "
+                 "\"points\": %lld, \"alloc_bytes\": %lld, \"io_bytes\": %lld, "
+                 "\"latency_us_log2\": [", first ? "" : ",", kindName( i ), k->count,
+                 k->totalNs, k->maxNs, k->points, k->allocated, k->ioBytes );
+        int last = STATS_BUCKETS - 1;
+        while ( last > 0 && k->buckets[ last ] == 0 ) {
+            last--;
+        }
+        for ( int b = 0; b <= last; b++ ) {
+            fprintf( output, "%s%ld", b ? ", " : "", k->buckets[ b ] );
+        }
+        fprintf( output, "]}" );
+        first = false;
+    }
+
+    size_t inUse, allocated;
+    arenaUsage( arena, &inUse, &allocated );
+    fprintf( output, "\n  },\n  \"arena_in_use\": %zu,\n  \"arena_allocated\": %zu\n}\n", inUse,
+             allocated );
+    fclose( output );
+}
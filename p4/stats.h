@@ -0,0 +1,147 @@
+/**
+    @file stats.h
+    @author Brian Morris (bcmorri3)
+
+    The stats.h header file declares the instrumentation for the commands of a Scene. When
+    the STATS_ENV environment variable names a file, every command's wall-clock latency is
+    recorded in a histogram for its kind of command, along with the points it worked on,
+    the bytes it allocated from the Scene's Arena and the bytes of files it read or wrote.
+    The totals are printed by the stats command and written to the file as JSON when the
+    Scene is freed. Without the variable a Scene has no Stats, and each of the functions
+    here returns right away when given NULL.
+
+    Each thread keeps its own count for the command it is running, so the server can run
+    commands from several clients at once; the totals are shared and locked.
+
+    Latency runs until the command returns. Transforms are still running in the pipeline
+    by then, so the time to finish them is counted in whichever later command waits for
+    them. Allocations made by loads being read ahead count toward the command that is
+    running when they happen.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "arena.h"
+#include "command.h"
+
+/** Environment variable naming the file the statistics are written to. */
+#define STATS_ENV "DRAWING_STATS"
+
+/**
+    Number of latency buckets. Bucket 0 counts latencies under a microsecond, and bucket
+    i after that counts latencies from 2^(i-1) up to 2^i microseconds. The last bucket
+    also takes anything longer.
+ */
+#define STATS_BUCKETS 32
+
+/** Number of kinds of command recorded: each valid command, then invalid ones. */
+#define STATS_KINDS ( NUM_VALID_COMMANDS + 1 )
+
+/** The totals for one kind of command. */
+typedef struct {
+    /** Number of commands run. */
+    long count;
+
+    /** Total latency, in nanoseconds. */
+    long long totalNs;
+
+    /** Longest latency, in nanoseconds. */
+    long long maxNs;
+
+    /** Number of points the commands worked on. */
+    long long points;
+
+    /** Number of bytes the commands allocated from the Arena. */
+    long long allocated;
+
+    /** Number of bytes of files the commands read or wrote. */
+    long long ioBytes;
+
+    /** Histogram of the latencies. */
+    long buckets[ STATS_BUCKETS ];
+} CommandStats;
+
+/** The statistics of a Scene. */
+typedef struct {
+    /** The totals for each kind of command, indexed like the commands, then invalid ones. */
+    CommandStats kinds[ STATS_KINDS ];
+
+    /** The file the statistics are written to. */
+    char *fname;
+
+    /** Lock for the totals. */
+    pthread_mutex_t lock;
+} Stats;
+
+/**
+    This function makes the Stats for a Scene, if STATS_ENV is set.
+
+    @return A dynamically allocated, empty Stats, or NULL if statistics are off.
+ */
+Stats *makeStats();
+
+/**
+    This function frees a Stats.
+
+    @param st the Stats to free, or NULL.
+ */
+void freeStats( Stats *st );
+
+/**
+    This function marks the start of a command.
+
+    @param st the Stats, or NULL.
+    @param arena the Scene's Arena.
+ */
+void beginCommand( Stats *st, Arena *arena );
+
+/**
+    This function marks the end of a command, adding its latency and counts to the totals
+    for its kind.
+
+    @param st the Stats, or NULL.
+    @param arena the Scene's Arena.
+    @param commandIndex which command it was, or INVALID_COMMAND.
+ */
+void endCommand( Stats *st, Arena *arena, int commandIndex );
+
+/**
+    This function adds to the number of points the calling thread's command has worked on.
+
+    @param st the Stats, or NULL.
+    @param points the number of points.
+ */
+void countPoints( Stats *st, long points );
+
+/**
+    This function adds the size of a file the calling thread's command has read or written.
+    Files that can't be found add nothing.
+
+    @param st the Stats, or NULL.
+    @param fname the name of the file.
+ */
+void countFile( Stats *st, char const *fname );
+
+/**
+    This function prints a table of the totals for each kind of command that has run, then
+    the memory the Arena has in use.
+
+    @param st the Stats.
+    @param arena the Scene's Arena.
+ */
+void printStats( Stats *st, Arena *arena );
+
+/**
+    This function writes the statistics, with the full histograms, to the file named by
+    STATS_ENV as JSON. An error message is printed if the file can't be opened.
+
+    @param st the Stats, or NULL to do nothing.
+    @param arena the Scene's Arena.
+ */
+void dumpStats( Stats const *st, Arena *arena );
+
+#endif
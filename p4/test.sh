@@ -10,16 +10,42 @@ if [ $? -ne 0 ]; then
 fi
 
 # Function to run the program against a test case and check
-# its output files and exit status for correct behavior
+# its output files and exit status for correct behavior.  With
+# a third argument of "script", the input is run with --script.
+# With "serve", it is sent to a server by a client, and the
+# server is stopped after.
 testProgram() {
   TESTNO=$1
   OUTFILE=$2
 
   rm -f "$OUTFILE"
 
-  echo " test $TESTNO: ./drawing < input-$TESTNO.txt > stdout.txt 2> stderr.txt"
-  ./drawing < input-$TESTNO.txt > stdout.txt 2> stderr.txt
-  STATUS=$?
+  if [ "$3" == "script" ]
+  then
+      echo " test $TESTNO: ./drawing --script input-$TESTNO.txt > stdout.txt 2> stderr.txt"
+      ./drawing --script input-$TESTNO.txt > stdout.txt 2> stderr.txt
+      STATUS=$?
+  elif [ "$3" == "serve" ]
+  then
+      echo " test $TESTNO: ./drawing --connect test.sock < input-$TESTNO.txt > stdout.txt 2> stderr.txt"
+      rm -f test.sock
+      ./drawing --serve test.sock &
+      SERVER=$!
+      while [ ! -S test.sock ] && kill -0 $SERVER 2> /dev/null; do
+          sleep 0.1
+      done
+      ./drawing --connect test.sock < input-$TESTNO.txt > stdout.txt 2> stderr.txt
+      STATUS=$?
+      kill $SERVER
+      wait $SERVER
+      if [ $? -ne 0 ]; then
+          STATUS=1
+      fi
+  else
+      echo " test $TESTNO: ./drawing < input-$TESTNO.txt > stdout.txt 2> stderr.txt"
+      ./drawing < input-$TESTNO.txt > stdout.txt 2> stderr.txt
+      STATUS=$?
+  fi
 
   # Make sure the program exited with the right exit status.
   if [ $STATUS -ne 0 ]
@@ -76,6 +102,21 @@ testProgram 15 output.txt
 testProgram 16 output.txt
 testProgram 17 output.txt
 testProgram 18 output.txt
+testProgram 19 output.txt
+testProgram 20 output.txt
+testProgram 21 output.txt script
+testProgram 22 output.txt
+testProgram 23 output.txt
+testProgram 24 output.txt
+testProgram 25 output.txt
+testProgram 26 output.txt
+testProgram 27 output.txt
+testProgram 28 output.txt
+testProgram 29 output.txt serve
+testProgram 30 output.txt
+testProgram 31 output.txt
+testProgram 32 output.txt
+testProgram 33 output.txt
 
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
@@ -0,0 +1,327 @@
+/**
+    @file transform.c
+    @author Brian Morris (bcmorri3)
+
+    The transform.c program contains the kernels defined in transform.h. Each kind of
+    Transform has a scalar kernel, an SSE2 kernel and an AVX kernel. The vector kernels
+    use separate multiply and add instructions, never fused ones, so every kernel
+    produces exactly the same values as the scalar code.
+ */
+
+#include <math.h>
+#include <float.h>
+#include "transform.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+/** Defined when the SSE2 and AVX kernels can be built. */
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/** The value of pi. */
+#define PI acos( -1.0 )
+
+/** The number of degrees that must be used to convert degrees to radians. */
+#define DEG_TO_RAD 180
+
+/** Number of doubles in an SSE2 register. */
+#define SSE_WIDTH 2
+
+/** Number of doubles in an AVX register. */
+#define AVX_WIDTH 4
+
+/** Number of float coordinates widened at a time, small enough to stay in the L1 cache. */
+#define WIDEN_BLOCK 512
+
+/** Number of corners of a box. */
+#define BOX_CORNERS 4
+
+/**
+    A box transformed by its corners is widened by this many times the rounding error of
+    the kernels, which work in double, so rounding the points differently can't leave one
+    outside it.
+ */
+#define BOX_SLACK 4
+
+Transform makeTranslate( double dx, double dy )
+{
+    Transform t = { TRANSLATE_KIND, 1, 0, 0, 1, dx, dy };
+    return t;
+}
+
+Transform makeScale( double factor )
+{
+    Transform t = { SCALE_KIND, factor, 0, 0, factor, 0, 0 };
+    return t;
+}
+
+Transform makeRotate( double degrees )
+{
+    // Compute these exactly the way the per-point rotate function used to.
+    double c = cos( degrees * PI / DEG_TO_RAD );
+    double s = sin( degrees * PI / DEG_TO_RAD );
+    Transform t = { ROTATE_KIND, c, -s, s, c, 0, 0 };
+    return t;
+}
+
+Transform makeAffine( double xx, double xy, double yx, double yy, double tx, double ty )
+{
+    Transform t = { AFFINE_KIND, xx, xy, yx, yy, tx, ty };
+    return t;
+}
+
+/**
+    The scalarKernel function applies the Transform to points from index start up to n
+    one point at a time. It also finishes the leftover points after a vector kernel.
+
+    @param t the Transform to apply.
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param start the index of the first point to transform.
+    @param n the number of points.
+ */
+static void scalarKernel( Transform const *t, double *x, double *y, int start, int n )
+{
+    switch ( t->kind ) {
+        case TRANSLATE_KIND:
+            for ( int i = start; i < n; i++ ) {
+                x[ i ] += t->tx;
+                y[ i ] += t->ty;
+            }
+            break;
+        case SCALE_KIND:
+            for ( int i = start; i < n; i++ ) {
+                x[ i ] *= t->xx;
+                y[ i ] *= t->xx;
+            }
+            break;
+        case ROTATE_KIND:
+            for ( int i = start; i < n; i++ ) {
+                // Temporary x and y as rotation depends on the original values.
+                double px = x[ i ];
+                double py = y[ i ];
+                x[ i ] = px * t->xx - py * t->yx;
+                y[ i ] = px * t->yx + py * t->xx;
+            }
+            break;
+        default:
+            for ( int i = start; i < n; i++ ) {
+                double px = x[ i ];
+                double py = y[ i ];
+                x[ i ] = px * t->xx + py * t->xy + t->tx;
+                y[ i ] = px * t->yx + py * t->yy + t->ty;
+            }
+            break;
+    }
+}
+
+#ifdef X86_KERNELS
+
+/**
+    The sseKernel function applies the Transform to two points at a time using SSE2,
+    which every x86-64 processor has, and returns the index of the first point it
+    didn't transform.
+
+    @param t the Transform to apply.
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param n the number of points.
+
+    @return The number of points transformed.
+ */
+static int sseKernel( Transform const *t, double *x, double *y, int n )
+{
+    // Broadcast the matrix once, outside the loops.
+    __m128d xx = _mm_set1_pd( t->xx );
+    __m128d xy = _mm_set1_pd( t->xy );
+    __m128d yx = _mm_set1_pd( t->yx );
+    __m128d yy = _mm_set1_pd( t->yy );
+    __m128d tx = _mm_set1_pd( t->tx );
+    __m128d ty = _mm_set1_pd( t->ty );
+    int i = 0;
+
+    switch ( t->kind ) {
+        case TRANSLATE_KIND:
+            for ( ; i + SSE_WIDTH <= n; i += SSE_WIDTH ) {
+                _mm_storeu_pd( x + i, _mm_add_pd( _mm_loadu_pd( x + i ), tx ) );
+                _mm_storeu_pd( y + i, _mm_add_pd( _mm_loadu_pd( y + i ), ty ) );
+            }
+            break;
+        case SCALE_KIND:
+            for ( ; i + SSE_WIDTH <= n; i += SSE_WIDTH ) {
+                _mm_storeu_pd( x + i, _mm_mul_pd( _mm_loadu_pd( x + i ), xx ) );
+                _mm_storeu_pd( y + i, _mm_mul_pd( _mm_loadu_pd( y + i ), xx ) );
+            }
+            break;
+        case ROTATE_KIND:
+            for ( ; i + SSE_WIDTH <= n; i += SSE_WIDTH ) {
+                __m128d px = _mm_loadu_pd( x + i );
+                __m128d py = _mm_loadu_pd( y + i );
+                _mm_storeu_pd( x + i, _mm_sub_pd( _mm_mul_pd( px, xx ), _mm_mul_pd( py, yx ) ) );
+                _mm_storeu_pd( y + i, _mm_add_pd( _mm_mul_pd( px, yx ), _mm_mul_pd( py, xx ) ) );
+            }
+            break;
+        default:
+            for ( ; i + SSE_WIDTH <= n; i += SSE_WIDTH ) {
+                __m128d px = _mm_loadu_pd( x + i );
+                __m128d py = _mm_loadu_pd( y + i );
+                __m128d nx = _mm_add_pd( _mm_mul_pd( px, xx ), _mm_mul_pd( py, xy ) );
+                __m128d ny = _mm_add_pd( _mm_mul_pd( px, yx ), _mm_mul_pd( py, yy ) );
+                _mm_storeu_pd( x + i, _mm_add_pd( nx, tx ) );
+                _mm_storeu_pd( y + i, _mm_add_pd( ny, ty ) );
+            }
+            break;
+    }
+    return i;
+}
+
+/**
+    The avxKernel function applies the Transform to four points at a time using AVX. It is
+    compiled for AVX regardless of the build flags, and only called when the processor
+    reports AVX support.
+
+    @param t the Transform to apply.
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param n the number of points.
+
+    @return The number of points transformed.
+ */
+__attribute__(( target( "avx" ) ))
+static int avxKernel( Transform const *t, double *x, double *y, int n )
+{
+    // Broadcast the matrix once, outside the loops.
+    __m256d xx = _mm256_set1_pd( t->xx );
+    __m256d xy = _mm256_set1_pd( t->xy );
+    __m256d yx = _mm256_set1_pd( t->yx );
+    __m256d yy = _mm256_set1_pd( t->yy );
+    __m256d tx = _mm256_set1_pd( t->tx );
+    __m256d ty = _mm256_set1_pd( t->ty );
+    int i = 0;
+
+    switch ( t->kind ) {
+        case TRANSLATE_KIND:
+            for ( ; i + AVX_WIDTH <= n; i += AVX_WIDTH ) {
+                _mm256_storeu_pd( x + i, _mm256_add_pd( _mm256_loadu_pd( x + i ), tx ) );
+                _mm256_storeu_pd( y + i, _mm256_add_pd( _mm256_loadu_pd( y + i ), ty ) );
+            }
+            break;
+        case SCALE_KIND:
+            for ( ; i + AVX_WIDTH <= n; i += AVX_WIDTH ) {
+                _mm256_storeu_pd( x + i, _mm256_mul_pd( _mm256_loadu_pd( x + i ), xx ) );
+                _mm256_storeu_pd( y + i, _mm256_mul_pd( _mm256_loadu_pd( y + i ), xx ) );
+            }
+            break;
+        case ROTATE_KIND:
+            for ( ; i + AVX_WIDTH <= n; i += AVX_WIDTH ) {
+                __m256d px = _mm256_loadu_pd( x + i );
+                __m256d py = _mm256_loadu_pd( y + i );
+                _mm256_storeu_pd( x + i, _mm256_sub_pd( _mm256_mul_pd( px, xx ),
+                                                        _mm256_mul_pd( py, yx ) ) );
+                _mm256_storeu_pd( y + i, _mm256_add_pd( _mm256_mul_pd( px, yx ),
+                                                        _mm256_mul_pd( py, xx ) ) );
+            }
+            break;
+        default:
+            for ( ; i + AVX_WIDTH <= n; i += AVX_WIDTH ) {
+                __m256d px = _mm256_loadu_pd( x + i );
+                __m256d py = _mm256_loadu_pd( y + i );
+                __m256d nx = _mm256_add_pd( _mm256_mul_pd( px, xx ), _mm256_mul_pd( py, xy ) );
+                __m256d ny = _mm256_add_pd( _mm256_mul_pd( px, yx ), _mm256_mul_pd( py, yy ) );
+                _mm256_storeu_pd( x + i, _mm256_add_pd( nx, tx ) );
+                _mm256_storeu_pd( y + i, _mm256_add_pd( ny, ty ) );
+            }
+            break;
+    }
+    return i;
+}
+
+#endif
+
+void transformPoints( Transform const *t, double *x, double *y, int n )
+{
+    // Number of points already handled by a vector kernel.
+    int done = 0;
+
+#ifdef X86_KERNELS
+    if ( __builtin_cpu_supports( "avx" ) ) {
+        done = avxKernel( t, x, y, n );
+    } else {
+        done = sseKernel( t, x, y, n );
+    }
+#endif
+
+    // Finish the remaining points one at a time.
+    scalarKernel( t, x, y, done, n );
+}
+
+void transformCoords( Transform const *t, Coord *x, Coord *y, int n )
+{
+#ifdef FLOAT_POINTS
+    // Widen a block into doubles, transform it, and round it back.
+    double bx[ WIDEN_BLOCK ];
+    double by[ WIDEN_BLOCK ];
+    for ( int start = 0; start < n; start += WIDEN_BLOCK ) {
+        int len = n - start < WIDEN_BLOCK ? n - start : WIDEN_BLOCK;
+        for ( int i = 0; i < len; i++ ) {
+            bx[ i ] = x[ start + i ];
+            by[ i ] = y[ start + i ];
+        }
+        transformPoints( t, bx, by, len );
+        for ( int i = 0; i < len; i++ ) {
+            x[ start + i ] = (Coord)bx[ i ];
+            y[ start + i ] = (Coord)by[ i ];
+        }
+    }
+#else
+    transformPoints( t, x, y, n );
+#endif
+}
+
+Box emptyBox()
+{
+    return (Box){ INFINITY, INFINITY, -INFINITY, -INFINITY };
+}
+
+void addBox( Box *b, Box const *other )
+{
+    b->minX = other->minX < b->minX ? other->minX : b->minX;
+    b->minY = other->minY < b->minY ? other->minY : b->minY;
+    b->maxX = other->maxX > b->maxX ? other->maxX : b->maxX;
+    b->maxY = other->maxY > b->maxY ? other->maxY : b->maxY;
+}
+
+void transformBox( Box *b, Transform const *t )
+{
+    if ( b->minX > b->maxX ) {
+        return;
+    }
+
+    // Transform the corners with the same kernel the points get.
+    double x[ BOX_CORNERS ] = { b->minX, b->maxX, b->minX, b->maxX };
+    double y[ BOX_CORNERS ] = { b->minY, b->minY, b->maxY, b->maxY };
+    transformPoints( t, x, y, BOX_CORNERS );
+    Box moved = emptyBox();
+    for ( int i = 0; i < BOX_CORNERS; i++ ) {
+        Box corner = { x[ i ], y[ i ], x[ i ], y[ i ] };
+        addBox( &moved, &corner );
+    }
+
+    // The extreme points of a translation or scaling land on the new corners, and are
+    // stored rounded the same way.
+    if ( t->kind == TRANSLATE_KIND || t->kind == SCALE_KIND ) {
+        *b = (Box){ (Coord)moved.minX, (Coord)moved.minY, (Coord)moved.maxX,
+                    (Coord)moved.maxY };
+        return;
+    }
+
+    // Otherwise allow for the rounding of the products and sums that made each point. The
+    // points are then stored rounded to the nearest Coord, which never puts one past the
+    // rounded corners, so the box is rounded the same way and prints as the points would.
+    double size = fmax( fmax( fabs( b->minX ), fabs( b->maxX ) ),
+                        fmax( fabs( b->minY ), fabs( b->maxY ) ) );
+    double slack = ( ( fabs( t->xx ) + fabs( t->xy ) + fabs( t->yx ) + fabs( t->yy ) ) * size
+                     + fabs( t->tx ) + fabs( t->ty ) ) * DBL_EPSILON * BOX_SLACK;
+    *b = (Box){ (Coord)( moved.minX - slack ), (Coord)( moved.minY - slack ),
+                (Coord)( moved.maxX + slack ), (Coord)( moved.maxY + slack ) };
+}
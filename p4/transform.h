@@ -0,0 +1,189 @@
+/**
+    @file transform.h
+    @author Brian Morris (bcmorri3)
+
+    The transform.h header file declares the Transform type and the kernels that apply a
+    geometric transformation to a structure-of-arrays list of points. The kernels use
+    AVX or SSE2 vector instructions when the processor supports them, and fall back to
+    plain scalar code otherwise.
+ */
+
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#ifdef FLOAT_POINTS
+/**
+    The type the coordinates of Models are stored as. Building with FLOAT_POINTS defined
+    stores them as floats, which halves the memory and bandwidth the points take.
+
+    A float has a 24-bit significand, so a coordinate below 2048 in magnitude is kept to
+    within 2^-13, about 0.00012, an eighth of the last digit saveScene prints. A printed
+    value can still differ in that digit from a double build when the exact value is that
+    close to a rounding boundary, and the error roughly doubles with each doubling of the
+    magnitude: within 0.001 up to 16384, and within 0.5 up to 8388608. Transforms are
+    computed in double and rounded once per transform, so k transforms add up to k times
+    that error. Anything reading the points, like the spatial index and the renderer, works
+    in double on the stored values, and binary files still hold doubles. README.md has the
+    same envelope for users.
+ */
+typedef float Coord;
+#else
+/** The type the coordinates of Models are stored as, double unless FLOAT_POINTS is defined. */
+typedef double Coord;
+#endif
+
+/** Kind of a Transform that moves every point by a fixed offset. */
+#define TRANSLATE_KIND 0
+
+/** Kind of a Transform that multiplies every coordinate by a factor. */
+#define SCALE_KIND 1
+
+/** Kind of a Transform that rotates every point about the origin. */
+#define ROTATE_KIND 2
+
+/** Kind of a Transform that applies a general 2x3 affine matrix. */
+#define AFFINE_KIND 3
+
+/**
+    Representation for a geometric transformation of a point. Every kind of transform is
+    described by the affine matrix below, but translate, scale and rotate have their own
+    kernels so they produce exactly the same values as the original per-point functions.
+
+        x' = xx * x + xy * y + tx
+        y' = yx * x + yy * y + ty
+ */
+typedef struct {
+    /** Which kernel to use, one of the *_KIND values. */
+    int kind;
+
+    /** Contribution of x to the new x-coordinate. */
+    double xx;
+
+    /** Contribution of y to the new x-coordinate. */
+    double xy;
+
+    /** Contribution of x to the new y-coordinate. */
+    double yx;
+
+    /** Contribution of y to the new y-coordinate. */
+    double yy;
+
+    /** Offset added to the new x-coordinate. */
+    double tx;
+
+    /** Offset added to the new y-coordinate. */
+    double ty;
+} Transform;
+
+/** An axis-aligned bounding box. A box with nothing in it has minX greater than maxX. */
+typedef struct {
+    /** The left side. */
+    double minX;
+
+    /** The bottom side. */
+    double minY;
+
+    /** The right side. */
+    double maxX;
+
+    /** The top side. */
+    double maxY;
+} Box;
+
+/**
+    This function returns a Transform that adds dx to every x-coordinate and dy to every
+    y-coordinate.
+
+    @param dx the value to translate the x-coordinates by.
+    @param dy the value to translate the y-coordinates by.
+
+    @return The translation Transform.
+ */
+Transform makeTranslate( double dx, double dy );
+
+/**
+    This function returns a Transform that multiplies both coordinates of every point by
+    the given factor.
+
+    @param factor the scaling factor.
+
+    @return The scaling Transform.
+ */
+Transform makeScale( double factor );
+
+/**
+    This function returns a Transform that rotates every point about the origin by the
+    given angle in degrees. The sine and cosine are computed once, here, rather than once
+    per point.
+
+    @param degrees the angle of the rotation, in degrees.
+
+    @return The rotation Transform.
+ */
+Transform makeRotate( double degrees );
+
+/**
+    This function returns a general affine Transform with the given matrix entries.
+
+    @param xx contribution of x to the new x-coordinate.
+    @param xy contribution of y to the new x-coordinate.
+    @param yx contribution of x to the new y-coordinate.
+    @param yy contribution of y to the new y-coordinate.
+    @param tx offset added to the new x-coordinate.
+    @param ty offset added to the new y-coordinate.
+
+    @return The affine Transform.
+ */
+Transform makeAffine( double xx, double xy, double yx, double yy, double tx, double ty );
+
+/**
+    This function applies the given Transform to n points stored as separate arrays of
+    x-coordinates and y-coordinates.
+
+    @param t the Transform to apply.
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param n the number of points.
+ */
+void transformPoints( Transform const *t, double *x, double *y, int n );
+
+/**
+    This function applies the given Transform to n stored coordinates. With double
+    coordinates it is transformPoints(); with floats, the values are widened a block at a
+    time, transformed with the same kernels and rounded back.
+
+    @param t the Transform to apply.
+    @param x the x-coordinates of the points.
+    @param y the y-coordinates of the points.
+    @param n the number of points.
+ */
+void transformCoords( Transform const *t, Coord *x, Coord *y, int n );
+
+/**
+    This function returns a box with nothing in it, which addBox() can grow.
+
+    @return The empty box.
+ */
+Box emptyBox();
+
+/**
+    This function grows a box to cover another one as well.
+
+    @param b the box to grow.
+    @param other the box it has to cover.
+ */
+void addBox( Box *b, Box const *other );
+
+/**
+    This function moves a box that bounds some stored points to bound those points after
+    the given Transform. A translation or scaling keeps the order of the coordinates, so
+    the new box is exactly the box of the transformed points. Any other Transform gives
+    the box around the transformed corners, which still covers every point but can be
+    larger than it has to be, and grows with each rotation.
+
+    @param b the box to transform, left alone if it's empty.
+    @param t the Transform the points are getting.
+ */
+void transformBox( Box *b, Transform const *t );
+
+#endif